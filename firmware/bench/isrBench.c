@@ -0,0 +1,299 @@
+// *****************************************************************************
+// Cycle accurate ISR timing of the firmware on simavr. ************************
+// *****************************************************************************
+// Runs main.elf on a simulated ATmega32U4, sends commands through UART1 and
+// records when each interrupt gets pending, starts and returns. Reports calls,
+// average and worst case cycles, worst case latency and the highest step rate
+// each stepper ISR could keep up with.
+// Build and ISR profiling pins are described in hardware.h, use the pins with
+// a logic analyzer to get the same numbers from the board.
+//
+// Usage: isrBench [-t <ms>] [-s <script>] main.elf
+// The script holds one command per line, default is a combined build
+// platform, tilt and shutter move at top speed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "sim_interrupts.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+#include "avr_uart.h"
+
+#define BENCH_F_CPU 16000000UL
+#define BENCH_UART_BYTE_CYCLES (BENCH_F_CPU / 960)	// 9600 baud, 10 bits per byte.
+#define BENCH_TIME 3000					// Default run time in ms.
+
+// Data space addresses of the ports, I/O address + 0x20.
+#define BENCH_PORTB 0x25
+#define BENCH_PORTD 0x2B
+#define BENCH_PORTF 0x31
+
+avr_t *benchAvr;
+
+
+// *****************************************************************************
+// Interrupt statistics. *******************************************************
+// *****************************************************************************
+typedef struct
+{
+	uint8_t number;			// Vector number, data sheet table 9-1.
+	const char *name;
+	avr_cycle_count_t pending;	// Cycle the flag got set, 0: not pending.
+	avr_cycle_count_t start;	// Cycle the ISR started, 0: not running.
+	uint32_t count;
+	uint64_t total;			// Cycles.
+	uint32_t max;
+	uint32_t maxLatency;		// Flag set to ISR start.
+} benchVector_t;
+
+benchVector_t benchVectors[] =
+{
+	{ 1,	"INT0" },
+	{ 2,	"INT1" },
+	{ 7,	"INT6" },
+	{ 17,	"TIMER1_COMPA" },
+	{ 21,	"TIMER0_COMPA" },
+	{ 25,	"USART1_RX" },
+	{ 26,	"USART1_UDRE" },
+	{ 32,	"TIMER3_COMPA" },
+	{ 40,	"TIMER4_COMPD" },
+	{ 41,	"TIMER4_OVF" },
+	{ 22,	"TIMER0_COMPB" }
+};
+#define BENCH_VECTOR_COUNT (sizeof(benchVectors) / sizeof(benchVectors[0]))
+#define BENCH_VECTOR_BUILD 3
+#define BENCH_VECTOR_TILT 7
+
+static void benchPending(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	benchVector_t *vector = param;
+	if (value && !vector->pending) vector->pending = benchAvr->cycle;
+}
+
+static void benchRunning(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	benchVector_t *vector = param;
+	if (value)
+	{
+		vector->start = benchAvr->cycle;
+		if (vector->pending && vector->start - vector->pending > vector->maxLatency)
+		{
+			vector->maxLatency = vector->start - vector->pending;
+		}
+		vector->pending = 0;
+	}
+	else if (vector->start)
+	{
+		uint32_t cycles = benchAvr->cycle - vector->start;
+		vector->count++;
+		vector->total += cycles;
+		if (cycles > vector->max) vector->max = cycles;
+		vector->start = 0;
+	}
+}
+
+
+
+// *****************************************************************************
+// Mechanics. ******************************************************************
+// *****************************************************************************
+// Same model as the host simulation: the switches close at position 0 for
+// build platform bottom and tilt and at benchBuildTop for the top.
+int32_t benchBuildPosition = 20000;
+int32_t benchBuildTop = 300000;
+int32_t benchTiltPosition = 0;
+avr_irq_t *benchBottomSwitch, *benchTopSwitch, *benchTiltSwitch;
+
+static void benchUpdateSwitches(void)
+{
+	avr_raise_irq(benchBottomSwitch, benchBuildPosition <= 0);
+	avr_raise_irq(benchTopSwitch, benchBuildPosition >= benchBuildTop);
+	avr_raise_irq(benchTiltSwitch, benchTiltPosition <= 0);
+}
+
+// Build platform clock PB5, direction PB4 (low: up), enable PF7.
+static void benchBuildClock(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	if (!value || !(benchAvr->data[BENCH_PORTF] & (1 << 7))) return;
+	benchBuildPosition += (benchAvr->data[BENCH_PORTB] & (1 << 4)) ? -1 : 1;
+	benchUpdateSwitches();
+}
+
+// Tilt clock PC6, direction PD4 (low: forward), enable PF6.
+static void benchTiltClock(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	if (!value || !(benchAvr->data[BENCH_PORTF] & (1 << 6))) return;
+	benchTiltPosition += (benchAvr->data[BENCH_PORTD] & (1 << 4)) ? -1 : 1;
+	benchUpdateSwitches();
+}
+
+
+
+// *****************************************************************************
+// UART. ***********************************************************************
+// *****************************************************************************
+const char *benchDefaultScript =
+	"tiltAngle 400\n"
+	"tiltSpeed 10\n"
+	"buildSpeed 4\n"
+	"shutterEnable\n"
+	"buildMove 200\n"
+	"tilt\n";
+char *benchScript;
+size_t benchScriptIndex = 0;
+avr_irq_t *benchUartInput;
+
+// Send one byte per byte time.
+static avr_cycle_count_t benchUartSend(struct avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	if (!benchScript[benchScriptIndex]) return 0;
+	avr_raise_irq(benchUartInput, benchScript[benchScriptIndex++]);
+	return when + BENCH_UART_BYTE_CYCLES;
+}
+
+static void benchUartReceive(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	putchar(value);
+}
+
+static char *benchReadFile(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+	{
+		perror(path);
+		exit(2);
+	}
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char *data = calloc(length + 1, 1);
+	if (fread(data, 1, length, file) != (size_t)length)
+	{
+		perror(path);
+		exit(2);
+	}
+	fclose(file);
+	return data;
+}
+
+
+
+// *****************************************************************************
+// Report. *********************************************************************
+// *****************************************************************************
+// A stepper ISR runs on every compare match, two per step. It keeps up as
+// long as latency and run time fit into the compare interval.
+static void benchReportAxis(const char *name, benchVector_t *vector)
+{
+	uint32_t cycles = vector->max + vector->maxLatency;
+	if (!vector->count || !cycles)
+	{
+		printf("%s: no steps\n", name);
+		return;
+	}
+	printf("%s: max %lu steps/s (worst case %u cycles per compare match)\n",
+		name, BENCH_F_CPU / (2UL * cycles), cycles);
+}
+
+static void benchReport(void)
+{
+	printf("\n%-14s %10s %10s %10s %10s\n", "vector", "calls", "average", "worst", "latency");
+	for (uint8_t i=0; i<BENCH_VECTOR_COUNT; i++)
+	{
+		benchVector_t *vector = &benchVectors[i];
+		if (!vector->count) continue;
+		printf("%-14s %10u %10.1f %10u %10u\n", vector->name, vector->count,
+			(double)vector->total / vector->count, vector->max, vector->maxLatency);
+	}
+	printf("\n");
+	benchReportAxis("build platform", &benchVectors[BENCH_VECTOR_BUILD]);
+	benchReportAxis("tilt", &benchVectors[BENCH_VECTOR_TILT]);
+}
+
+
+
+int main(int argc, char **argv)
+{
+	uint32_t time = BENCH_TIME;
+	const char *scriptPath = 0;
+	int option;
+	while ((option = getopt(argc, argv, "t:s:")) != -1)
+	{
+		switch (option)
+		{
+			case 't': time = atol(optarg); break;
+			case 's': scriptPath = optarg; break;
+			default:
+				fprintf(stderr, "Usage: %s [-t <ms>] [-s <script>] main.elf\n", argv[0]);
+				return 2;
+		}
+	}
+	if (optind >= argc)
+	{
+		fprintf(stderr, "Usage: %s [-t <ms>] [-s <script>] main.elf\n", argv[0]);
+		return 2;
+	}
+	benchScript = scriptPath ? benchReadFile(scriptPath) : strdup(benchDefaultScript);
+
+	// Load firmware.
+	elf_firmware_t firmware;
+	memset(&firmware, 0, sizeof(firmware));
+	if (elf_read_firmware(argv[optind], &firmware))
+	{
+		fprintf(stderr, "Can't read %s\n", argv[optind]);
+		return 2;
+	}
+	benchAvr = avr_make_mcu_by_name("atmega32u4");
+	if (!benchAvr)
+	{
+		fprintf(stderr, "simavr has no atmega32u4\n");
+		return 2;
+	}
+	avr_init(benchAvr);
+	benchAvr->frequency = BENCH_F_CPU;
+	avr_load_firmware(benchAvr, &firmware);
+
+	// Interrupts.
+	for (uint8_t i=0; i<BENCH_VECTOR_COUNT; i++)
+	{
+		avr_irq_t *irq = avr_get_interrupt_irq(benchAvr, benchVectors[i].number);
+		if (!irq) continue;
+		avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING, benchPending, &benchVectors[i]);
+		avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, benchRunning, &benchVectors[i]);
+	}
+
+	// Steppers and switches.
+	avr_irq_register_notify(avr_io_getirq(benchAvr, AVR_IOCTL_IOPORT_GETIRQ('B'), 5), benchBuildClock, 0);
+	avr_irq_register_notify(avr_io_getirq(benchAvr, AVR_IOCTL_IOPORT_GETIRQ('C'), 6), benchTiltClock, 0);
+	benchBottomSwitch = avr_io_getirq(benchAvr, AVR_IOCTL_IOPORT_GETIRQ('D'), 0);
+	benchTopSwitch = avr_io_getirq(benchAvr, AVR_IOCTL_IOPORT_GETIRQ('D'), 1);
+	benchTiltSwitch = avr_io_getirq(benchAvr, AVR_IOCTL_IOPORT_GETIRQ('E'), 6);
+	benchUpdateSwitches();
+
+	// Commands after the start up blinking.
+	benchUartInput = avr_io_getirq(benchAvr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(benchAvr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUTPUT), benchUartReceive, 0);
+	avr_cycle_timer_register(benchAvr, BENCH_F_CPU, benchUartSend, 0);
+
+	// Run.
+	avr_cycle_count_t end = (avr_cycle_count_t)time * (BENCH_F_CPU / 1000);
+	while (benchAvr->cycle < end)
+	{
+		int state = avr_run(benchAvr);
+		if (state == cpu_Done || state == cpu_Crashed)
+		{
+			fprintf(stderr, "Firmware stopped at cycle %llu\n", (unsigned long long)benchAvr->cycle);
+			break;
+		}
+	}
+
+	benchReport();
+	return 0;
+}
@@ -7,11 +7,14 @@
 #include <util/delay.h>
 
 
+#ifndef SIMULATION
 #include <LUFA/Drivers/USB/USB.h>
 #include <LUFA/Platform/Platform.h>
+#endif
 
 #include "hardware.h"
 #include "lib/uart.h"	// Include the updated version of Peter Fleurys UART lib.
+#include "lib/watchdog.h"
 
 //Set F_CPU as well if not set in makefile. Needed for baud calculation.
 #ifndef F_CPU
@@ -27,9 +30,9 @@
 // *****************************************************************************
 void setupHardware(void)
 {	
-	// Disable watchdog if enabled by bootloader/fuses. ***********************
-	MCUSR &= ~(1 << WDRF);
-	wdt_disable();
+	// Disable watchdog after a watchdog reset, keep the crash record. *******
+	// The main loop starts it again, see watchdog.h.
+	watchdogInit();
 	
 	
 	// Configure outputs. *****************************************************
@@ -82,6 +85,12 @@ void setupHardware(void)
 	//SERVOPORT |= (1 << SERVOPIN);
 	
 
+	#ifdef ISR_PROFILE
+	// ISR profiling pins. Low while no ISR runs.
+	PROFILEDDR |= (1 << PROFILEBUILDPIN | 1 << PROFILETILTPIN | 1 << PROFILEOTHERPIN);
+	PROFILEPORT &= ~(1 << PROFILEBUILDPIN | 1 << PROFILETILTPIN | 1 << PROFILEOTHERPIN);
+	#endif
+
 	// Configure inputs. ******************************************************
 	
 	// Limit switches using internal pull-ups. Configured as inputs by default.
@@ -99,15 +108,15 @@ void setupHardware(void)
 //	PCMSK0 |= (1 << PCINT4);
 	
 
-	// Configure timer0. Call ISR every 0,1 ms. *******************************
-	// Prescaler:	16.000.000 Hz / 8 = 2.000.000 Hz
-  	//			1 s / 2.000.000 = 0,0000005 s per clock cycle.
+	// Configure timer0. Call ISR every 1 ms, scheduler tick. ****************
+	// Prescaler:	16.000.000 Hz / 64 = 250.000 Hz
+  	//			1 s / 250.000 = 0,000004 s per clock cycle.
   	// Clock cycles per millisecond:
-  	//			0,001 s / 0,0000005 s = 2.000 clock cycles per millisecond.
-  	//			Overflow at 200 clock cycles comes every 0,1 ms.
+  	//			0,001 s / 0,000004 s = 250 clock cycles per millisecond.
+  	//			Counting 0..249 the compare match comes every 1 ms.
   	TCCR0A |= (1 << WGM01);	// CTC mode. Data sheet page 104.
-  	TCCR0B |= (1<<CS01);	// Set prescaler to 8. Data sheet page 106.
-  	OCR0A = 200;			// Set channel A compare value.
+  	TCCR0B |= (1<<CS01 | 1<<CS00);	// Set prescaler to 64. Data sheet page 106.
+  	OCR0A = 249;			// Set channel A compare value.
   	TIMSK0 |= (1<<OCIE0A);	// Enable channel A compare interrupt.
 
 
@@ -137,11 +146,13 @@ void setupHardware(void)
 */	
 	
 	// Servo PWM for shutter. *************************************************
-	// Configure timer4 in 8 bit mode without CTC.
-	// Set servo signal pin high on timer overflow interrupt, wait for
-	// compare match interrupt and set pin low again.
-	//Do this later.	TCCR4B |= (1 << CS43);				// Prescaler 128. Datasheet p 166.
-	TIMSK4 |= (1 << OCIE4D | 1 << TOIE4);	// Enable channel D compare match interrupt and counter overflow interrupt.
+	// Configure timer4 for 10 bit fast PWM on OC4D, the servo pin.
+	// Prescaler 256:	16.000.000 Hz / 256 = 62.500 Hz --> 16 us per count.
+	// Top 1023:		1024 * 16 us = 16.4 ms frame.
+	// OC4D is set at the start of the frame and cleared on compare match D,
+	// no interrupts needed. Clock and output are switched on by shutterEnable().
+	TCCR4C |= (1 << PWM4D);			// PWM on channel D. Datasheet p 165.
+	timer4SetTop(SERVO_TOP);
 	
 	
 	/*
@@ -169,7 +180,9 @@ void setupHardware(void)
 	// exiting USB connection correctly.
 	// See here: http://www.avrfreaks.net/forum/running-lufa-projects-leonardo
 	USBCON &= ~(1 << OTGPADE);
+	#ifndef SIMULATION
 	USB_Init();
+	#endif
 	
 	// Initialise LCD. ********************************************************
 //	lcd_init(0x0C);		// LCD on, cursor off: see lcd.h.
@@ -214,20 +227,29 @@ void timer3SetCompareValue( uint16_t input )
 	SREG = sreg;	// Makes sei() unneccessary.
 }
 
-void timer4SetCompareValue( uint8_t input )
+void timer4SetCompareValue( uint16_t input )
 {
 // NOTE: For timer 4 only OCR4C generates a reset on compare match, but only channels A, B and D have an interrupt...
-//	// Save global interrupt flag.
-//	uint8_t sreg;
-//	sreg = SREG;
-//	// Disable interrupts.
-//	cli();
-//	//Set TCNTn to input.
-	//OCR4A = input-5;
-	//OCR4C = input;
+	// Save global interrupt flag.
+	uint8_t sreg;
+	sreg = SREG;
+	// Disable interrupts.
+	cli();
+	// 10 bit write: high byte goes through the shared TC4H register first.
+	TC4H = input >> 8;
 	OCR4D = input;
-//	// Restore global interrupt flag.
-//	SREG = sreg;	// Makes sei() unneccessary.
+	// Restore global interrupt flag.
+	SREG = sreg;	// Makes sei() unneccessary.
+}
+
+void timer4SetTop( uint16_t input )
+{
+	uint8_t sreg;
+	sreg = SREG;
+	cli();
+	TC4H = input >> 8;
+	OCR4C = input;
+	SREG = sreg;
 }
 
 void ledYellowOn( void )
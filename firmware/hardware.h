@@ -64,10 +64,13 @@
 #define TILTENABLEPIN PIN6
 
 // Servo output. ***************************************************************
-// Clock.
+// Clock. OC4D, driven by timer 4 PWM.
 #define SERVODDR DDRD
 #define SERVOPORT PORTD
 #define SERVOPIN PIN7
+// Timer 4 frame.
+#define SERVO_TOP 1023			// 10 bit. 1024 * 16 us = 16.4 ms frame.
+#define SERVO_US_PER_COUNT 16		// Prescaler 256.
 
 
 
@@ -90,10 +93,29 @@
 #define LIMITTILTPOLL PINE
 
 
+// ISR profiling. **************************************************************
+// Build with "make PROFILE=1" and watch the pins with a logic analyzer.
+// Each pin is high while its ISR runs. Spare pins of the Pro Micro.
+#define PROFILEDDR DDRB
+#define PROFILEPORT PORTB
+#define PROFILEBUILDPIN PIN1		// Build platform step ISR.
+#define PROFILETILTPIN PIN2		// Tilt step ISR.
+#define PROFILEOTHERPIN PIN3		// Tick, servo and limit switch ISRs.
+
+#ifdef ISR_PROFILE
+#define ISR_PROFILE_BEGIN(pin) (PROFILEPORT |= (1 << pin))
+#define ISR_PROFILE_END(pin) (PROFILEPORT &= ~(1 << pin))
+#else
+#define ISR_PROFILE_BEGIN(pin)
+#define ISR_PROFILE_END(pin)
+#endif
+
+
 void setupHardware(void);
 void timer1SetCompareValue( uint16_t input );
 void timer3SetCompareValue( uint16_t input );
-void timer4SetCompareValue( uint8_t input );
+void timer4SetCompareValue( uint16_t input );
+void timer4SetTop( uint16_t input );
 uint8_t readADC(uint8_t channel);
 void ledYellowOn( void );
 void ledYellowOff( void );
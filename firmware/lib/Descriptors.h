@@ -54,8 +54,20 @@
 		/** Size in bytes of the CDC device-to-host notification IN endpoint. */
 		#define CDC_NOTIFICATION_EPSIZE        8
 
-		/** Size in bytes of the CDC data IN and OUT endpoints. */
-		#define CDC_TXRX_EPSIZE                16
+		/** Size in bytes of the CDC data IN and OUT endpoints. 64 bytes is the maximum for full speed
+		 *  bulk endpoints. Define CDC_TXRX_EPSIZE=16 and CDC_TXRX_BANKS=1 in the makefile for the old
+		 *  low memory configuration.
+		 */
+		#if !defined(CDC_TXRX_EPSIZE)
+			#define CDC_TXRX_EPSIZE            64
+		#endif
+
+		/** Number of banks of the CDC data IN and OUT endpoints. With two banks the host can fill one
+		 *  bank while the firmware still reads the other. Uses 2 * 2 * 64 bytes of the 832 bytes USB DPRAM.
+		 */
+		#if !defined(CDC_TXRX_BANKS)
+			#define CDC_TXRX_BANKS             2
+		#endif
 
 	/* Type Defines: */
 		/** Type define for the device configuration descriptor structure. This must be defined in the
@@ -0,0 +1,344 @@
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+#include "lib/binaryCommands.h"
+#include "lib/uart.h"
+#include "lib/virtualSerial.h"
+#include "lib/printerFunctions.h"
+#include "lib/motionQueue.h"
+#include "lib/printJob.h"
+#include "lib/exposure.h"
+#include "lib/telemetry.h"
+#include "lib/positionAudit.h"
+#include "lib/watchdog.h"
+
+
+// *****************************************************************************
+// CRC-8, polynomial 0x07. *****************************************************
+// *****************************************************************************
+static const uint8_t binaryCrcTable[256] PROGMEM =
+{
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+	0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+	0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+	0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+	0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+	0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+	0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+	0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+	0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+	0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+	0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+	0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+	0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+	0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+	0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+	0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+uint8_t binaryCrc8(uint8_t crc, uint8_t data)
+{
+	return pgm_read_byte(&binaryCrcTable[crc ^ data]);
+}
+
+
+
+// *****************************************************************************
+// Command handlers. ***********************************************************
+// *****************************************************************************
+// Same actions as the ASCII commands in printerCommands.c.
+// Handlers with more than one value read the raw arguments of the frame.
+static uint8_t *binaryArgs;
+static uint8_t binaryPing(int16_t value)		{ return BINARY_STATUS_OK; }
+static uint8_t binaryTilt(int16_t value)		{ tilt(tiltAngle, tiltSpeed); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildHome(int16_t value)		{ buildPlatformHome(); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildTop(int16_t value)		{ buildPlatformTop(); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildBaseUp(int16_t value)		{ buildPlatformBaseLayerUp(); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildUp(int16_t value)		{ buildPlatformLayerUp(); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterOpen(int16_t value)		{ shutterOpen(); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterClose(int16_t value)	{ shutterClose(); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterEnable(int16_t value)	{ shutterEnable(); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterDisable(int16_t value)	{ shutterDisable(); return BINARY_STATUS_OK; }
+static uint8_t binaryTriggerCam(int16_t value)		{ triggerCamera(); return BINARY_STATUS_OK; }
+static uint8_t binaryPeel(int16_t value)		{ peel(); return BINARY_STATUS_OK; }
+
+// Queued motion segments.
+static uint8_t binaryQueue(uint8_t type, int16_t value)
+{
+	if (motionQueuePush(type, value)) return BINARY_STATUS_OK;
+	else return BINARY_STATUS_FULL;
+}
+static uint8_t binaryQBuildUp(int16_t value)		{ return binaryQueue(MOTION_SEGMENT_BUILD_LAYER, 0); }
+static uint8_t binaryQTilt(int16_t value)		{ return binaryQueue(MOTION_SEGMENT_TILT, 0); }
+static uint8_t binaryQShutterOpen(int16_t value)	{ return binaryQueue(MOTION_SEGMENT_SHUTTER_OPEN, 0); }
+static uint8_t binaryQShutterClose(int16_t value)	{ return binaryQueue(MOTION_SEGMENT_SHUTTER_CLOSE, 0); }
+static uint8_t binaryQCam(int16_t value)		{ return binaryQueue(MOTION_SEGMENT_CAMERA, 0); }
+static uint8_t binaryQPeel(int16_t value)		{ return binaryQueue(MOTION_SEGMENT_PEEL, 0); }
+static uint8_t binaryQClear(int16_t value)		{ motionQueueClear(); return BINARY_STATUS_OK; }
+static uint8_t binaryQBuildMove(int16_t value)		{ return binaryQueue(MOTION_SEGMENT_BUILD_MOVE, value); }
+static uint8_t binaryQDwell(int16_t value)		{ return binaryQueue(MOTION_SEGMENT_DWELL, value); }
+
+// Settings.
+static uint8_t binaryBuildLayer(int16_t value)		{ buildPlatformSetLayerHeight(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildBaseLayer(int16_t value)	{ buildPlatformSetBaseLayerHeight(value); return BINARY_STATUS_OK; }
+static uint8_t binaryTiltSpeed(int16_t value)		{ tiltSetSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryTiltAngle(int16_t value)		{ tiltSetAngle(value); return BINARY_STATUS_OK; }
+static uint8_t binaryTiltRes(int16_t value)		{ tiltSetAngleMax(value); return BINARY_STATUS_OK; }
+static uint8_t binaryTiltReturnSpeed(int16_t value)	{ tiltSetReturnSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryTiltAccel(int16_t value)
+{
+	// Four byte argument, the default is above 65535 °/s².
+	tiltSetAcceleration((uint32_t)binaryArgs[0] | ((uint32_t)binaryArgs[1] << 8) | ((uint32_t)binaryArgs[2] << 16) | ((uint32_t)binaryArgs[3] << 24));
+	return BINARY_STATUS_OK;
+}
+static uint8_t binaryTiltCreepSpeed(int16_t value)	{ tiltSetCreepSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryTiltApproach(int16_t value)	{ tiltSetApproach(value); return BINARY_STATUS_OK; }
+static uint8_t binaryAuditTolerance(int16_t value)	{ positionAuditSetTolerance(value); return BINARY_STATUS_OK; }
+static uint8_t binaryAuditAction(int16_t value)		{ positionAuditSetAction(value); return BINARY_STATUS_OK; }
+static uint8_t binaryAuditReset(int16_t value)		{ positionAuditSetTopReference(0); return BINARY_STATUS_OK; }
+static uint8_t binaryCrashClear(int16_t value)		{ watchdogClear(); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildSpeed(int16_t value)		{ buildPlatformSetSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildRes(int16_t value)		{ buildPlatformSetResolution(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildMinMove(int16_t value)	{ buildPlatformSetMinMove(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildAccel(int16_t value)		{ buildPlatformSetAcceleration(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildRamp(int16_t value)		{ buildPlatformSetRampShape(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildFeed(int16_t value)		{ buildPlatformSetFeedrate(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildSpeedTable(int16_t value)	{ buildPlatformSetSpeedTable(value, binaryArgs[2] | (binaryArgs[3] << 8)); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildStartSpeed(int16_t value)	{ buildPlatformSetStartSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildStepAngle(int16_t value)	{ buildPlatformSetStepAngle(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildMicrosteps(int16_t value)	{ buildPlatformSetMicrosteps(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildLead(int16_t value)		{ buildPlatformSetLead(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildMove(int16_t value)		{ buildPlatformMove(value); return BINARY_STATUS_OK; }
+static uint8_t binaryBuildMoveUm(int16_t value)		{ buildPlatformMoveMicrons(value); return BINARY_STATUS_OK; }
+static uint8_t binaryHomeFastSpeed(int16_t value)	{ homingSetFastSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryHomeSlowSpeed(int16_t value)	{ homingSetSlowSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryHomeBackoff(int16_t value)		{ homingSetBackoff(value); return BINARY_STATUS_OK; }
+static uint8_t binaryHomeTimeout(int16_t value)		{ homingSetTimeout(value); return BINARY_STATUS_OK; }
+
+// Print job.
+static uint8_t binaryJobLayer(int16_t value)
+{
+	printJobLayer_t layer;
+	layer.buildMove = value;
+	layer.tiltSpeed = binaryArgs[2];
+	layer.flags = binaryArgs[3];
+	layer.settle = binaryArgs[4] | (binaryArgs[5] << 8);
+	layer.exposure = binaryArgs[6] | (binaryArgs[7] << 8);
+	if (printJobPush(&layer)) return BINARY_STATUS_OK;
+	else return BINARY_STATUS_FULL;
+}
+static uint8_t binaryJobStart(int16_t value)		{ printJobStart(); return BINARY_STATUS_OK; }
+static uint8_t binaryJobStop(int16_t value)		{ printJobStop(); return BINARY_STATUS_OK; }
+
+// Exposure timer.
+static uint8_t binaryExpose(int16_t value)
+{
+	uint32_t microseconds = (uint32_t)binaryArgs[0] | ((uint32_t)binaryArgs[1] << 8) | ((uint32_t)binaryArgs[2] << 16) | ((uint32_t)binaryArgs[3] << 24);
+	if (exposureStart(microseconds, binaryArgs[4])) return BINARY_STATUS_OK;
+	else return BINARY_STATUS_BUSY;
+}
+static uint8_t binaryExposeStop(int16_t value)		{ exposureStop(); return BINARY_STATUS_OK; }
+static uint8_t binaryPrintingFlag(int16_t value)
+{
+	// 0 is idle, 1 is printing.
+	if (value==0 || value==1) printerSetState(value);
+	return BINARY_STATUS_OK;
+}
+static uint8_t binarySlice(int16_t value)		{ printerSetSlice(value); return BINARY_STATUS_OK; }
+static uint8_t binaryNSlices(int16_t value)		{ printerSetNumberOfSlices(value); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterOpenPos(int16_t value)	{ shutterSetOpenPos(value); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterClosePos(int16_t value)	{ shutterSetClosePos(value); return BINARY_STATUS_OK; }
+static uint8_t binaryPeelOffset(int16_t value)		{ peelSetBuildOffset(value); return BINARY_STATUS_OK; }
+static uint8_t binaryPeelTiltSpeed(int16_t value)	{ peelSetTiltSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryPeelBuildSpeed(int16_t value)	{ peelSetBuildSpeed(value); return BINARY_STATUS_OK; }
+static uint8_t binaryTelemetry(int16_t value)		{ telemetrySetPeriod(value); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterOpenPulse(int16_t value)	{ shutterSetOpenPulse(value); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterClosePulse(int16_t value)	{ shutterSetClosePulse(value); return BINARY_STATUS_OK; }
+static uint8_t binaryShutterSlew(int16_t value)		{ shutterSetSlew(value); return BINARY_STATUS_OK; }
+static uint8_t binarySaveConfig(int16_t value)		{ return printerSaveConfig() ? BINARY_STATUS_OK : BINARY_STATUS_BUSY; }
+static uint8_t binaryLoadConfig(int16_t value)		{ return printerLoadConfig() ? BINARY_STATUS_OK : BINARY_STATUS_CONFIG; }
+static uint8_t binaryConfigTag(int16_t value)		{ printerSetConfigTag(value); return BINARY_STATUS_OK; }
+
+
+// Command table. Indexed by opcode. *******************************************
+static const binaryCommand_t binaryCommands[BINARY_OP_COUNT] PROGMEM =
+{
+	[BINARY_OP_PING]		= { 0, binaryPing },
+	[BINARY_OP_TILT]		= { 0, binaryTilt },
+	[BINARY_OP_BUILD_HOME]		= { 0, binaryBuildHome },
+	[BINARY_OP_BUILD_TOP]		= { 0, binaryBuildTop },
+	[BINARY_OP_BUILD_BASE_UP]	= { 0, binaryBuildBaseUp },
+	[BINARY_OP_BUILD_UP]		= { 0, binaryBuildUp },
+	[BINARY_OP_SHUTTER_OPEN]	= { 0, binaryShutterOpen },
+	[BINARY_OP_SHUTTER_CLOSE]	= { 0, binaryShutterClose },
+	[BINARY_OP_SHUTTER_ENABLE]	= { 0, binaryShutterEnable },
+	[BINARY_OP_SHUTTER_DISABLE]	= { 0, binaryShutterDisable },
+	[BINARY_OP_TRIGGER_CAM]		= { 0, binaryTriggerCam },
+	[BINARY_OP_PEEL]		= { 0, binaryPeel },
+	[BINARY_OP_Q_BUILD_UP]		= { 0, binaryQBuildUp },
+	[BINARY_OP_Q_TILT]		= { 0, binaryQTilt },
+	[BINARY_OP_Q_SHUTTER_OPEN]	= { 0, binaryQShutterOpen },
+	[BINARY_OP_Q_SHUTTER_CLOSE]	= { 0, binaryQShutterClose },
+	[BINARY_OP_Q_CAM]		= { 0, binaryQCam },
+	[BINARY_OP_Q_PEEL]		= { 0, binaryQPeel },
+	[BINARY_OP_Q_CLEAR]		= { 0, binaryQClear },
+	[BINARY_OP_Q_BUILD_MOVE]	= { 2, binaryQBuildMove },
+	[BINARY_OP_Q_DWELL]		= { 2, binaryQDwell },
+	[BINARY_OP_BUILD_LAYER]		= { 2, binaryBuildLayer },
+	[BINARY_OP_BUILD_BASE_LAYER]	= { 2, binaryBuildBaseLayer },
+	[BINARY_OP_TILT_SPEED]		= { 2, binaryTiltSpeed },
+	[BINARY_OP_TILT_ANGLE]		= { 2, binaryTiltAngle },
+	[BINARY_OP_TILT_RES]		= { 2, binaryTiltRes },
+	[BINARY_OP_BUILD_SPEED]		= { 2, binaryBuildSpeed },
+	[BINARY_OP_BUILD_RES]		= { 2, binaryBuildRes },
+	[BINARY_OP_BUILD_MIN_MOVE]	= { 2, binaryBuildMinMove },
+	[BINARY_OP_BUILD_ACCEL]		= { 2, binaryBuildAccel },
+	[BINARY_OP_BUILD_RAMP]		= { 2, binaryBuildRamp },
+	[BINARY_OP_BUILD_MOVE]		= { 2, binaryBuildMove },
+	[BINARY_OP_PRINTING_FLAG]	= { 2, binaryPrintingFlag },
+	[BINARY_OP_SLICE]		= { 2, binarySlice },
+	[BINARY_OP_N_SLICES]		= { 2, binaryNSlices },
+	[BINARY_OP_SHUTTER_OPEN_POS]	= { 2, binaryShutterOpenPos },
+	[BINARY_OP_SHUTTER_CLOSE_POS]	= { 2, binaryShutterClosePos },
+	[BINARY_OP_PEEL_OFFSET]		= { 2, binaryPeelOffset },
+	[BINARY_OP_PEEL_TILT_SPEED]	= { 2, binaryPeelTiltSpeed },
+	[BINARY_OP_PEEL_BUILD_SPEED]	= { 2, binaryPeelBuildSpeed },
+	[BINARY_OP_TELEMETRY]		= { 2, binaryTelemetry },
+	[BINARY_OP_SHUTTER_OPEN_PULSE]	= { 2, binaryShutterOpenPulse },
+	[BINARY_OP_SHUTTER_CLOSE_PULSE]	= { 2, binaryShutterClosePulse },
+	[BINARY_OP_SHUTTER_SLEW]	= { 2, binaryShutterSlew },
+	[BINARY_OP_SAVE_CONFIG]		= { 0, binarySaveConfig },
+	[BINARY_OP_LOAD_CONFIG]		= { 0, binaryLoadConfig },
+	[BINARY_OP_BUILD_MOVE_UM]	= { 2, binaryBuildMoveUm },
+	[BINARY_OP_HOME_FAST_SPEED]	= { 2, binaryHomeFastSpeed },
+	[BINARY_OP_HOME_SLOW_SPEED]	= { 2, binaryHomeSlowSpeed },
+	[BINARY_OP_HOME_BACKOFF]	= { 2, binaryHomeBackoff },
+	[BINARY_OP_HOME_TIMEOUT]	= { 2, binaryHomeTimeout },
+	[BINARY_OP_JOB_LAYER]		= { 8, binaryJobLayer },
+	[BINARY_OP_JOB_START]		= { 0, binaryJobStart },
+	[BINARY_OP_JOB_STOP]		= { 0, binaryJobStop },
+	[BINARY_OP_EXPOSE]		= { 5, binaryExpose },
+	[BINARY_OP_EXPOSE_STOP]		= { 0, binaryExposeStop },
+	[BINARY_OP_TILT_RETURN_SPEED]	= { 2, binaryTiltReturnSpeed },
+	[BINARY_OP_TILT_ACCEL]		= { 4, binaryTiltAccel },
+	[BINARY_OP_TILT_CREEP_SPEED]	= { 2, binaryTiltCreepSpeed },
+	[BINARY_OP_TILT_APPROACH]	= { 2, binaryTiltApproach },
+	[BINARY_OP_AUDIT_TOLERANCE]	= { 2, binaryAuditTolerance },
+	[BINARY_OP_AUDIT_ACTION]	= { 2, binaryAuditAction },
+	[BINARY_OP_AUDIT_RESET]		= { 0, binaryAuditReset },
+	[BINARY_OP_CRASH_CLEAR]		= { 0, binaryCrashClear },
+	[BINARY_OP_BUILD_FEED]		= { 2, binaryBuildFeed },
+	[BINARY_OP_BUILD_SPEED_TABLE]	= { 4, binaryBuildSpeedTable },
+	[BINARY_OP_BUILD_START_SPEED]	= { 2, binaryBuildStartSpeed },
+	[BINARY_OP_BUILD_STEP_ANGLE]	= { 2, binaryBuildStepAngle },
+	[BINARY_OP_BUILD_MICROSTEPS]	= { 2, binaryBuildMicrosteps },
+	[BINARY_OP_BUILD_LEAD]		= { 2, binaryBuildLead },
+	[BINARY_OP_CONFIG_TAG]		= { 2, binaryConfigTag },
+};
+
+
+
+// *****************************************************************************
+// Response. *******************************************************************
+// *****************************************************************************
+static void binaryRespond(binaryParser_t *parser, uint8_t status, uint8_t channel)
+{
+	uint8_t response[5];
+	response[0] = BINARY_SYNC;
+	response[1] = parser->opcode;
+	response[2] = parser->sequence;
+	response[3] = status;
+	response[4] = binaryCrc8(binaryCrc8(binaryCrc8(0, response[1]), response[2]), response[3]);
+	if (!channel)	sendDataUSB(response, sizeof(response));
+	else	uart1_putdata(response, sizeof(response));
+}
+
+
+// Run a complete frame. *******************************************************
+static void binaryExecute(binaryParser_t *parser, uint8_t channel)
+{
+	binaryCommand_t command;
+	uint8_t status;
+
+	if (parser->opcode >= BINARY_OP_COUNT)
+	{
+		status = BINARY_STATUS_OPCODE;
+	}
+	else
+	{
+		memcpy_P(&command, &binaryCommands[parser->opcode], sizeof(command));
+		if (parser->length != command.length)
+		{
+			status = BINARY_STATUS_LENGTH;
+		}
+		else
+		{
+			// Little endian argument.
+			int16_t value = parser->args[0] | (parser->args[1] << 8);
+			binaryArgs = parser->args;
+			watchdogNoteOpcode(parser->opcode);
+			status = command.handler(value);
+		}
+	}
+	binaryRespond(parser, status, channel);
+}
+
+
+
+// *****************************************************************************
+// Frame parser. Feed bytes one by one. ****************************************
+// *****************************************************************************
+void binaryParserReset(binaryParser_t *parser)
+{
+	parser->state = BINARY_STATE_SYNC;
+}
+
+uint8_t binaryParserFeed(binaryParser_t *parser, uint8_t inputByte, uint8_t channel)
+{
+	switch (parser->state)
+	{
+		case BINARY_STATE_SYNC:
+			// Not a frame, leave it to the ASCII parser.
+			if (inputByte != BINARY_SYNC) return 0;
+			parser->crc = 0;
+			parser->state = BINARY_STATE_OPCODE;
+			return 1;
+		case BINARY_STATE_OPCODE:
+			parser->opcode = inputByte;
+			parser->state = BINARY_STATE_SEQUENCE;
+			break;
+		case BINARY_STATE_SEQUENCE:
+			parser->sequence = inputByte;
+			parser->state = BINARY_STATE_LENGTH;
+			break;
+		case BINARY_STATE_LENGTH:
+			parser->length = inputByte;
+			parser->index = 0;
+			parser->args[0] = 0;
+			parser->args[1] = 0;
+			if (inputByte > BINARY_ARGS_MAX)
+			{
+				// Can't be a valid frame. Resync.
+				binaryRespond(parser, BINARY_STATUS_LENGTH, channel);
+				parser->state = BINARY_STATE_SYNC;
+				return 1;
+			}
+			parser->state = inputByte ? BINARY_STATE_ARGS : BINARY_STATE_CRC;
+			break;
+		case BINARY_STATE_ARGS:
+			parser->args[parser->index] = inputByte;
+			if (++parser->index == parser->length) parser->state = BINARY_STATE_CRC;
+			break;
+		case BINARY_STATE_CRC:
+			if (inputByte == parser->crc) binaryExecute(parser, channel);
+			else binaryRespond(parser, BINARY_STATUS_CRC, channel);
+			parser->state = BINARY_STATE_SYNC;
+			return 1;
+		default:
+			parser->state = BINARY_STATE_SYNC;
+			return 1;
+	}
+	parser->crc = binaryCrc8(parser->crc, inputByte);
+	return 1;
+}
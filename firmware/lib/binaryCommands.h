@@ -0,0 +1,144 @@
+#ifndef BINARYCOMMANDS_H
+#define BINARYCOMMANDS_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Binary command protocol. ****************************************************
+// *****************************************************************************
+// Compact alternative to the ASCII commands on the same USB and UART links.
+// Request frame:
+//	sync (0xA5) | opcode | sequence | length | args (little endian) | crc
+// Response frame:
+//	sync (0xA5) | opcode | sequence | status | crc
+// The CRC-8 (polynomial 0x07, init 0) covers everything between sync and crc.
+// ASCII commands never contain the sync byte, so both protocols can be mixed.
+// The host may send several frames without waiting, acks carry the sequence
+// number. "done" is still sent as ASCII string when an operation has finished.
+// A frame must arrive without gaps: after COMMAND_IDLE_TIMEOUT without bytes
+// a partial frame is dropped, so a cut off frame can't eat the next command.
+// Telemetry frames use the same sync byte with frame type 0xFE in place of the
+// opcode, see telemetry.h.
+
+// Variables. ******************************************************************
+#define BINARY_SYNC 0xA5
+#define BINARY_ARGS_MAX 8
+
+// Response status.
+#define BINARY_STATUS_OK 0
+#define BINARY_STATUS_CRC 1			// Checksum mismatch, resend.
+#define BINARY_STATUS_OPCODE 2			// Unknown opcode.
+#define BINARY_STATUS_LENGTH 3			// Wrong number of argument bytes.
+#define BINARY_STATUS_FULL 4			// Motion queue or print job full, resend later.
+#define BINARY_STATUS_CONFIG 5			// No stored configuration, send settings.
+#define BINARY_STATUS_BUSY 6			// Exposure running or printer moving, resend later.
+
+// Opcodes. Index into the command table, keep in sync with the host.
+#define BINARY_OP_PING 0x00
+#define BINARY_OP_TILT 0x01
+#define BINARY_OP_BUILD_HOME 0x02
+#define BINARY_OP_BUILD_TOP 0x03
+#define BINARY_OP_BUILD_BASE_UP 0x04
+#define BINARY_OP_BUILD_UP 0x05
+#define BINARY_OP_SHUTTER_OPEN 0x06
+#define BINARY_OP_SHUTTER_CLOSE 0x07
+#define BINARY_OP_SHUTTER_ENABLE 0x08
+#define BINARY_OP_SHUTTER_DISABLE 0x09
+#define BINARY_OP_TRIGGER_CAM 0x0A
+#define BINARY_OP_PEEL 0x0B
+#define BINARY_OP_Q_BUILD_UP 0x0C
+#define BINARY_OP_Q_TILT 0x0D
+#define BINARY_OP_Q_SHUTTER_OPEN 0x0E
+#define BINARY_OP_Q_SHUTTER_CLOSE 0x0F
+#define BINARY_OP_Q_CAM 0x10
+#define BINARY_OP_Q_PEEL 0x11
+#define BINARY_OP_Q_CLEAR 0x12
+#define BINARY_OP_Q_BUILD_MOVE 0x13		// int16 standard layers.
+#define BINARY_OP_Q_DWELL 0x14			// int16 ms.
+#define BINARY_OP_BUILD_LAYER 0x15		// Commands below take one int16.
+#define BINARY_OP_BUILD_BASE_LAYER 0x16
+#define BINARY_OP_TILT_SPEED 0x17
+#define BINARY_OP_TILT_ANGLE 0x18
+#define BINARY_OP_TILT_RES 0x19
+#define BINARY_OP_BUILD_SPEED 0x1A
+#define BINARY_OP_BUILD_RES 0x1B
+#define BINARY_OP_BUILD_MIN_MOVE 0x1C
+#define BINARY_OP_BUILD_ACCEL 0x1D
+#define BINARY_OP_BUILD_RAMP 0x1E
+#define BINARY_OP_BUILD_MOVE 0x1F
+#define BINARY_OP_PRINTING_FLAG 0x20
+#define BINARY_OP_SLICE 0x21
+#define BINARY_OP_N_SLICES 0x22
+#define BINARY_OP_SHUTTER_OPEN_POS 0x23
+#define BINARY_OP_SHUTTER_CLOSE_POS 0x24
+#define BINARY_OP_PEEL_OFFSET 0x25
+#define BINARY_OP_PEEL_TILT_SPEED 0x26
+#define BINARY_OP_PEEL_BUILD_SPEED 0x27
+#define BINARY_OP_TELEMETRY 0x28		// int16 period in ms, 0: off.
+#define BINARY_OP_SHUTTER_OPEN_PULSE 0x29	// int16 pulse width in us.
+#define BINARY_OP_SHUTTER_CLOSE_PULSE 0x2A	// int16 pulse width in us.
+#define BINARY_OP_SHUTTER_SLEW 0x2B		// int16 us per frame, 0: jump.
+#define BINARY_OP_SAVE_CONFIG 0x2C
+#define BINARY_OP_LOAD_CONFIG 0x2D
+#define BINARY_OP_BUILD_MOVE_UM 0x2E	// int16 distance in um.
+#define BINARY_OP_HOME_FAST_SPEED 0x2F	// int16 um/s.
+#define BINARY_OP_HOME_SLOW_SPEED 0x30	// int16 um/s.
+#define BINARY_OP_HOME_BACKOFF 0x31	// int16 um.
+#define BINARY_OP_HOME_TIMEOUT 0x32	// int16 s per stage.
+#define BINARY_OP_JOB_LAYER 0x33		// Print job layer record, see printJob.h.
+#define BINARY_OP_JOB_START 0x34
+#define BINARY_OP_JOB_STOP 0x35
+#define BINARY_OP_EXPOSE 0x36			// uint32 us, uint8 flags, see exposure.h.
+#define BINARY_OP_EXPOSE_STOP 0x37
+#define BINARY_OP_TILT_RETURN_SPEED 0x38	// uint16 °/s, 0: same as forward.
+#define BINARY_OP_TILT_ACCEL 0x39		// uint32 °/s².
+#define BINARY_OP_TILT_CREEP_SPEED 0x3A	// uint16 °/s.
+#define BINARY_OP_TILT_APPROACH 0x3B	// int16 °.
+#define BINARY_OP_AUDIT_TOLERANCE 0x3C	// uint16 um, see positionAudit.h.
+#define BINARY_OP_AUDIT_ACTION 0x3D	// int16 action.
+#define BINARY_OP_AUDIT_RESET 0x3E		// Learn the top switch again.
+#define BINARY_OP_CRASH_CLEAR 0x3F		// Forget the crash record, see watchdog.h.
+#define BINARY_OP_BUILD_FEED 0x40		// uint16 um/s cruise speed.
+#define BINARY_OP_BUILD_SPEED_TABLE 0x41	// uint16 speed index 1--4, uint16 um/s.
+#define BINARY_OP_BUILD_START_SPEED 0x42	// uint16 um/s.
+#define BINARY_OP_BUILD_STEP_ANGLE 0x43	// uint16 1/100 °.
+#define BINARY_OP_BUILD_MICROSTEPS 0x44	// uint16.
+#define BINARY_OP_BUILD_LEAD 0x45		// uint16 um per turn.
+#define BINARY_OP_CONFIG_TAG 0x46		// uint16 host settings tag.
+#define BINARY_OP_COUNT 0x47
+
+// Parser states.
+#define BINARY_STATE_SYNC 0
+#define BINARY_STATE_OPCODE 1
+#define BINARY_STATE_SEQUENCE 2
+#define BINARY_STATE_LENGTH 3
+#define BINARY_STATE_ARGS 4
+#define BINARY_STATE_CRC 5
+
+// Frame parser. One per channel.
+typedef struct
+{
+	uint8_t state;
+	uint8_t opcode;
+	uint8_t sequence;
+	uint8_t length;
+	uint8_t index;
+	uint8_t crc;
+	uint8_t args[BINARY_ARGS_MAX];
+} binaryParser_t;
+
+// Command table entry.
+typedef struct
+{
+	uint8_t length;				// Number of argument bytes.
+	uint8_t (*handler)(int16_t value);	// Returns response status.
+} binaryCommand_t;
+
+
+// Functions. ******************************************************************
+uint8_t binaryCrc8(uint8_t crc, uint8_t data);						// Update CRC-8 with one byte.
+uint8_t binaryParserFeed(binaryParser_t *parser, uint8_t inputByte, uint8_t channel);	// Returns 1 if the byte belongs to a binary frame. Channel 0: USB, 1: UART.
+void binaryParserReset(binaryParser_t *parser);						// Drop a partial frame, wait for sync.
+
+#endif // BINARYCOMMANDS_H
@@ -0,0 +1,86 @@
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "config.h"
+
+
+// *****************************************************************************
+// Configuration variables. ****************************************************
+// *****************************************************************************
+config_t configSlots[CONFIG_SLOTS] EEMEM;
+
+uint8_t configSlot = CONFIG_SLOTS - 1;		// Slot of the current block. First save goes to 0.
+config_t configCurrent;				// Copy of the current block.
+uint8_t configValid = 0;			// configCurrent holds a stored block.
+
+
+// CRC-16-CCITT, polynomial 0x1021, start 0xFFFF. ******************************
+static uint16_t configCrc(const config_t *config)
+{
+	const uint8_t *data = (const uint8_t*)config;
+	uint16_t crc = 0xFFFF;
+	for (uint8_t i=0; i<offsetof(config_t, crc); i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+		for (uint8_t bit=0; bit<8; bit++)
+		{
+			if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+			else crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+
+
+// *****************************************************************************
+// Load newest valid block. ****************************************************
+// *****************************************************************************
+uint8_t configLoad(config_t *config)
+{
+	config_t slot;
+	configValid = 0;
+	for (uint8_t i=0; i<CONFIG_SLOTS; i++)
+	{
+		eeprom_read_block(&slot, &configSlots[i], sizeof(config_t));
+		if (slot.version != CONFIG_VERSION || slot.crc != configCrc(&slot)) continue;
+		// Sequence numbers wrap, compare the difference.
+		if (configValid && (int16_t)(slot.sequence - configCurrent.sequence) <= 0) continue;
+		configCurrent = slot;
+		configSlot = i;
+		configValid = 1;
+	}
+	if (!configValid) return 0;
+	*config = configCurrent;
+	return 1;
+}
+
+
+
+// *****************************************************************************
+// Save block into the next slot. **********************************************
+// *****************************************************************************
+// Blocks for about 3.4 ms per changed byte, up to 250 ms for the whole block.
+// Sequence and CRC change on every save. The steppers keep running in their
+// ISRs, but the main loop stalls, so only save while the printer is idle.
+uint8_t configSave(config_t *config)
+{
+	config->version = CONFIG_VERSION;
+	// Nothing to do if the settings did not change.
+	if (configValid)
+	{
+		config->sequence = configCurrent.sequence;
+		config->crc = configCrc(config);
+		if (!memcmp(config, &configCurrent, sizeof(config_t))) return 0;
+	}
+	config->sequence = configValid ? configCurrent.sequence + 1 : 0;
+	config->crc = configCrc(config);
+
+	configSlot = (configSlot + 1) % CONFIG_SLOTS;
+	eeprom_update_block(config, &configSlots[configSlot], sizeof(config_t));
+	configCurrent = *config;
+	configValid = 1;
+	return 1;
+}
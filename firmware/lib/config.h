@@ -0,0 +1,87 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Persistent configuration. ***************************************************
+// *****************************************************************************
+// Printer settings are kept as one block in EEPROM. Every save goes into the
+// next of CONFIG_SLOTS slots, which spreads the wear over the ring. On load
+// the valid slot with the highest sequence number wins. A slot is valid if
+// version and CRC-16 match, so a save cut short by a reset or power loss
+// falls back to the previous one.
+// Add new fields at the end and bump CONFIG_VERSION: old blocks are ignored
+// and the firmware defaults apply until the host saves again.
+
+// Variables. ******************************************************************
+#define CONFIG_VERSION 6
+#define CONFIG_SLOTS 8
+
+typedef struct
+{
+	uint8_t version;
+	uint16_t sequence;			// Incremented on every save, wraps.
+
+	// Tilt.
+	uint8_t tiltSpeed;
+	uint16_t tiltAngleSteps;
+	uint16_t tiltAngleFull;			// Steps per turn.
+
+	// Build platform.
+	uint8_t buildPlatformSpeed;
+	uint8_t buildPlatformLayer;		// Standard layers.
+	uint8_t buildPlatformBaseLayer;
+	uint16_t buildPlatformResolution;	// Steps per mm.
+	uint8_t buildPlatformMinimumMove;	// Steps per standard layer.
+	uint16_t buildPlatformAcceleration;	// mm/s².
+	uint8_t buildPlatformRampShape;
+
+	// Peel.
+	int16_t peelBuildOffset;
+	uint8_t peelTiltSpeed;
+	uint8_t peelBuildSpeed;
+
+	// Shutter.
+	uint16_t shutterOpenPulse;		// us.
+	uint16_t shutterClosePulse;
+	uint16_t shutterSlew;
+
+	// Homing.
+	uint16_t homingFastSpeed;		// um/s.
+	uint16_t homingSlowSpeed;
+	uint16_t homingBackoff;			// um.
+	uint16_t homingTimeout;			// s per stage.
+
+	// Tilt profile.
+	uint16_t tiltReturnSpeed;		// °/s.
+	uint32_t tiltAcceleration;		// °/s².
+	uint16_t tiltCreepSpeed;		// °/s.
+	uint8_t tiltApproach;			// °.
+
+	// Position audit.
+	uint16_t auditTolerance;		// um.
+	uint8_t auditAction;
+	int32_t auditTopReference;		// Steps.
+
+	// Build platform speeds and mechanics.
+	uint16_t buildPlatformSpeedTable[4];	// um/s per speed index.
+	uint16_t buildPlatformFeedrate;		// um/s.
+	uint16_t buildPlatformStartSpeed;	// um/s.
+	uint16_t buildPlatformStepAngle;	// 1/100 °.
+	uint16_t buildPlatformMicrosteps;
+	uint16_t buildPlatformLead;		// um per turn.
+
+	// Host.
+	uint16_t hostTag;			// Identifies the host settings this block was saved from.
+
+	uint16_t crc;				// CRC-16 of all fields above.
+} config_t;
+
+
+// Functions. ******************************************************************
+uint8_t configLoad(config_t *config);		// Newest valid slot. Returns 0 if there is none.
+uint8_t configSave(config_t *config);		// Returns 0 if unchanged, nothing written.
+
+#endif // CONFIG_H
@@ -0,0 +1,161 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include "../hardware.h"
+#include "exposure.h"
+#include "printerFunctions.h"
+#include "printerCommands.h"
+#include "virtualSerial.h"
+#include "uartSerial.h"
+
+
+// *****************************************************************************
+// Exposure variables. *********************************************************
+// *****************************************************************************
+uint8_t exposureCommandFlags = EXPOSURE_SHUTTER;	// Used by the expose command.
+volatile uint8_t exposureActiveFlags = 0;
+volatile uint8_t exposureActive = 0;		// Cleared by ISR at the end.
+volatile uint32_t exposureTicks = 0;		// Tick ISRs until the last ms. Full uint32 us range.
+volatile uint8_t exposureRest = 0;		// Counts in the last ms.
+volatile uint8_t exposureArmed = 0;		// Compare B set up for the last ms.
+uint8_t exposureBeginPending = 0;		// Events to send in the main loop.
+volatile uint8_t exposureEndPending = 0;
+
+
+void exposureSetFlags (uint8_t input)
+{
+	exposureCommandFlags = input;
+}
+
+uint8_t exposureGetFlags (void)
+{
+	return exposureCommandFlags;
+}
+
+uint8_t exposureRunning (void)
+{
+	return exposureActive;
+}
+
+
+// End exposure. Interrupts off. ***********************************************
+static void exposureEnd (void)
+{
+	TIMSK0 &= ~(1 << OCIE0B);
+	exposureArmed = 0;
+	if (exposureActiveFlags & EXPOSURE_CAMERA) CAMPORT &= ~(1 << CAMPIN);
+	if (exposureActiveFlags & EXPOSURE_SHUTTER) shutterClose();
+	if (exposureActiveFlags & EXPOSURE_EVENTS) exposureEndPending = 1;
+	exposureActive = 0;
+}
+
+
+// Arm compare B for the rest of the last ms. Interrupts off. *****************
+// Compare B matches every ms, the flag may be set already. The ISR checks
+// the timer instead of relying on a cleared flag.
+static void exposureArm (void)
+{
+	if (TCNT0 >= exposureRest)
+	{
+		exposureEnd();
+		return;
+	}
+	OCR0B = exposureRest;
+	exposureArmed = 1;
+	TIMSK0 |= (1 << OCIE0B);
+}
+
+
+
+// *****************************************************************************
+// Start and stop. *************************************************************
+// *****************************************************************************
+uint8_t exposureStart (uint32_t microseconds, uint8_t flags)
+{
+	if (exposureActive) return 0;
+	// Round without overflowing near the top of the range.
+	uint32_t counts = microseconds / EXPOSURE_COUNT_US + ((microseconds % EXPOSURE_COUNT_US) >= EXPOSURE_COUNT_US / 2);
+	if (counts < 1) counts = 1;
+
+	// Shutter first, the servo takes a while anyway.
+	if (flags & EXPOSURE_SHUTTER) shutterOpen();
+
+	uint8_t sreg = SREG;
+	cli();
+	// Count from now: the end is counts after the current timer value.
+	// The tick ISR changes exposureTicks, it is set with interrupts off.
+	counts += TCNT0;
+	exposureTicks = counts / EXPOSURE_TICK_COUNTS;
+	exposureRest = counts % EXPOSURE_TICK_COUNTS;
+	// A tick that is pending already belongs to the ms before.
+	if (TIFR0 & (1 << OCF0A)) exposureTicks++;
+	exposureActiveFlags = flags;
+	exposureActive = 1;
+	if (flags & EXPOSURE_CAMERA) CAMPORT |= (1 << CAMPIN);
+	// Ends within this ms.
+	if (!exposureTicks) exposureArm();
+	SREG = sreg;
+
+	if (flags & EXPOSURE_EVENTS) exposureBeginPending = 1;
+	return 1;
+}
+
+void exposureStop (void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	if (exposureActive) exposureEnd();
+	SREG = sreg;
+}
+
+
+
+// *****************************************************************************
+// Events. Call in main loop. **************************************************
+// *****************************************************************************
+void exposureService (void)
+{
+	if (exposureBeginPending)
+	{
+		exposureBeginPending = 0;
+		if (!(getUartFlag())) sendStringUSB("exposeBegin\n");
+		else	sendStringUART("exposeBegin\n");
+	}
+	if (exposureEndPending)
+	{
+		exposureEndPending = 0;
+		if (!(getUartFlag())) sendStringUSB("exposeEnd\n");
+		else	sendStringUART("exposeEnd\n");
+	}
+}
+
+
+
+// *****************************************************************************
+// Interrupts. *****************************************************************
+// *****************************************************************************
+// Timer 0 compare A, every ms.
+void exposureTick (void)
+{
+	// Armed and a new ms started: compare B match is over.
+	if (exposureArmed)
+	{
+		exposureEnd();
+		return;
+	}
+	if (!exposureActive || !exposureTicks) return;
+	if (--exposureTicks == 0)
+	{
+		if (exposureRest) exposureArm();
+		else exposureEnd();
+	}
+}
+
+// Timer 0 compare B, in the last ms.
+void exposureCompare (void)
+{
+	// Match from before arming.
+	if (exposureArmed && TCNT0 < exposureRest) return;
+	if (exposureActive) exposureEnd();
+	else TIMSK0 &= ~(1 << OCIE0B);
+}
@@ -0,0 +1,46 @@
+#ifndef EXPOSURE_H
+#define EXPOSURE_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Exposure timer. *************************************************************
+// *****************************************************************************
+// Times an exposure in hardware instead of on the host. There is no timer to
+// spare for it: timer 1 drives the build platform, timer 3 the tilt and
+// timer 4 the shutter servo. Timer 0 runs the 1 ms tick (CTC, prescaler 64,
+// see hardware.c) and has a free compare channel B, so the exposure shares
+// timer 0 with the tick. Whole milliseconds are counted in the tick ISR, the
+// rest of the interval ends on a channel B compare match. Resolution is one
+// timer count, 4 us. The end runs in the compare B ISR, late by at most the
+// ISR that is running at that moment (step generators, USB), tens of us.
+// The start is when the command is handled in the main loop.
+// The whole uint32 range is accepted, up to about 71 minutes.
+// The end of the exposure (shutter close, camera pin low) happens inside the
+// ISR, so it does not depend on the main loop or the host.
+// Optionally the camera pin is held high during the exposure, e.g. to gate
+// the projector or trigger a camera, and "exposeBegin" / "exposeEnd" are sent
+// on the command channel.
+
+// Variables. ******************************************************************
+#define EXPOSURE_COUNT_US 4				// us per timer 0 count.
+#define EXPOSURE_TICK_COUNTS 250			// Timer 0 counts per tick, OCR0A + 1.
+
+// Flags.
+#define EXPOSURE_SHUTTER (1 << 0)			// Open the shutter.
+#define EXPOSURE_CAMERA (1 << 1)			// Camera pin high during exposure.
+#define EXPOSURE_EVENTS (1 << 2)			// Send begin and end events.
+
+
+// Functions. ******************************************************************
+uint8_t exposureStart(uint32_t microseconds, uint8_t flags);	// Returns 0 if an exposure is running already.
+void exposureStop(void);				// End exposure now.
+uint8_t exposureRunning(void);
+void exposureSetFlags(uint8_t input);			// Flags for the expose command.
+uint8_t exposureGetFlags(void);
+void exposureService(void);				// Call in main loop. Sends events.
+void exposureTick(void);				// Call from timer 0 compare A ISR.
+void exposureCompare(void);				// Call from timer 0 compare B ISR.
+
+#endif // EXPOSURE_H
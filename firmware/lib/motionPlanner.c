@@ -0,0 +1,106 @@
+#include <avr/io.h>
+#include <stdint.h>
+#include "motionPlanner.h"
+
+
+// *****************************************************************************
+// Conversion functions. *******************************************************
+// *****************************************************************************
+// The stepper timers run in CTC mode and toggle the clock pin on every compare
+// match. One step therefore takes two compare periods:
+//	step rate = timer clock / (2 * (compare value + 1))
+// The compare value is kept with 8 fractional bits. The step generator adds
+// the fraction up and stretches single periods by one tick when it overflows.
+// Timer clock is F_CPU through the finest prescaler that fits the rate.
+static const uint16_t motionPrescalers[MOTION_PRESCALER_COUNT] = { 1, 8, 64, 256, 1024 };
+
+void motionRateToCompareValue(float stepRate, motionRampEntry_t *entry)
+{
+	float compareValue;
+	uint8_t index = 0;
+	if (stepRate < 1.0) stepRate = 1.0;
+	// Timer ticks per compare period at prescaler 1.
+	float ticks = (float)F_CPU / (2.0 * stepRate);
+	while (index < MOTION_PRESCALER_COUNT - 1 && ticks > 65536.0 * motionPrescalers[index]) index++;
+	entry->clockSelect = index + 1;
+	compareValue = ticks / motionPrescalers[index] - 1.0;
+	// Cap to 16 bit timer range.
+	if (compareValue > 65535.0)
+	{
+		entry->compareValue = 65535;
+		entry->compareFraction = 0;
+	}
+	else if (compareValue < 1.0)
+	{
+		entry->compareValue = 1;
+		entry->compareFraction = 0;
+	}
+	else
+	{
+		uint32_t fixedPoint = (uint32_t)(compareValue * 256.0);
+		entry->compareValue = fixedPoint >> 8;
+		entry->compareFraction = fixedPoint & 0xFF;
+	}
+}
+
+float motionCompareValueToRate(uint16_t compareValue, uint32_t timerClock)
+{
+	return (float)timerClock / (2.0 * ((float)compareValue + 1.0));
+}
+
+
+
+// *****************************************************************************
+// Plan a move. ****************************************************************
+// *****************************************************************************
+// Fill the ramp table for a move of the given number of steps.
+// Rates in steps/s, acceleration in steps/s². Run this in the main loop before
+// the stepper timer is started, it uses floating point math.
+void motionPlannerPlan(motionProfile_t *profile, uint32_t steps, float startRate, float cruiseRate, float acceleration, uint8_t shape)
+{
+	uint32_t rampSteps = 0;
+	uint8_t level = 0;
+
+	profile->rampLength = 0;
+	motionRateToCompareValue(cruiseRate, &profile->cruise);
+
+	if (cruiseRate > startRate && acceleration > 0)
+	{
+		// Duration of the full ramp. The S-curve peaks at 1.5 times its
+		// mean acceleration, stretch it so the peak stays within limits.
+		float rampTime = (cruiseRate - startRate) / acceleration;
+		if (shape == MOTION_PROFILE_SCURVE) rampTime *= 1.5;
+		float levelTime = rampTime / MOTION_RAMP_TABLE_SIZE;
+
+		for (level = 0; level < MOTION_RAMP_TABLE_SIZE; level++)
+		{
+			// Use the speed in the middle of each time slice.
+			float x = ((float)level + 0.5) / MOTION_RAMP_TABLE_SIZE;
+			if (shape == MOTION_PROFILE_SCURVE) x = x * x * (3.0 - 2.0 * x);
+			float rate = startRate + (cruiseRate - startRate) * x;
+			float levelSteps = rate * levelTime + 0.5;
+			if (levelSteps < 1.0) levelSteps = 1.0;
+			if (levelSteps > 65535.0) levelSteps = 65535.0;
+
+			// Short move: stop ramping at half the distance.
+			// The ramp down mirrors the ramp up.
+			if (steps != MOTION_STEPS_ENDLESS && 2 * (rampSteps + (uint32_t)levelSteps) > steps) break;
+
+			motionRateToCompareValue(rate, &profile->ramp[level]);
+			profile->ramp[level].steps = (uint16_t)levelSteps;
+			rampSteps += (uint16_t)levelSteps;
+		}
+		profile->rampLength = level;
+
+		// Triangle profile: top speed is the last level reached.
+		if (level > 0 && level < MOTION_RAMP_TABLE_SIZE)
+		{
+			profile->cruise = profile->ramp[level-1];
+		}
+		// Move too short for any ramp: run at start speed.
+		else if (level == 0)
+		{
+			motionRateToCompareValue(startRate, &profile->cruise);
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef MOTIONPLANNER_H
+#define MOTIONPLANNER_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Motion planner. *************************************************************
+// *****************************************************************************
+// Plans acceleration ramps for the stepper timers. The ramp is calculated once
+// when a move starts and stored as a table of speed levels. Each level holds a
+// timer compare value and the number of steps to run at that level. All levels
+// take the same amount of time, so the resulting ramp is linear in time.
+// The stepper ISR only walks through that table (see stepGenerator.h).
+// Each level also holds the timer prescaler: the finest one whose 16 bit
+// compare range reaches the level's rate. Fast levels keep the resolution of
+// prescaler 1, slow ones get down to about 1 step/s. The step generator
+// switches the prescaler when it enters a level.
+
+// Variables. ******************************************************************
+#define MOTION_RAMP_TABLE_SIZE 32		// Number of speed levels per ramp. 6 bytes each.
+
+#define MOTION_PROFILE_TRAPEZOID 0		// Constant acceleration.
+#define MOTION_PROFILE_SCURVE 1			// Jerk limited (smoothstep velocity).
+
+#define MOTION_STEPS_ENDLESS 0xFFFFFFFF		// Run until stopped, e.g. by a limit switch. No deceleration.
+
+#define MOTION_PRESCALER_COUNT 5		// Timer 1 and 3: 1, 8, 64, 256, 1024.
+
+// One speed level of a ramp.
+// The step interval is compareValue + compareFraction/256 timer ticks.
+typedef struct
+{
+	uint16_t compareValue;			// Timer compare value on this level.
+	uint8_t compareFraction;		// Fractional part of the compare value in 1/256.
+	uint16_t steps;				// Number of steps to run on this level.
+	uint8_t clockSelect;			// Timer 1/3 clock select bits for this level.
+} motionRampEntry_t;
+
+// Precomputed ramp of one move.
+typedef struct
+{
+	motionRampEntry_t ramp[MOTION_RAMP_TABLE_SIZE];
+	uint8_t rampLength;			// Number of used ramp levels.
+	motionRampEntry_t cruise;		// Speed after the ramp. Steps unused.
+} motionProfile_t;
+
+
+// Functions. ******************************************************************
+void motionRateToCompareValue(float stepRate, motionRampEntry_t *entry);		// Steps per second to prescaler and CTC compare value.
+float motionCompareValueToRate(uint16_t compareValue, uint32_t timerClock);		// CTC compare value to steps per second.
+void motionPlannerPlan(motionProfile_t *profile, uint32_t steps, float startRate, float cruiseRate, float acceleration, uint8_t shape);
+
+#endif // MOTIONPLANNER_H
@@ -0,0 +1,140 @@
+#include <avr/io.h>
+#include <stdint.h>
+#include "motionQueue.h"
+#include "printerFunctions.h"
+
+
+// *****************************************************************************
+// Queue variables. ************************************************************
+// *****************************************************************************
+motionSegment_t motionQueue[MOTION_QUEUE_SIZE];
+uint8_t motionQueueHead = 0;			// Next free slot.
+uint8_t motionQueueTail = 0;			// Next segment to run.
+uint8_t motionSegmentActive = MOTION_SEGMENT_NONE;
+
+// Dwell timer. Counted down in the timer 0 ISR.
+volatile uint16_t motionDwellCount = 0;		// Milliseconds.
+volatile uint8_t motionDwellFlag = 0;		// Set while dwelling. Cleared by ISR.
+
+
+// *****************************************************************************
+// Queue access. ***************************************************************
+// *****************************************************************************
+uint8_t motionQueuePush(uint8_t type, int16_t value)
+{
+	uint8_t nextHead = (motionQueueHead + 1) & MOTION_QUEUE_MASK;
+	// Queue full?
+	if (nextHead == motionQueueTail) return 0;
+	motionQueue[motionQueueHead].type = type;
+	motionQueue[motionQueueHead].value = value;
+	motionQueueHead = nextHead;
+	return 1;
+}
+
+void motionQueueClear(void)
+{
+	motionQueueTail = motionQueueHead;
+}
+
+uint8_t motionQueueDepth(void)
+{
+	return (motionQueueHead - motionQueueTail) & MOTION_QUEUE_MASK;
+}
+
+uint8_t motionQueueActiveSegment(void)
+{
+	return motionSegmentActive;
+}
+
+uint8_t motionQueueIdle(void)
+{
+	return (motionQueueHead == motionQueueTail) && (motionSegmentActive == MOTION_SEGMENT_NONE);
+}
+
+
+
+// *****************************************************************************
+// Run segments. Call in main loop. ********************************************
+// *****************************************************************************
+void motionQueueService(void)
+{
+	// Check if the running segment has finished. *********************
+	switch (motionSegmentActive)
+	{
+		case MOTION_SEGMENT_BUILD_MOVE:
+		case MOTION_SEGMENT_BUILD_LAYER:
+			if (stepGeneratorRunning(&buildStepper)) return;
+			break;
+		case MOTION_SEGMENT_TILT:
+			if (tiltStepperRunning()) return;
+			break;
+		case MOTION_SEGMENT_DWELL:
+			if (motionDwellFlag) return;
+			break;
+		case MOTION_SEGMENT_PEEL:
+			if (!peelIdle()) return;
+			break;
+		default:
+			break;
+	}
+	motionSegmentActive = MOTION_SEGMENT_NONE;
+
+	// Start next segments. Instant segments don't block the queue. ***
+	while (motionQueueTail != motionQueueHead)
+	{
+		motionSegment_t *segment = &motionQueue[motionQueueTail];
+		motionQueueTail = (motionQueueTail + 1) & MOTION_QUEUE_MASK;
+
+		switch (segment->type)
+		{
+			case MOTION_SEGMENT_BUILD_MOVE:
+				buildPlatformMove(segment->value);
+				buildPlatformComparePosition(buildPlatformFeedrate);
+				motionSegmentActive = segment->type;
+				return;
+			case MOTION_SEGMENT_BUILD_LAYER:
+				buildPlatformLayerUp();
+				buildPlatformComparePosition(buildPlatformFeedrate);
+				motionSegmentActive = segment->type;
+				return;
+			case MOTION_SEGMENT_TILT:
+				tilt(tiltAngle, tiltSpeed);
+				motionSegmentActive = segment->type;
+				return;
+			case MOTION_SEGMENT_PEEL:
+				peel();
+				motionSegmentActive = segment->type;
+				return;
+			case MOTION_SEGMENT_DWELL:
+				if (segment->value <= 0) break;
+				motionDwellCount = segment->value;
+				motionDwellFlag = 1;
+				motionSegmentActive = segment->type;
+				return;
+			case MOTION_SEGMENT_SHUTTER_OPEN:
+				shutterOpen();
+				break;
+			case MOTION_SEGMENT_SHUTTER_CLOSE:
+				shutterClose();
+				break;
+			case MOTION_SEGMENT_CAMERA:
+				triggerCamera();
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+
+
+// *****************************************************************************
+// Dwell timer. Call from 1 ms timer ISR. **************************************
+// *****************************************************************************
+void motionQueueTick(void)
+{
+	if (motionDwellFlag)
+	{
+		if (--motionDwellCount == 0) motionDwellFlag = 0;
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef MOTIONQUEUE_H
+#define MOTIONQUEUE_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Motion queue. ***************************************************************
+// *****************************************************************************
+// Ring buffer of motion segments. The host can push a whole layer worth of
+// segments at once. Segments run back to back: the next one is started as soon
+// as the previous one has finished, without waiting for the host.
+
+// Variables. ******************************************************************
+#define MOTION_QUEUE_SIZE 16				// Must be a power of two.
+#define MOTION_QUEUE_MASK (MOTION_QUEUE_SIZE - 1)
+
+// Segment types.
+#define MOTION_SEGMENT_NONE 0
+#define MOTION_SEGMENT_BUILD_MOVE 1			// Move build platform by value standard layers.
+#define MOTION_SEGMENT_BUILD_LAYER 2			// Move build platform up by one layer.
+#define MOTION_SEGMENT_TILT 3				// One tilt cycle.
+#define MOTION_SEGMENT_DWELL 4				// Wait for value milliseconds.
+#define MOTION_SEGMENT_SHUTTER_OPEN 5
+#define MOTION_SEGMENT_SHUTTER_CLOSE 6
+#define MOTION_SEGMENT_CAMERA 7				// Trigger camera.
+#define MOTION_SEGMENT_PEEL 8				// Tilt and layer up, overlapped.
+
+typedef struct
+{
+	uint8_t type;
+	int16_t value;
+} motionSegment_t;
+
+
+// Functions. ******************************************************************
+uint8_t motionQueuePush(uint8_t type, int16_t value);	// Returns 0 if queue is full.
+void motionQueueClear(void);				// Drop all pending segments.
+uint8_t motionQueueDepth(void);				// Number of pending segments.
+uint8_t motionQueueActiveSegment(void);			// Type of running segment.
+uint8_t motionQueueIdle(void);				// 1 if nothing pending or running.
+void motionQueueService(void);				// Call in main loop.
+void motionQueueTick(void);				// Call from 1 ms timer ISR.
+
+#endif // MOTIONQUEUE_H
@@ -0,0 +1,159 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "positionAudit.h"
+#include "printJob.h"
+#include "printerFunctions.h"
+#include "printerCommands.h"
+#include "virtualSerial.h"
+#include "uartSerial.h"
+
+
+// *****************************************************************************
+// Audit variables. ************************************************************
+// *****************************************************************************
+uint16_t auditTolerance = 100;			// um.
+uint8_t auditAction = POSITION_AUDIT_REPORT;
+int32_t auditTopReference = 0;			// Steps, 0: not learned yet.
+uint8_t auditReferenced = 0;			// Step count is valid, set by homing.
+uint8_t auditFailedFlag = 0;
+int16_t auditDrift[2] = {0, 0};
+
+// Written by the limit switch ISRs, read in the main loop.
+volatile uint8_t auditPending = 0;		// Bit per switch.
+volatile int32_t auditHit[2];			// Step count at the switch.
+
+
+void positionAuditSetTolerance (uint16_t input)
+{
+	auditTolerance = input;
+}
+
+uint16_t positionAuditGetTolerance (void)
+{
+	return auditTolerance;
+}
+
+void positionAuditSetAction (uint8_t input)
+{
+	if (input > POSITION_AUDIT_REHOME) input = POSITION_AUDIT_REHOME;
+	auditAction = input;
+}
+
+uint8_t positionAuditGetAction (void)
+{
+	return auditAction;
+}
+
+void positionAuditSetTopReference (int32_t input)
+{
+	auditTopReference = input;
+}
+
+int32_t positionAuditGetTopReference (void)
+{
+	return auditTopReference;
+}
+
+int16_t positionAuditGetDrift (uint8_t limitSwitch)
+{
+	return auditDrift[limitSwitch];
+}
+
+uint8_t positionAuditFailed (void)
+{
+	return auditFailedFlag;
+}
+
+uint8_t positionAuditReferenced (void)
+{
+	return auditReferenced;
+}
+
+void positionAuditHomed (void)
+{
+	auditReferenced = 1;
+	auditFailedFlag = 0;
+}
+
+void positionAuditLost (void)
+{
+	auditReferenced = 0;
+}
+
+
+
+// *****************************************************************************
+// Limit switches. Call from the ISRs before the position is changed. *********
+// *****************************************************************************
+void positionAuditSwitch (uint8_t limitSwitch, int32_t position)
+{
+	if (!auditReferenced) return;
+	auditHit[limitSwitch] = position;
+	auditPending |= (1 << limitSwitch);
+	// Homing zeroes the count at the first bottom hit, the slow approach hit
+	// is relative to that and says nothing.
+	if (buildPlatformHomingFlag) auditReferenced = 0;
+}
+
+
+
+// *****************************************************************************
+// Check drift. Call in main loop. *********************************************
+// *****************************************************************************
+// Send "drift <switch> <steps>" on the command channel.
+static void positionAuditEvent (uint8_t limitSwitch, int32_t drift)
+{
+	char eventString[24];
+	strcpy(eventString, "drift ");
+	utoa(limitSwitch, eventString + strlen(eventString), 10);
+	strcat(eventString, " ");
+	ltoa(drift, eventString + strlen(eventString), 10);
+	strcat(eventString, "\n");
+	if (!(getUartFlag())) sendStringUSB(eventString);
+	else	sendStringUART(eventString);
+}
+
+static void positionAuditCheck (uint8_t limitSwitch, int32_t drift)
+{
+	// Telemetry field is 16 bit.
+	if (drift > INT16_MAX) auditDrift[limitSwitch] = INT16_MAX;
+	else if (drift < INT16_MIN) auditDrift[limitSwitch] = INT16_MIN;
+	else auditDrift[limitSwitch] = drift;
+
+	uint32_t tolerance = (uint32_t)auditTolerance * buildPlatformResolution / 1000;
+	if ((uint32_t)labs(drift) <= tolerance) return;
+
+	auditFailedFlag = 1;
+	positionAuditEvent(limitSwitch, drift);
+	if (auditAction == POSITION_AUDIT_REPORT) return;
+	printJobStop();
+	if (auditAction == POSITION_AUDIT_REHOME && !buildPlatformHomingFlag) buildPlatformHome();
+}
+
+void positionAuditService (void)
+{
+	if (!auditPending) return;
+
+	uint8_t pending;
+	int32_t hit[2];
+	uint8_t sreg = SREG;
+	cli();
+	pending = auditPending;
+	auditPending = 0;
+	hit[POSITION_AUDIT_BOTTOM] = auditHit[POSITION_AUDIT_BOTTOM];
+	hit[POSITION_AUDIT_TOP] = auditHit[POSITION_AUDIT_TOP];
+	SREG = sreg;
+
+	// Step 0 is the bottom switch.
+	if (pending & (1 << POSITION_AUDIT_BOTTOM)) positionAuditCheck(POSITION_AUDIT_BOTTOM, hit[POSITION_AUDIT_BOTTOM]);
+
+	if (pending & (1 << POSITION_AUDIT_TOP))
+	{
+		// First top hit since the reference was reset: learn it.
+		if (!auditTopReference) auditTopReference = hit[POSITION_AUDIT_TOP];
+		else positionAuditCheck(POSITION_AUDIT_TOP, hit[POSITION_AUDIT_TOP] - auditTopReference);
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef POSITIONAUDIT_H
+#define POSITIONAUDIT_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Position audit. *************************************************************
+// *****************************************************************************
+// Catches lost build platform steps with the limit switches. Once homed, the
+// step count says where each switch must close:
+//	bottom switch at step 0,
+//	top switch where it closed the first time after homing (learned, saved
+//	with the config).
+// The switch ISRs record the step count at which the switch really closed.
+// The difference is the drift. The bottom switch is checked on every hit,
+// including the fast stage of the next homing, the slow stage hit is the new
+// reference. If the drift exceeds the tolerance,
+//	"drift <switch> <steps>" (switch 0: bottom, 1: top)
+// is sent on the command channel, the status bit in telemetry is set until
+// the next homing and the configured action runs.
+
+// Variables. ******************************************************************
+#define POSITION_AUDIT_BOTTOM 0
+#define POSITION_AUDIT_TOP 1
+
+// Actions on drift over tolerance.
+#define POSITION_AUDIT_REPORT 0				// Event and telemetry only.
+#define POSITION_AUDIT_STOP 1				// Also stop the print job.
+#define POSITION_AUDIT_REHOME 2				// Also stop the print job and home.
+
+
+// Functions. ******************************************************************
+void positionAuditSetTolerance(uint16_t input);		// um.
+uint16_t positionAuditGetTolerance(void);
+void positionAuditSetAction(uint8_t input);
+uint8_t positionAuditGetAction(void);
+void positionAuditSetTopReference(int32_t input);	// Steps, 0: learn on the next top hit.
+int32_t positionAuditGetTopReference(void);
+int16_t positionAuditGetDrift(uint8_t limitSwitch);	// Last measured drift in steps.
+uint8_t positionAuditFailed(void);			// Drift over tolerance since homing.
+uint8_t positionAuditReferenced(void);			// Homed, step count valid.
+void positionAuditHomed(void);				// Homing done, step 0 is the bottom switch again.
+void positionAuditLost(void);				// Position unknown, e.g. homing aborted.
+void positionAuditService(void);			// Call in main loop.
+void positionAuditSwitch(uint8_t limitSwitch, int32_t position);	// Call from the limit switch ISRs.
+
+#endif // POSITIONAUDIT_H
@@ -0,0 +1,190 @@
+#include <avr/io.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "printJob.h"
+#include "exposure.h"
+#include "printerFunctions.h"
+#include "printerCommands.h"
+#include "virtualSerial.h"
+#include "uartSerial.h"
+
+
+// *****************************************************************************
+// Job variables. **************************************************************
+// *****************************************************************************
+printJobLayer_t printJobRing[PRINT_JOB_SIZE];
+uint8_t printJobHead = 0;			// Next free slot.
+uint8_t printJobTail = 0;			// Next layer to run.
+uint8_t printJobCurrentState = PRINT_JOB_IDLE;
+printJobLayer_t printJobCurrent;		// Running layer.
+uint16_t printJobLayerIndex = 0;
+
+// Settle timer. Counted down in the timer 0 ISR. Exposures run on the
+// exposure timer, see exposure.h.
+volatile uint16_t printJobCount = 0;		// Milliseconds.
+volatile uint8_t printJobTimerFlag = 0;		// Set while counting. Cleared by ISR.
+
+
+// *****************************************************************************
+// Ring access. ****************************************************************
+// *****************************************************************************
+uint8_t printJobPush(printJobLayer_t *layer)
+{
+	uint8_t nextHead = (printJobHead + 1) & PRINT_JOB_MASK;
+	// Ring full?
+	if (nextHead == printJobTail) return 0;
+	printJobRing[printJobHead] = *layer;
+	printJobHead = nextHead;
+	return 1;
+}
+
+uint8_t printJobDepth(void)
+{
+	return (printJobHead - printJobTail) & PRINT_JOB_MASK;
+}
+
+uint8_t printJobState(void)
+{
+	return printJobCurrentState;
+}
+
+uint8_t printJobIdle(void)
+{
+	return printJobCurrentState == PRINT_JOB_IDLE;
+}
+
+
+
+// *****************************************************************************
+// Events. *********************************************************************
+// *****************************************************************************
+// Send "<name> <layer>" on the command channel.
+static void printJobEvent(char *name)
+{
+	char eventString[24];
+	strcpy(eventString, name);
+	strcat(eventString, " ");
+	utoa(printJobLayerIndex, eventString + strlen(eventString), 10);
+	strcat(eventString, "\n");
+	if (!(getUartFlag())) sendStringUSB(eventString);
+	else	sendStringUART(eventString);
+}
+
+static void printJobTimer(uint16_t milliseconds)
+{
+	printJobCount = milliseconds;
+	printJobTimerFlag = (milliseconds > 0);
+}
+
+
+// End exposure of the running layer. ******************************************
+// The exposure timer has closed the shutter already.
+static void printJobExposeEnd(void)
+{
+	printJobEvent("exposeEnd");
+	if (printJobCurrent.flags & PRINT_JOB_CAMERA_END) triggerCamera();
+}
+
+
+
+// *****************************************************************************
+// Start and stop. *************************************************************
+// *****************************************************************************
+void printJobStart(void)
+{
+	if (printJobCurrentState != PRINT_JOB_IDLE) return;
+	printJobLayerIndex = 0;
+	printerSetSlice(0);
+	printJobCurrentState = PRINT_JOB_WAIT;
+}
+
+void printJobStop(void)
+{
+	printJobTimerFlag = 0;
+	if (printJobCurrentState == PRINT_JOB_EXPOSE)
+	{
+		exposureStop();
+		printJobExposeEnd();
+	}
+	printJobTail = printJobHead;
+	printJobCurrentState = PRINT_JOB_IDLE;
+}
+
+
+
+// *****************************************************************************
+// Run layers. Call in main loop. **********************************************
+// *****************************************************************************
+void printJobService(void)
+{
+	switch (printJobCurrentState)
+	{
+		case PRINT_JOB_WAIT:
+			// Next record.
+			if (printJobTail == printJobHead) return;
+			printJobCurrent = printJobRing[printJobTail];
+			printJobTail = (printJobTail + 1) & PRINT_JOB_MASK;
+			printerSetSlice(printJobLayerIndex);
+			// Tilt and build platform move overlapped.
+			if (printJobCurrent.flags & PRINT_JOB_PEEL)
+			{
+				peelMicrons(printJobCurrent.buildMove);
+				printJobCurrentState = PRINT_JOB_TILT;
+				break;
+			}
+			// Build platform move.
+			buildPlatformMoveMicrons(printJobCurrent.buildMove);
+			buildPlatformComparePosition(buildPlatformFeedrate);
+			printJobCurrentState = PRINT_JOB_MOVE;
+			break;
+
+		case PRINT_JOB_MOVE:
+			if (stepGeneratorRunning(&buildStepper)) return;
+			// Tilt.
+			if (printJobCurrent.tiltSpeed) tilt(tiltAngle, printJobCurrent.tiltSpeed);
+			printJobCurrentState = PRINT_JOB_TILT;
+			break;
+
+		case PRINT_JOB_TILT:
+			if (tiltStepperRunning() || !peelIdle()) return;
+			// Let the resin settle.
+			printJobTimer(printJobCurrent.settle);
+			printJobCurrentState = PRINT_JOB_SETTLE;
+			break;
+
+		case PRINT_JOB_SETTLE:
+			if (printJobTimerFlag) return;
+			// Expose. If a manual exposure is still running, wait for it,
+			// the layer gets an exposure of its own.
+			if (!exposureStart((uint32_t)printJobCurrent.exposure * 1000, (printJobCurrent.flags & PRINT_JOB_SHUTTER) ? EXPOSURE_SHUTTER : 0)) return;
+			printJobEvent("expose");
+			if (printJobCurrent.flags & PRINT_JOB_CAMERA_START) triggerCamera();
+			printJobCurrentState = PRINT_JOB_EXPOSE;
+			break;
+
+		case PRINT_JOB_EXPOSE:
+			if (exposureRunning()) return;
+			printJobExposeEnd();
+			printJobLayerIndex++;
+			if (printJobCurrent.flags & PRINT_JOB_LAST) printJobCurrentState = PRINT_JOB_IDLE;
+			else printJobCurrentState = PRINT_JOB_WAIT;
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+
+// *****************************************************************************
+// Settle timer. Call from 1 ms timer ISR. *************************************
+// *****************************************************************************
+void printJobTick(void)
+{
+	if (printJobTimerFlag)
+	{
+		if (--printJobCount == 0) printJobTimerFlag = 0;
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef PRINTJOB_H
+#define PRINTJOB_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Print job. ******************************************************************
+// *****************************************************************************
+// Per layer program run by the firmware. The host streams one compact record
+// per layer into a ring buffer and starts the job. Each layer runs
+//	build platform move -> tilt -> settle -> exposure
+// back to back without waiting for the host. With the peel flag, move and
+// tilt run overlapped as in peel(), with the peel tilt speed. At the start and end of each
+// exposure an event line is sent on the command channel:
+//	"expose <layer>"	show the layer image now,
+//	"exposeEnd <layer>"	exposure over, show black.
+// The host keeps the ring filled while the job runs, records pushed into a
+// full ring are refused (binary status "full"). If the ring runs empty the
+// job waits for the next record. The job ends after the record flagged last
+// and "done" is sent.
+
+// Variables. ******************************************************************
+#define PRINT_JOB_SIZE 16				// Must be a power of two.
+#define PRINT_JOB_MASK (PRINT_JOB_SIZE - 1)
+
+// Layer flags.
+#define PRINT_JOB_SHUTTER (1 << 0)			// Open the shutter during exposure.
+#define PRINT_JOB_CAMERA_START (1 << 1)			// Trigger camera at start of exposure.
+#define PRINT_JOB_CAMERA_END (1 << 2)			// Trigger camera after exposure.
+#define PRINT_JOB_LAST (1 << 3)				// Last layer, end job afterwards.
+#define PRINT_JOB_PEEL (1 << 4)				// Move while tilting, see peel().
+
+// Job states.
+#define PRINT_JOB_IDLE 0
+#define PRINT_JOB_WAIT 1				// Waiting for the next record.
+#define PRINT_JOB_MOVE 2				// Build platform move.
+#define PRINT_JOB_TILT 3
+#define PRINT_JOB_SETTLE 4				// Resin settle time.
+#define PRINT_JOB_EXPOSE 5
+
+// One layer. Binary record layout, little endian:
+//	int16 z | uint8 tilt speed | uint8 flags | uint16 settle | uint16 exposure
+typedef struct
+{
+	int16_t buildMove;				// um, relative.
+	uint8_t tiltSpeed;				// 0: no tilt.
+	uint8_t flags;
+	uint16_t settle;				// ms.
+	uint16_t exposure;				// ms.
+} printJobLayer_t;
+
+
+// Functions. ******************************************************************
+uint8_t printJobPush(printJobLayer_t *layer);		// Returns 0 if the ring is full.
+void printJobStart(void);				// Run records from layer 0.
+void printJobStop(void);				// Abort, close shutter and drop records.
+uint8_t printJobDepth(void);				// Number of pending records.
+uint8_t printJobState(void);
+uint8_t printJobIdle(void);				// 1 if no job is running.
+void printJobService(void);				// Call in main loop.
+void printJobTick(void);				// Call from 1 ms timer ISR.
+
+#endif // PRINTJOB_H
@@ -6,62 +6,133 @@
 #include "lib/uartSerial.h"		// Load custom serial functions.
 #include "lib/virtualSerial.h"	// Load USB virtual serial functions.
 #include "lib/printerFunctions.h"	// Load printer functions.
+#include "lib/motionQueue.h"	// Load motion queue functions.
+#include "lib/printJob.h"	// Load print job functions.
+#include "lib/exposure.h"	// Load exposure timer functions.
+#include "lib/binaryCommands.h"	// Load binary protocol.
+#include "lib/telemetry.h"	// Load telemetry functions.
+#include "lib/positionAudit.h"	// Load position audit functions.
+#include "lib/watchdog.h"	// Load crash record functions.
+#include "lib/uart.h"
 
 
-char inputString[30];
+char inputString[COMMAND_LINE_SIZE];
 char inputStringUart[30];
 char* firstString;
 char* secondString;
 int16_t stringValue;
 uint8_t uartFlag = 0;
+commandChannel_t commandChannelUSB;
+commandChannel_t commandChannelUART;
 
 
 // *****************************************************************************
 // Function: Analyse an incoming string and parse it for printer commands. *****
 // *****************************************************************************
 
-// TODO: find out why a command cannot be longer than 16 characters (at least via USB).
-// Maybe the USB virtual serial input buffer is set to 16 byte?
+// Call in main loop as often as possible. Takes whatever bytes have arrived and
+// runs the next complete line of each channel. Never waits for more bytes.
 void processCommandInput( void )
 {
+	// Receive from USB virtual serial.
+	receiveInput(&commandChannelUSB, 0);
+	dispatchLine(&commandChannelUSB, 0);
 
-	_delay_ms(100);
-	
-	// Receive a string from USB virtual serial.
-	// This will write the received string to the input variable "inputString".
-	receiveStringUSB(inputString, 30);
+	// Receive from UART serial.
+	receiveInput(&commandChannelUART, 1);
+	dispatchLine(&commandChannelUART, 1);
+}
 
-	// Receive a string from UART serial.
-	// This will write the received string to the input variable "inputString".
-	// Do this only in case inputString is empty.
-	if (strlen(inputString)>0)
+// Receive all waiting bytes of one channel (0: USB, 1: UART). *****************
+// Binary frames are run right away by the frame parser, everything
+// else is assembled into lines for the ASCII parser. Several lines can wait.
+void receiveInput(commandChannel_t *commandChannel, uint8_t channel)
+{
+	// Stop reading while all lines are taken. The bytes wait in the USB
+	// endpoint or UART ring buffer until a line has been run.
+	while (((commandChannel->lineHead + 1) & COMMAND_LINE_MASK) != commandChannel->lineTail)
 	{
-		uartFlag = 0;
-		parseCommand();
-		
-		//sendStringUART(inputString);
-		//uint8_t stringLength = strlen(inputString);
-		//sendByteAsStringUSB(stringLength);
-		//uartFlag = 0;
+		uint8_t inputByte;
+		if (!channel)
+		{
+			if (!bytesWaitingUSB()) break;
+			inputByte = receiveByteUSB();
+		}
+		else
+		{
+			uint16_t inputChar = uart1_getc();
+			// Errors are ignored, the ASCII parser will just not match.
+			if (inputChar & UART_NO_DATA) break;
+			inputByte = inputChar;
+		}
+		// Frame cut off, e.g. host killed mid-write or USB packet lost.
+		// Drop it, the byte may start an ASCII command.
+		if (commandChannel->idleTicks >= COMMAND_IDLE_TIMEOUT) binaryParserReset(&commandChannel->binaryParser);
+		commandChannel->idleTicks = 0;
+		if (binaryParserFeed(&commandChannel->binaryParser, inputByte, channel)) continue;
+
+		// Line complete.
+		if (inputByte == '\n' || inputByte == '\r')
+		{
+			finishLine(commandChannel, channel);
+		}
+		// Add to line.
+		else if (commandChannel->length < COMMAND_LINE_SIZE-1)	// -1 because the '\0' has to be added at the end.
+		{
+			commandChannel->lines[commandChannel->lineHead][commandChannel->length++] = inputByte;
+		}
+		// Too long. Drop the rest of the line.
+		else
+		{
+			commandChannel->overflow = 1;
+		}
 	}
-	
-	receiveStringUART(inputString, 30);
-	if (strlen(inputString)>0)
+
+	// Hosts that send without terminator: take the line as complete
+	// once no more bytes have come in for a while.
+	if (commandChannel->length && commandChannel->idleTicks >= COMMAND_IDLE_TIMEOUT)
 	{
-		uartFlag = 1;
-		parseCommand();
-		
-		//sendStringUART(inputString);
-		//uint8_t stringLength = strlen(inputString);
-		//sendByteAsStringUSB(stringLength);
-		//uartFlag = 1;
+		finishLine(commandChannel, channel);
+	}
+}
+
+// Close the line that is being assembled. *************************************
+void finishLine(commandChannel_t *commandChannel, uint8_t channel)
+{
+	// Empty line, e.g. second char of \r\n.
+	if (!commandChannel->length && !commandChannel->overflow) return;
+
+	// Line did not fit. Tell the host instead of running a truncated command.
+	if (commandChannel->overflow)
+	{
+		if (!channel)	sendStringUSB("overflow\n");
+		else	sendStringUART("overflow\n");
 	}
-	/*else
+	else
 	{
-		uartFlag = 0;
-		//sendStringUART(strlen(inputString));
+		commandChannel->lines[commandChannel->lineHead][commandChannel->length] = '\0';
+		commandChannel->lineHead = (commandChannel->lineHead + 1) & COMMAND_LINE_MASK;
 	}
-	*/
+	commandChannel->length = 0;
+	commandChannel->overflow = 0;
+}
+
+// Run the oldest complete line of a channel. **********************************
+void dispatchLine(commandChannel_t *commandChannel, uint8_t channel)
+{
+	if (commandChannel->lineTail == commandChannel->lineHead) return;
+	strcpy(inputString, commandChannel->lines[commandChannel->lineTail]);
+	commandChannel->lineTail = (commandChannel->lineTail + 1) & COMMAND_LINE_MASK;
+	uartFlag = channel;
+	watchdogNoteCommand(inputString);
+	parseCommand();
+}
+
+// Count idle time of partial lines. Call from 1 ms timer ISR. *****************
+void commandInputTick( void )
+{
+	if (commandChannelUSB.idleTicks < 255) commandChannelUSB.idleTicks++;
+	if (commandChannelUART.idleTicks < 255) commandChannelUART.idleTicks++;
 }
 
 void parseCommand(void)
@@ -84,18 +155,26 @@ void parseCommand(void)
 		
 		//pingFlag = 1;
 	}
+	else if (!(strcmp(inputString, "crash")))
+	{
+		// Crash record from before the last reset, see watchdog.h.
+		watchdogReport(uartFlag);
+	}
+	else if (!(strcmp(inputString, "crashClear")))
+	{
+		watchdogClear();
+		if (!uartFlag)	sendStringUSB("crashClear\n");
+		else	sendStringUART("crashClear\n");
+	}
 	if (!(strcmp(inputString, "tilt")))
 	{
 		tilt(tiltAngle,tiltSpeed);
-		_delay_ms(10);
 		if (!uartFlag)	sendStringUSB("tilt\n");	// Important: don't forget newline character.
 		else	sendStringUART("tilt\n");
-		sendByteAsStringUSB(uartFlag);
 	}
 	else if (!(strcmp(inputString, "buildHome")))
 	{
 		buildPlatformHome();
-		_delay_ms(10);
 		if (!uartFlag)	sendStringUSB("buildHome\n");	// Important: don't forget newline character.
 		else	sendStringUART("buildHome\n");
 	}
@@ -143,12 +222,97 @@ void parseCommand(void)
 		if (!uartFlag)	sendStringUSB("shutterDisable\n");	// Important: don't forget newline character.
 		else	sendStringUART("shutterDisable\n");
 	}
+	else if (!(strcmp(inputString, "saveConfig")))
+	{
+		// Store settings in EEPROM. Stalls the main loop for up to
+		// 250 ms, refused while the printer is busy.
+		if (printerSaveConfig())
+		{
+			if (!uartFlag)	sendStringUSB("saveConfig\n");	// Important: don't forget newline character.
+			else	sendStringUART("saveConfig\n");
+		}
+		else
+		{
+			if (!uartFlag)	sendStringUSB("busy\n");
+			else	sendStringUART("busy\n");
+		}
+	}
+	else if (!(strcmp(inputString, "loadConfig")))
+	{
+		// Reply tells the host if it has to send the settings.
+		if (printerLoadConfig())
+		{
+			if (!uartFlag)	sendStringUSB("loadConfig\n");	// Important: don't forget newline character.
+			else	sendStringUART("loadConfig\n");
+		}
+		else
+		{
+			if (!uartFlag)	sendStringUSB("noConfig\n");
+			else	sendStringUART("noConfig\n");
+		}
+	}
 	else if (!(strcmp(inputString, "triggerCam")))
 	{
 		triggerCamera();
 		if (!uartFlag)	sendStringUSB("triggerCam\n");	// Important: don't forget newline character.
 		else	sendStringUART("triggerCam\n");
 	}
+	else if (!(strcmp(inputString, "peel")))
+	{
+		peel();
+		if (!uartFlag)	sendStringUSB("peel\n");
+		else	sendStringUART("peel\n");
+	}
+	// Print job. Layers are uploaded as binary frames.
+	else if (!(strcmp(inputString, "jobStart")))
+	{
+		printJobStart();
+		if (!uartFlag)	sendStringUSB("jobStart\n");
+		else	sendStringUART("jobStart\n");
+	}
+	else if (!(strcmp(inputString, "jobStop")))
+	{
+		printJobStop();
+		if (!uartFlag)	sendStringUSB("jobStop\n");
+		else	sendStringUART("jobStop\n");
+	}
+	else if (!(strcmp(inputString, "exposeStop")))
+	{
+		exposureStop();
+		if (!uartFlag)	sendStringUSB("exposeStop\n");
+		else	sendStringUART("exposeStop\n");
+	}
+	// Queued motion segments. Run back to back without host round trip.
+	else if (!(strcmp(inputString, "qBuildUp")))
+	{
+		queueSegment(MOTION_SEGMENT_BUILD_LAYER, 0);
+	}
+	else if (!(strcmp(inputString, "qTilt")))
+	{
+		queueSegment(MOTION_SEGMENT_TILT, 0);
+	}
+	else if (!(strcmp(inputString, "qShutterOpen")))
+	{
+		queueSegment(MOTION_SEGMENT_SHUTTER_OPEN, 0);
+	}
+	else if (!(strcmp(inputString, "qShutterClose")))
+	{
+		queueSegment(MOTION_SEGMENT_SHUTTER_CLOSE, 0);
+	}
+	else if (!(strcmp(inputString, "qCam")))
+	{
+		queueSegment(MOTION_SEGMENT_CAMERA, 0);
+	}
+	else if (!(strcmp(inputString, "qPeel")))
+	{
+		queueSegment(MOTION_SEGMENT_PEEL, 0);
+	}
+	else if (!(strcmp(inputString, "qClear")))
+	{
+		motionQueueClear();
+		if (!uartFlag)	sendStringUSB("qClear\n");
+		else	sendStringUART("qClear\n");
+	}
 	else if (!(strcmp(inputString, "beamerHome")))
 	{
 //			beamerHome();
@@ -161,7 +325,7 @@ void parseCommand(void)
 	else if (strlen(inputString)>0)
 	{
 		// Retrieve first string and second string separated by space.
-		// Does not work if first + second string is longer than 16 chars.
+		// Line length is limited to COMMAND_LINE_SIZE-1 chars.
 		firstString = strtok(inputString, " ");
 		secondString = strtok(NULL, " ");	// WHY DOES THIS WORK?
 
@@ -210,6 +374,65 @@ void parseCommand(void)
 			if (!uartFlag)	sendStringUSB("tiltRes\n");
 			else	sendStringUART("tiltRes\n");
 		}
+		else if (!(strcmp(firstString, "tiltRetSpd")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Return speed in °/s, 0: same as forward.
+			tiltSetReturnSpeed(stringValue);
+			if (!uartFlag)	sendStringUSB("tiltRetSpd\n");
+			else	sendStringUART("tiltRetSpd\n");
+		}
+		else if (!(strcmp(firstString, "tiltAccel")))
+		{
+			// Acceleration in °/s².
+			uint32_t acceleration = strtoul(secondString, NULL, 10);
+			tiltSetAcceleration(acceleration);
+			if (!uartFlag)	sendStringUSB("tiltAccel\n");
+			else	sendStringUART("tiltAccel\n");
+		}
+		else if (!(strcmp(firstString, "tiltCreepSpd")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Speed into the switch in °/s.
+			tiltSetCreepSpeed(stringValue);
+			if (!uartFlag)	sendStringUSB("tiltCreepSpd\n");
+			else	sendStringUART("tiltCreepSpd\n");
+		}
+		else if (!(strcmp(firstString, "tiltApproach")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Distance before the switch at creep speed in °.
+			tiltSetApproach(stringValue);
+			if (!uartFlag)	sendStringUSB("tiltApproach\n");
+			else	sendStringUART("tiltApproach\n");
+		}
+		else if (!(strcmp(firstString, "auditTol")))
+		{
+			// Allowed drift at the limit switches in um.
+			uint16_t tolerance = strtoul(secondString, NULL, 10);
+			positionAuditSetTolerance(tolerance);
+			if (!uartFlag)	sendStringUSB("auditTol\n");
+			else	sendStringUART("auditTol\n");
+		}
+		else if (!(strcmp(firstString, "auditAction")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// 0: report, 1: stop print job, 2: stop print job and home.
+			positionAuditSetAction(stringValue);
+			if (!uartFlag)	sendStringUSB("auditAction\n");
+			else	sendStringUART("auditAction\n");
+		}
+		else if (!(strcmp(firstString, "auditReset")))
+		{
+			// Learn the top switch position on the next hit.
+			positionAuditSetTopReference(0);
+			if (!uartFlag)	sendStringUSB("auditReset\n");
+			else	sendStringUART("auditReset\n");
+		}
 		else if (!(strcmp(firstString, "buildSpeed")))
 		{
 			// Retrieve layer value.
@@ -237,6 +460,72 @@ void parseCommand(void)
 			if (!uartFlag)	sendStringUSB("buildMinMove\n");
 			else	sendStringUART("buildMinMove\n");
 		}
+		else if (!(strcmp(firstString, "buildAccel")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Adjust value according to input.
+			buildPlatformSetAcceleration(stringValue);
+			if (!uartFlag)	sendStringUSB("buildAccel\n");
+			else	sendStringUART("buildAccel\n");
+		}
+		else if (!(strcmp(firstString, "buildRamp")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Adjust value according to input.
+			buildPlatformSetRampShape(stringValue);
+			if (!uartFlag)	sendStringUSB("buildRamp\n");
+			else	sendStringUART("buildRamp\n");
+		}
+		else if (!(strcmp(firstString, "buildFeed")))
+		{
+			// Cruise speed in um/s.
+			stringValue = atoi(secondString);
+			buildPlatformSetFeedrate(stringValue);
+			if (!uartFlag)	sendStringUSB("buildFeed\n");
+			else	sendStringUART("buildFeed\n");
+		}
+		else if (!(strcmp(firstString, "buildSpdTbl")))
+		{
+			// Speed index and speed in um/s.
+			char *thirdString = strtok(NULL, " ");
+			if (thirdString) buildPlatformSetSpeedTable(atoi(secondString), atoi(thirdString));
+			if (!uartFlag)	sendStringUSB("buildSpdTbl\n");
+			else	sendStringUART("buildSpdTbl\n");
+		}
+		else if (!(strcmp(firstString, "buildStartSpd")))
+		{
+			// Start and stop speed in um/s.
+			stringValue = atoi(secondString);
+			buildPlatformSetStartSpeed(stringValue);
+			if (!uartFlag)	sendStringUSB("buildStartSpd\n");
+			else	sendStringUART("buildStartSpd\n");
+		}
+		else if (!(strcmp(firstString, "buildStepAngle")))
+		{
+			// Motor step angle in 1/100 °. Sets the resolution.
+			stringValue = atoi(secondString);
+			buildPlatformSetStepAngle(stringValue);
+			if (!uartFlag)	sendStringUSB("buildStepAngle\n");
+			else	sendStringUART("buildStepAngle\n");
+		}
+		else if (!(strcmp(firstString, "buildMicrosteps")))
+		{
+			// Driver microsteps. Sets the resolution.
+			stringValue = atoi(secondString);
+			buildPlatformSetMicrosteps(stringValue);
+			if (!uartFlag)	sendStringUSB("buildMicrosteps\n");
+			else	sendStringUART("buildMicrosteps\n");
+		}
+		else if (!(strcmp(firstString, "buildLead")))
+		{
+			// Lead screw travel in um per turn. Sets the resolution.
+			stringValue = atoi(secondString);
+			buildPlatformSetLead(stringValue);
+			if (!uartFlag)	sendStringUSB("buildLead\n");
+			else	sendStringUART("buildLead\n");
+		}
 		else if (!(strcmp(firstString, "buildMove")))
 		{
 			// Retrieve value and convert to int.
@@ -246,6 +535,147 @@ void parseCommand(void)
 			if (!uartFlag)	sendStringUSB("buildMove\n");
 			else	sendStringUART("buildMove\n");
 		}
+		else if (!(strcmp(firstString, "buildMoveUm")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Move by um, converted with the build platform resolution.
+			buildPlatformMoveMicrons(stringValue);
+			if (!uartFlag)	sendStringUSB("buildMoveUm\n");
+			else	sendStringUART("buildMoveUm\n");
+		}
+		else if (!(strcmp(firstString, "peelOffset")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Tilt steps after start of tilt return. Negative: before.
+			peelSetBuildOffset(stringValue);
+			if (!uartFlag)	sendStringUSB("peelOffset\n");
+			else	sendStringUART("peelOffset\n");
+		}
+		else if (!(strcmp(firstString, "peelTiltSpd")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// 0 means use tilt speed.
+			peelSetTiltSpeed(stringValue);
+			if (!uartFlag)	sendStringUSB("peelTiltSpd\n");
+			else	sendStringUART("peelTiltSpd\n");
+		}
+		else if (!(strcmp(firstString, "peelBuildSpd")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// 0 means use build platform speed.
+			peelSetBuildSpeed(stringValue);
+			if (!uartFlag)	sendStringUSB("peelBuildSpd\n");
+			else	sendStringUART("peelBuildSpd\n");
+		}
+		else if (!(strcmp(firstString, "expose")))
+		{
+			// Exposure time in ms, up to the uint32 us range of the timer.
+			uint32_t exposureTime = strtoul(secondString, NULL, 10);
+			if (exposureTime > UINT32_MAX / 1000) exposureTime = UINT32_MAX / 1000;
+			if (exposureStart((uint32_t)exposureTime * 1000, exposureGetFlags()))
+			{
+				if (!uartFlag)	sendStringUSB("expose\n");
+				else	sendStringUART("expose\n");
+			}
+			else
+			{
+				if (!uartFlag)	sendStringUSB("busy\n");
+				else	sendStringUART("busy\n");
+			}
+		}
+		else if (!(strcmp(firstString, "exposeFlags")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Bit 0 shutter, bit 1 camera pin, bit 2 events.
+			exposureSetFlags(stringValue);
+			if (!uartFlag)	sendStringUSB("exposeFlags\n");
+			else	sendStringUART("exposeFlags\n");
+		}
+		else if (!(strcmp(firstString, "configTag")))
+		{
+			// Tag of the host settings, saved with saveConfig.
+			printerSetConfigTag(strtoul(secondString, NULL, 10));
+			if (!uartFlag)	sendStringUSB("configTag\n");
+			else	sendStringUART("configTag\n");
+		}
+		else if (!(strcmp(firstString, "loadConfig")))
+		{
+			// Load stored settings. They only count if they were saved
+			// with the given tag, otherwise the host has to send its own.
+			uint16_t tag = strtoul(secondString, NULL, 10);
+			if (printerLoadConfig() && printerGetConfigTag() == tag)
+			{
+				if (!uartFlag)	sendStringUSB("loadConfig\n");
+				else	sendStringUART("loadConfig\n");
+			}
+			else
+			{
+				if (!uartFlag)	sendStringUSB("noConfig\n");
+				else	sendStringUART("noConfig\n");
+			}
+		}
+		else if (!(strcmp(firstString, "homeFastSpd")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Fast approach speed in um/s.
+			homingSetFastSpeed(stringValue);
+			if (!uartFlag)	sendStringUSB("homeFastSpd\n");
+			else	sendStringUART("homeFastSpd\n");
+		}
+		else if (!(strcmp(firstString, "homeSlowSpd")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Slow approach speed in um/s.
+			homingSetSlowSpeed(stringValue);
+			if (!uartFlag)	sendStringUSB("homeSlowSpd\n");
+			else	sendStringUART("homeSlowSpd\n");
+		}
+		else if (!(strcmp(firstString, "homeBackoff")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Distance to back off the switch in um.
+			homingSetBackoff(stringValue);
+			if (!uartFlag)	sendStringUSB("homeBackoff\n");
+			else	sendStringUART("homeBackoff\n");
+		}
+		else if (!(strcmp(firstString, "homeTimeout")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Timeout per homing stage in s.
+			homingSetTimeout(stringValue);
+			if (!uartFlag)	sendStringUSB("homeTimeout\n");
+			else	sendStringUART("homeTimeout\n");
+		}
+		else if (!(strcmp(firstString, "telemetry")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			// Period in ms, 0 switches telemetry off.
+			telemetrySetPeriod(stringValue);
+			if (!uartFlag)	sendStringUSB("telemetry\n");
+			else	sendStringUART("telemetry\n");
+		}
+		else if (!(strcmp(firstString, "qBuildMove")))
+		{
+			// Retrieve value and convert to int.
+			stringValue = atoi(secondString);
+			queueSegment(MOTION_SEGMENT_BUILD_MOVE, stringValue);
+		}
+		else if (!(strcmp(firstString, "qDwell")))
+		{
+			// Retrieve dwell time in ms.
+			stringValue = atoi(secondString);
+			queueSegment(MOTION_SEGMENT_DWELL, stringValue);
+		}
 		else if (!(strcmp(firstString, "printingFlag")))
 		{
 			// Retrieve layer value.
@@ -304,6 +734,51 @@ void parseCommand(void)
 			if (!uartFlag)	sendStringUSB("shttrClsPs\n");
 			else	sendStringUART("shttrClsPs\n");
 		}
+		else if (!(strcmp(firstString, "shttrOpnPw")))
+		{
+			// Retrieve pulse width in us.
+			stringValue = atoi(secondString);
+			shutterSetOpenPulse(stringValue);
+			if (!uartFlag)	sendStringUSB("shttrOpnPw\n");
+			else	sendStringUART("shttrOpnPw\n");
+		}
+		else if (!(strcmp(firstString, "shttrClsPw")))
+		{
+			// Retrieve pulse width in us.
+			stringValue = atoi(secondString);
+			shutterSetClosePulse(stringValue);
+			if (!uartFlag)	sendStringUSB("shttrClsPw\n");
+			else	sendStringUART("shttrClsPw\n");
+		}
+		else if (!(strcmp(firstString, "shttrSlew")))
+		{
+			// Retrieve slew rate in us per frame, 0 jumps.
+			stringValue = atoi(secondString);
+			shutterSetSlew(stringValue);
+			if (!uartFlag)	sendStringUSB("shttrSlew\n");
+			else	sendStringUART("shttrSlew\n");
+		}
+	}
+}
+
+
+// Push a motion segment and ack with the command name or "full".
+void queueSegment(uint8_t type, int16_t value)
+{
+	if (motionQueuePush(type, value))
+	{
+		// Input string holds the command name only, strtok has cut off the value.
+		// One send, a full output ring drops the whole ack or nothing.
+		char ackString[COMMAND_LINE_SIZE + 1];
+		strcpy(ackString, inputString);
+		strcat(ackString, "\n");
+		if (!uartFlag)	sendStringUSB(ackString);
+		else	sendStringUART(ackString);
+	}
+	else
+	{
+		if (!uartFlag)	sendStringUSB("full\n");
+		else	sendStringUART("full\n");
 	}
 }
 
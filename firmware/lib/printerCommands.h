@@ -1,10 +1,36 @@
 #ifndef PRINTERCOMMANDS_H
 #define PRINTERCOMMANDS_H
 
+#include <stdint.h>
+#include "lib/binaryCommands.h"
+
+#define COMMAND_LINE_SIZE 30			// Including '\0'. Longer lines are dropped with "overflow".
+#define COMMAND_LINE_COUNT 4			// Lines per channel, one is being assembled. Must be a power of two.
+#define COMMAND_LINE_MASK (COMMAND_LINE_COUNT - 1)
+#define COMMAND_IDLE_TIMEOUT 10		// 1 ms ticks. Unterminated lines run and partial binary frames are dropped after 10 ms without new bytes.
+
+// Input state of one serial channel.
+// Ring of lines: complete lines from tail to head, head is being assembled.
+typedef struct
+{
+	char lines[COMMAND_LINE_COUNT][COMMAND_LINE_SIZE];
+	uint8_t lineHead;
+	uint8_t lineTail;
+	uint8_t length;				// Length of line being assembled.
+	uint8_t overflow;			// Line being assembled is too long.
+	volatile uint8_t idleTicks;		// Time since last byte. Counted by ISR.
+	binaryParser_t binaryParser;
+} commandChannel_t;
+
 void processCommandInput( void );
+void commandInputTick( void );
 uint8_t getUartFlag(void);
 uint8_t uartFlag;
 void parseCommand(void);
+void receiveInput(commandChannel_t *commandChannel, uint8_t channel);
+void finishLine(commandChannel_t *commandChannel, uint8_t channel);
+void dispatchLine(commandChannel_t *commandChannel, uint8_t channel);
+void queueSegment(uint8_t type, int16_t value);
 
 
 #endif
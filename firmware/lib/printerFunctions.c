@@ -11,6 +11,14 @@
 #include "../hardware.h"
 #include "printerFunctions.h"
 #include "menu.h"
+#include "motionPlanner.h"
+#include "stepGenerator.h"
+#include "motionQueue.h"
+#include "printJob.h"
+#include "exposure.h"
+#include "config.h"
+#include "scheduler.h"
+#include "positionAudit.h"
 #include "lib/virtualSerial.h"
 
 
@@ -22,6 +30,7 @@ uint8_t printerReadyFlag = 1;
 uint8_t printerState = 0;	// 0: idle, 1: printing
 uint16_t slice = 1;
 uint16_t numberOfSlices = 1;
+uint16_t configTag = 0;		// Host settings tag, stored with the config.
 
 
 // *****************************************************************************
@@ -32,26 +41,34 @@ uint16_t numberOfSlices = 1;
 uint8_t tiltSpeed;
 #define TILT_SPEED_MIN 1
 #define TILT_SPEED_MAX 10
-uint8_t tiltSpeedEep EEMEM;
 
 uint16_t tiltAngle = 400;
 #define TILT_ANGLE_MIN 1
 #define TILT_ANGLE_MAX 4
 #define TILT_STEPS_PER_TURN 800
 #define TILT_TIMER_COMPARE_MAX 380
-uint16_t tiltAngleEep EEMEM;
-uint8_t tiltRampSlope = 6;
-uint16_t tiltRampLength;// = 20;
-uint16_t tiltRampUpEnd = 0;
-uint16_t tiltRampDownStart = 0;
+stepGenerator_t tiltStepper;
+#define TILT_SPEED_TIMER_CLOCK (F_CPU / 64)	// Unit of the tilt speed compare values.
+
+// Tilt profile. Forward (peel) and return move have their own ramp, both are
+// planned before the tilt starts. The return ramp is switched in by the step
+// generator callback at the turn, so the ISR does no math.
+// The return move ends tiltApproach before the switch, at creep speed. The
+// stepper keeps on creeping until the switch stops it.
+// Settings in degrees of the tilt stepper, converted with tiltAngleFull.
+motionProfile_t tiltForwardProfile;
+motionProfile_t tiltReturnProfile;
+uint32_t tiltReturnSteps;
+uint16_t tiltReturnSpeed = 0;			// °/s, 0: same as forward.
+uint32_t tiltAcceleration = 90000;		// °/s². Ramps up to top speed within about 150 steps.
+uint16_t tiltCreepSpeed = 148;			// °/s. Start speed and speed into the switch.
+uint8_t tiltApproach = 2;			// °.
 
 uint16_t tiltAngleMin = 0;	//TODO
 uint16_t tiltAngleMax = 400;	// Tilt steps for 180°.
 uint16_t tiltAngleFull = 800;	// Tilt steps for 360°.
 
 volatile uint16_t tiltTimerCompareValue;
-volatile uint16_t tiltCounter = 0;
-//volatile uint16_t tiltCounterMax = 0;
 volatile uint8_t tiltingFlag = 0;
 uint16_t tiltAngleSteps;
 
@@ -59,32 +76,28 @@ uint16_t tiltAngleSteps;
 // Return stepper status (idle: 0, running: 1). ********************************
 uint8_t tiltStepperRunning( void )
 {
-	return (TCCR3B & (1 << CS30)) && (TCCR3B & (1 << CS31));
+	return stepGeneratorRunning(&tiltStepper);
 }
 // Enable stepper. *************************************************************
 void enableTiltStepper( void )
 {
+	// Skip the wait if enabled already.
+	if (TILTENABLEPORT & (1 << TILTENABLEPIN)) return;
 	TILTENABLEPORT |= (1 << TILTENABLEPIN);
 	_delay_ms(50); 		// Wait a bit until stepper driver is up and running.
-	TCCR3B |= (1 << CS31 | 1 << CS30);
-	//TCCR3B |= (1 << CS30);
 }
 // Disable stepper. ************************************************************
 void disableTiltStepper ( void )
 {
 	// Stop.
 	TILTENABLEPORT &= ~(1 << TILTENABLEPIN);
-	TCCR3B &= ~(1 << CS31);
-	TCCR3B &= ~(1 << CS30);
-	//TCCR3B &= ~(1 << CS30);
+	stepGeneratorStop(&tiltStepper);
 }
 // Stop stepper without disabling. *********************************************
 void stopTiltStepper ( void )
 {
 	// Stop.
-	TCCR3B &= ~(1 << CS31);
-	TCCR3B &= ~(1 << CS30);
-	//TCCR3B &= ~(1 << CS30);
+	stepGeneratorStop(&tiltStepper);
 }
 // Set forward direction. ******************************************************
 void tiltStepperSetForward ( void )
@@ -101,132 +114,99 @@ uint8_t tiltStepperGetDirection(void)
 {
 	return !(TILTDIRPORT & (1 << TILTDIRPIN));
 }
-// Initialise turn with given angle and speed. *********************************
-void tilt(uint8_t inputAngle, uint8_t inputSpeed)
+// Tilt profile settings. *****************************************************
+void tiltSetReturnSpeed (uint16_t input)
 {
-	// Tilt angle 10--180° in steps of 10° --> 1--18.
-	// Tilt speed 0.25--2.5 Hz in steps of 0.25 Hz --> 1--10. See log file for calculations.
-	// Timer compare value = -158 * x + 1738 with x ranging from 1--10. Output will be 
-	int16_t tiltTimerCompareValueCalc = inputSpeed * -158;
-	tiltTimerCompareValueCalc += 1738;
-	tiltTimerCompareValue = tiltTimerCompareValueCalc / 10;
-// TODO ordentlich machen
-//	tiltTimerCompareValue *= 2;
-//	timer3SetCompareValue(tiltTimerCompareValue);	// Do this later, calc ramps first.
-
-	// Tilt angle 1--18 (10°--180°) --> 89--1600 steps (3200 steps per rev).
-	//tiltAngleSteps = inputAngle * 89;
-
-	// Calculate ramping points.
-	// Consider end speed and calc ramp length by slope.
-	tiltRampLength = (TILT_TIMER_COMPARE_MAX - tiltTimerCompareValue) / tiltRampSlope;
-	// If ramp will be longer than half of the number of steps...
-	if (tiltAngleSteps < tiltRampLength * 2)
-	{
-		// Calc ramp length 
-		tiltRampLength = tiltAngleSteps / 2;
-	}
-	tiltRampUpEnd = tiltRampLength;
-	tiltRampDownStart = tiltAngleSteps - tiltRampLength;
-//	sendStringUSB("Upward ramp end point");
-//	sendByteAsStringUSB(tiltRampUpEnd);
-//	sendStringUSB("Downward ramp start point");
-//	sendByteAsStringUSB(tiltRampDownStart);
-//	sendStringUSB("Timer top value");
-//	sendByteAsStringUSB(tiltTimerCompareValue);
-	
-	
+	tiltReturnSpeed = input;
+}
 
-	// Now set the timer compare value. Start with lowest speed.
-	tiltTimerCompareValue = TILT_TIMER_COMPARE_MAX;
-//	sendStringUSB("Timer start value");
-//	sendByteAsStringUSB(tiltTimerCompareValue);
-	timer3SetCompareValue(tiltTimerCompareValue);
+void tiltSetAcceleration (uint32_t input)
+{
+	if (input < 1) input = 1;
+	tiltAcceleration = input;
+}
 
-	
+void tiltSetCreepSpeed (uint16_t input)
+{
+	if (input < 1) input = 1;
+	tiltCreepSpeed = input;
+}
+
+void tiltSetApproach (uint8_t input)
+{
+	tiltApproach = input;
+}
 
+// Degrees of the tilt stepper to steps.
+static float tiltDegreesToSteps (float degrees)
+{
+	return degrees * tiltAngleFull / 360.0;
+}
+
+// Speed 1--10 to steps/s. *****************************************************
+// Tilt speed 0.25--2.5 Hz in steps of 0.25 Hz --> 1--10. See log file for calculations.
+// Timer compare value = (-158 * x + 1738) / 10 with x ranging from 1--10.
+static float tiltSpeedToRate (uint8_t speed)
+{
+	tiltTimerCompareValue = (1738 - 158 * (int16_t)speed) / 10;
+	return motionCompareValueToRate(tiltTimerCompareValue, TILT_SPEED_TIMER_CLOCK);
+}
+
+
+// Initialise turn with given angle and speed. *********************************
+void tilt(uint8_t inputAngle, uint8_t inputSpeed)
+{
+	float forwardRate = tiltSpeedToRate(inputSpeed);
+	float returnRate = tiltReturnSpeed ? tiltDegreesToSteps(tiltReturnSpeed) : forwardRate;
+	float creepRate = tiltDegreesToSteps(tiltCreepSpeed);
+	float acceleration = tiltDegreesToSteps(tiltAcceleration);
+
+	// Forward: start at creep speed and come to rest at the top.
+	motionPlannerPlan(	&tiltForwardProfile,
+				tiltAngleSteps,
+				creepRate,
+				forwardRate,
+				acceleration,
+				MOTION_PROFILE_TRAPEZOID	);
+
+	// Return: decelerate to creep speed the approach distance before the
+	// switch.
+	uint16_t approachSteps = tiltDegreesToSteps(tiltApproach) + 0.5;
+	tiltReturnSteps = (tiltAngleSteps > approachSteps) ? tiltAngleSteps - approachSteps : 1;
+	motionPlannerPlan(	&tiltReturnProfile,
+				tiltReturnSteps,
+				creepRate,
+				returnRate,
+				acceleration,
+				MOTION_PROFILE_TRAPEZOID	);
+
+	// Flip direction at the end of the forward move.
+	tiltStepper.profile = &tiltForwardProfile;
+	tiltStepper.runOut = 0;
+	tiltStepper.finishedCallback = tiltReturn;
 
-	// Reset tilt counter.
-	tiltCounter = 0;
-	
 	// Set direction.
 	tiltStepperSetForward();
 	
-	// Enable tilt stepper.
-	enableTiltStepper();	
+	// Enable tilt stepper and start.
+	enableTiltStepper();
+	stepGeneratorStart(&tiltStepper, tiltAngleSteps, 1);
 	
 	ledYellowOn();
 }
 
-// Control tilt. ***************************************************************
-void tiltControl (void)
+// Flip direction. Called from step generator at the end of the forward move. **
+void tiltReturn (void)
 {
-	// Check direction. Only reverse if forward.
-	if (tiltStepperGetDirection())
-	{
-		// Ramp.
-		// If ramping up...
-		if (tiltCounter < tiltRampUpEnd)
-		{
-	//		sendByteAsStringUSB(tiltTimerCompareValue);
-			tiltTimerCompareValue -= tiltRampSlope;
-			timer3SetCompareValue(tiltTimerCompareValue);
-		}
-		// If ramping down.
-		if (tiltCounter > tiltRampDownStart)
-		{
-
-			tiltTimerCompareValue += tiltRampSlope;
-			timer3SetCompareValue(tiltTimerCompareValue);
-		}	
-		// Increase step count and compare to target count.
-		if (++tiltCounter == tiltAngleSteps)
-		{
-			
-			ledGreenOn();
-			ledYellowOff();
-			// Run stepper backwards.
-		//	sendStringUSB("End count");
-		//	sendByteAsStringUSB(tiltCounter);
-			// Reset tilt counter and flip direction.
-			tiltCounter = 0;
-			tiltStepperSetBackward();
-
-		}
-	}
-	
-	// Check direction. Only if backward.
-	else
-	{
-		// Ramp.
-//		sendStringUSB("Cnt: ");
-//		sendByteAsStringUSB(tiltCounter);
-		// If ramping up...
-		if (tiltCounter < tiltRampUpEnd)
-		{
-	//		sendByteAsStringUSB(tiltTimerCompareValue);
-			tiltTimerCompareValue -= tiltRampSlope;
-			timer3SetCompareValue(tiltTimerCompareValue);
-		}
-		// If ramping down.
-		if (tiltCounter > tiltRampDownStart)
-		{
-//			sendStringUSB("timer: ");
-			tiltTimerCompareValue += tiltRampSlope;
-//			sendByteAsStringUSB(tiltTimerCompareValue);
-			timer3SetCompareValue(tiltTimerCompareValue);
-		}	
-		// Increase step count and compare to target count.
-		if (++tiltCounter == tiltAngleSteps)
-		{
-			
-			ledGreenOff();
-			// Run stepper backwards.
-		//	sendStringUSB("End count");
-		//	sendByteAsStringUSB(tiltCounter);
-			// Just keep on running until the end switch is hit.
-		}
-	}
+	ledGreenOn();
+	ledYellowOff();
+	tiltStepperSetBackward();
+	// Run back on the return ramp. Keep on running at creep speed after the
+	// last step until the end switch is hit.
+	tiltStepper.profile = &tiltReturnProfile;
+	tiltStepper.runOut = 1;
+	tiltStepper.finishedCallback = 0;
+	stepGeneratorStart(&tiltStepper, tiltReturnSteps, -1);
 }
 
 void tiltSetAngleMax ( uint16_t input )
@@ -275,7 +255,6 @@ void tiltAdjustSpeed (uint8_t input)
 		if (--tiltSpeed < TILT_SPEED_MIN) tiltSpeed = TILT_SPEED_MIN;
 	}
 	menuValueSet(tiltSpeed,14);
-	eeprom_update_byte (&tiltSpeedEep, tiltSpeed);
 }
 
 
@@ -330,37 +309,45 @@ void tiltSetSpeed (uint8_t input)
 // Layer stuff.
 uint8_t buildPlatformLayer = 36;		// See stuff file for calculations.
 uint8_t buildPlatformBaseLayer = 10;
-uint16_t buildPlatformResolution = 3200;
-uint8_t buildPlatformMinimumMove = 20;
-uint16_t buildPlatformTargetPositionMax = 32000;
-uint8_t buildPlatformLayerEep EEMEM;
-uint8_t buildPlatformBaseLayerEep EEMEM;
+uint16_t buildPlatformResolution = 3200;		// Steps per mm.
+uint8_t buildPlatformMinimumMove = 20;		// Steps per standard layer.
+
+// Mechanics. The resolution follows from these, see buildPlatformUpdateResolution().
+uint16_t buildPlatformStepAngle = 180;		// 1/100 °.
+uint16_t buildPlatformMicrosteps = 16;
+uint16_t buildPlatformLead = 1000;		// um per turn.
 
 // Movement stuff.
-uint8_t buildPlatformSpeedEep EEMEM;
+// Speeds in um/s, converted to step rates with the resolution. The speed
+// index 1--4 of the menu and old hosts picks an entry of the speed table.
+// The defaults are the rates of the old fixed compare values at 3200 steps/mm.
 uint8_t buildPlatformSpeed = BUILDPLATFORM_SPEED_MIN;	// Actual value in init function from eeprom.
+uint16_t buildPlatformSpeedTable[BUILDPLATFORM_SPEED_MAX] = { 310, 459, 885, 2498 };
+uint16_t buildPlatformFeedrate = 310;		// Cruise speed of moves.
 
-volatile int16_t buildTimerCompareValue = 8065;
-volatile int16_t buildTimerTargetCompareValue = 8065;
-#define BUILD_PLATFORM_TIMER_COMPARE_VALUE_MIN 1000
 volatile uint8_t buildPlatformHomingFlag;
 
-volatile uint8_t buildPlatformCount = 0;
+stepGenerator_t buildStepper;
+motionProfile_t buildPlatformProfile;
 // Position stuff.
-// Position step is 0.01 mm (20 stepper steps).
-volatile uint8_t stopFlag = 0;
+// The step generator counts the absolute position in steps, the target is
+// kept in steps as well. Both are 32 bit and written by ISRs (limit switches),
+// access them with interrupts off.
+// Position in standard layers (buildPlatformMinimumMove steps) is derived
+// for menu and telemetry only.
+volatile int32_t buildPlatformTargetSteps = 0;
+int16_t buildPlatformMicronRemainder = 0;	// Rounding rest of micron moves, in 1/1000 steps.
 volatile uint16_t buildPlatformPosition = 0;
 volatile uint16_t buildPlatformTargetPosition = 0;
-#define BUILDPLATFORM_TARGET_POSITION_MAX 40000
 
 
 void buildPlatformEnableStepper(void)
 {
+	// Skip the wait if enabled already.
+	if (BUILDENABLEPORT & (1 << BUILDENABLEPIN)) return;
 	// Enable stepper.
 	BUILDENABLEPORT |= (1 << BUILDENABLEPIN);
 	_delay_ms(50); 		// Wait a bit until stepper driver is up and running.
-	// Activate stepper timer clock source.
-	TCCR1B |= (1 << CS10);
 }
 
 void buildPlatformUpwards(void)
@@ -374,7 +361,7 @@ void buildPlatformDisableStepper(void)
 	// Disable stepper driver.
 	BUILDENABLEPORT &= ~(1 << BUILDENABLEPIN);
 	// Deactivate stepper timer clock source.
-	TCCR1B &= ~(1 << CS10);
+	stepGeneratorStop(&buildStepper);
 }
 
 void buildPlatformStopStepper(void)
@@ -382,7 +369,7 @@ void buildPlatformStopStepper(void)
 	// Disable stepper driver.
 //	BUILDENABLEPORT &= ~(1 << BUILDENABLEPIN);
 	// Deactivate stepper timer clock source.
-	TCCR1B &= ~(1 << CS10);
+	stepGeneratorStop(&buildStepper);
 }
 
 void buildPlatformDownwards(void)
@@ -404,13 +391,8 @@ void buildPlatformAdjustSpeed (uint8_t input)
 	{
 		if (--buildPlatformSpeed < BUILDPLATFORM_SPEED_MIN) buildPlatformSpeed = BUILDPLATFORM_SPEED_MIN;
 	}
+	buildPlatformFeedrate = buildPlatformSpeedToFeedrate(buildPlatformSpeed);
 	menuValueSet(buildPlatformSpeed,17);
-// DO THIS DIRECTLY IN INTERRUPT.
-//	buildTimerTargetCompareValue = buildPlatformSpeed * (-2621) + 10686;
-//	if (buildTimerTargetCompareValue < BUILD_PLATFORM_TIMER_COMPARE_VALUE_MIN)	buildTimerTargetCompareValue = BUILD_PLATFORM_TIMER_COMPARE_VALUE_MIN;
-	
-	// Write to eeprom.
-	eeprom_update_byte (&buildPlatformSpeedEep, buildPlatformSpeed);
 }
 
 
@@ -431,34 +413,154 @@ void buildPlatformSetSpeed (uint8_t input)
 	{
 		buildPlatformSpeed = input;
 	}
+	buildPlatformFeedrate = buildPlatformSpeedToFeedrate(buildPlatformSpeed);
 	menuValueSet(buildPlatformSpeed,17);
-	
-	// Write to eeprom.
-	eeprom_update_byte (&buildPlatformSpeedEep, buildPlatformSpeed);
 }
 
+// Speed table entry of speed index 1--4. **************************************
+uint16_t buildPlatformSpeedToFeedrate (uint8_t input)
+{
+	if (input > BUILDPLATFORM_SPEED_MAX) input = BUILDPLATFORM_SPEED_MAX;
+	else if (input < BUILDPLATFORM_SPEED_MIN) input = BUILDPLATFORM_SPEED_MIN;
+	return buildPlatformSpeedTable[input - BUILDPLATFORM_SPEED_MIN];
+}
+
+// Set a speed table entry in um/s. ********************************************
+void buildPlatformSetSpeedTable (uint8_t index, uint16_t input)
+{
+	if (index < BUILDPLATFORM_SPEED_MIN || index > BUILDPLATFORM_SPEED_MAX) return;
+	if (input < 1) input = 1;
+	buildPlatformSpeedTable[index - BUILDPLATFORM_SPEED_MIN] = input;
+}
+
+// Set cruise speed in um/s. ***************************************************
+void buildPlatformSetFeedrate (uint16_t input)
+{
+	if (input < 1) input = 1;
+	buildPlatformFeedrate = input;
+}
+
+// um/s to steps/s. ************************************************************
+float buildPlatformMicronsToRate (uint16_t input)
+{
+	return (float)input * buildPlatformResolution / 1000.0;
+}
+
+// Steps per mm. **************************************************************
+// The step count and the audit reference are in the old steps. If the
+// resolution really changes, the platform must be homed again.
 void buildPlatformSetResolution (uint16_t input)
 {
+	if (input < 1) input = 1;
+	if (input != buildPlatformResolution)
+	{
+		positionAuditLost();
+		positionAuditSetTopReference(0);
+	}
 	buildPlatformResolution = input;
+	buildPlatformMicronRemainder = 0;
 //	sendByteAsStringUSB(buildPlatformResolution);
 }
 
+// Steps per mm from motor and lead screw. ************************************
+//	360° / step angle * microsteps / mm per turn
+static void buildPlatformUpdateResolution (void)
+{
+	float resolution = 36000.0 / buildPlatformStepAngle * buildPlatformMicrosteps * 1000.0 / buildPlatformLead + 0.5;
+	if (resolution > 65535.0) resolution = 65535.0;
+	buildPlatformSetResolution(resolution);
+}
+
+void buildPlatformSetStepAngle (uint16_t input)
+{
+	if (input < 1) input = 1;
+	buildPlatformStepAngle = input;
+	buildPlatformUpdateResolution();
+}
+
+void buildPlatformSetMicrosteps (uint16_t input)
+{
+	if (input < 1) input = 1;
+	buildPlatformMicrosteps = input;
+	buildPlatformUpdateResolution();
+}
+
+void buildPlatformSetLead (uint16_t input)
+{
+	if (input < 1) input = 1;
+	buildPlatformLead = input;
+	buildPlatformUpdateResolution();
+}
+
+// Steps per standard layer. The position in steps stays. **********************
 void buildPlatformSetMinMove (uint16_t input)
 {
+	if (input < 1) input = 1;
 	buildPlatformMinimumMove = input;
 //	sendByteAsStringUSB(buildPlatformMinimumMove);
 }
 
-void buildPlatformSetTargetPositionMax (uint16_t input)
+
+
+// *****************************************************************************
+// Build platform target. ******************************************************
+// *****************************************************************************
+// Travel limit in steps. The top switch stops the platform before.
+int32_t buildPlatformTravelSteps (void)
 {
-	if (input > 65535)
-	{
-		buildPlatformTargetPositionMax = 65535;
-	}
-	else
-	{
-		buildPlatformTargetPositionMax = input;
-	}
+	return (int32_t)BUILDPLATFORM_TRAVEL_MAX * buildPlatformResolution;
+}
+
+int32_t buildPlatformGetTargetSteps (void)
+{
+	int32_t target;
+	uint8_t sreg = SREG;
+	cli();
+	target = buildPlatformTargetSteps;
+	SREG = sreg;
+	return target;
+}
+
+void buildPlatformSetTargetSteps (int32_t input)
+{
+	int32_t travel = buildPlatformTravelSteps();
+	if (input < 0) input = 0;
+	else if (input > travel) input = travel;
+	uint8_t sreg = SREG;
+	cli();
+	buildPlatformTargetSteps = input;
+	SREG = sreg;
+	buildPlatformTargetPosition = input / buildPlatformMinimumMove;
+}
+
+// Move relative to the current target. ****************************************
+void buildPlatformMoveSteps (int32_t input)
+{
+	// Read, add and write in one go, a limit switch ISR may lock the target.
+	uint8_t sreg = SREG;
+	cli();
+	buildPlatformSetTargetSteps(buildPlatformTargetSteps + input);
+	SREG = sreg;
+}
+
+// Move by micrometers using steps per mm. Rounding rests are carried over, ***
+// so many small moves add up to the exact distance.
+void buildPlatformMoveMicrons (int16_t input)
+{
+	int32_t product = (int32_t)input * buildPlatformResolution + buildPlatformMicronRemainder;
+	int32_t steps = product / 1000;
+	buildPlatformMicronRemainder = product - steps * 1000;
+	buildPlatformMoveSteps(steps);
+}
+
+// Position and target from the same moment. ***********************************
+void buildPlatformGetSnapshot (buildPlatformSnapshot_t *snapshot)
+{
+	uint8_t sreg = SREG;
+	cli();
+	stepGeneratorGetSnapshot(&buildStepper, &snapshot->stepper);
+	snapshot->target = buildPlatformTargetSteps;
+	SREG = sreg;
 }
 
 // Adjust build platform position. *********************************************
@@ -467,14 +569,12 @@ void buildPlatformAdjustPosition (uint8_t input)
 	// Increase if input = 1.
 	if (input==1)
 	{
-		if ((buildPlatformTargetPosition + buildPlatformLayer) > BUILDPLATFORM_TARGET_POSITION_MAX) buildPlatformTargetPosition = BUILDPLATFORM_TARGET_POSITION_MAX;
-		else buildPlatformTargetPosition += buildPlatformLayer;
+		buildPlatformMoveSteps((int32_t)buildPlatformLayer * buildPlatformMinimumMove);
 	}
 	// Decrease if input = 2.
 	else if (input==2)
-	{	// Decrease, also check if position is below zero which means somewhere at > 60000 due to wrapping.
-		if ((buildPlatformTargetPosition - buildPlatformLayer) == 0 || (buildPlatformTargetPosition - buildPlatformLayer) > 60000) buildPlatformTargetPosition = 0;
-		else buildPlatformTargetPosition -= buildPlatformLayer;
+	{
+		buildPlatformMoveSteps(-(int32_t)buildPlatformLayer * buildPlatformMinimumMove);
 	}
 	menuValueSet(buildPlatformTargetPosition,20);
 }
@@ -512,8 +612,6 @@ void buildPlatformSetLayerHeight (uint8_t input)
 	}
 	
 	menuValueSet(buildPlatformLayer,18);
-	// Write to eeprom.
-	eeprom_update_byte (&buildPlatformLayerEep, buildPlatformLayer);
 }
 
 
@@ -549,39 +647,26 @@ void buildPlatformSetBaseLayerHeight (uint8_t input)
 	}
 	
 	menuValueSet(buildPlatformBaseLayer,19);
-	// Write to eeprom.
-	eeprom_update_byte (&buildPlatformBaseLayerEep, buildPlatformBaseLayer);
 }
 
 
-// Home build platform. Input is speed from 1 (slow) to 4 (fast). **************
+// Home build platform. See homing functions below. ***************************
 void buildPlatformHome (void)
 {
-	// Check if build platform is in home position already.
-	if (LIMITBUILDBOTTOMPOLL & (1 << LIMITBUILDBOTTOMPIN))		// Active high.
+	// Start homing if not running already.
+	if (!buildPlatformHomingFlag)
 	{
 		// Set printer in action flag.
-		// Printer ready function will react as if printer was just running and return true.
+		// Printer ready function will return true once homing is done.
 		printerOperatingFlag = 1;
+		buildPlatformSetTargetSteps(0);
+		menuValueSet(buildPlatformTargetPosition,20);
+		homingStart();
 	}
-	// If not, set target position etc. or stop if homing is running from previous command.
+	// Stop motor if running already.
 	else
 	{
-		// Start motor if not running already.
-		if (!buildPlatformHomingFlag )//&& (LIMITBUILDBOTTOMPOLL & (1 << LIMITBUILDBOTTOMPIN)))	//(!(TCCR3B & (1 << CS30)) && (LIMITBUILDBOTTOMPOLL & (1 << LIMITBUILDBOTTOMPIN)))
-		{
-			buildPlatformHomingFlag = 1;
-			buildPlatformTargetPosition = 0;
-			menuValueSet(buildPlatformTargetPosition,20);
-		}
-		// Stop motor if running already.
-		else
-		{
-			stopFlag = 1;
-			buildPlatformHomingFlag = 0;
-			buildPlatformPosition = 0;
-			buildPlatformTargetPosition = 0;
-		}
+		homingStop();
 	}
 }
 
@@ -590,9 +675,9 @@ void buildPlatformHome (void)
 // Move build platform to top. *************************************************
 void buildPlatformTop (void)
 {
-	if (!(TCCR1B & (1 << CS10)))	// If not running.
+	if (!stepGeneratorRunning(&buildStepper))	// If not running.
 	{
-		buildPlatformTargetPosition = BUILDPLATFORM_TARGET_POSITION_MAX;
+		buildPlatformSetTargetSteps(buildPlatformTravelSteps());
 	//	sendStringUSB("Target:");
 	//	sendByteAsStringUSB(buildPlatformTargetPosition);
 	//	sendStringUSB("Current:");
@@ -601,34 +686,19 @@ void buildPlatformTop (void)
 	}
 	else
 	{
-		stopFlag = 1;
+		buildPlatformStopStepper();
+		buildPlatformLockPosition();
+		menuValueSet(buildPlatformTargetPosition,20);
 	}	
 }
 
 
 
-// Set target position for build platform. *************************************
-void buildPlatformSetTarget(int16_t input)
-{
-	// Will position become negative?
-	if ( (input < 0) && (abs(input) > buildPlatformTargetPosition) )
-	{
-		buildPlatformTargetPosition = 0;
-	}
-	else	// Just add...
-	{
-		buildPlatformTargetPosition += input;
-	}
-}
-
-
-
 // Move layer up. **************************************************************
 void buildPlatformLayerUp(void)
 {
-	// Increase build platform target position by layer height if smaller than max height.	
-	if ((buildPlatformTargetPosition + buildPlatformLayer) > BUILDPLATFORM_TARGET_POSITION_MAX) buildPlatformTargetPosition = BUILDPLATFORM_TARGET_POSITION_MAX;
-	else buildPlatformTargetPosition += buildPlatformLayer;
+	// Increase build platform target position by layer height, up to max height.
+	buildPlatformMoveSteps((int32_t)buildPlatformLayer * buildPlatformMinimumMove);
 }
 
 
@@ -636,267 +706,399 @@ void buildPlatformLayerUp(void)
 // Move base layer up. *********************************************************
 void buildPlatformBaseLayerUp(void)
 {
-	if ((buildPlatformTargetPosition + buildPlatformBaseLayer) > BUILDPLATFORM_TARGET_POSITION_MAX) buildPlatformTargetPosition = BUILDPLATFORM_TARGET_POSITION_MAX;
-	else buildPlatformTargetPosition += buildPlatformBaseLayer;
+	buildPlatformMoveSteps((int32_t)buildPlatformBaseLayer * buildPlatformMinimumMove);
 }
 
 
+// Move by standard layers. ****************************************************
 void buildPlatformMove (int16_t input)
 {
-	if ((buildPlatformTargetPosition + input) > BUILDPLATFORM_TARGET_POSITION_MAX) buildPlatformTargetPosition = BUILDPLATFORM_TARGET_POSITION_MAX;
-	else if ((buildPlatformTargetPosition + input) < 0) buildPlatformTargetPosition = 0;
-	else buildPlatformTargetPosition += input;
+	buildPlatformMoveSteps((int32_t)input * buildPlatformMinimumMove);
+}
+
+// Ramp stuff. *****************************************************************
+// Timer 1 runs with the prescaler of the current ramp level, see
+// motionPlanner.h. The step ISR sets the upper limit.
+#define BUILD_PLATFORM_STEP_RATE_MAX 8000				// Steps/s.
+uint16_t buildPlatformAcceleration = 5;				// mm/s².
+uint16_t buildPlatformStartSpeed = 310;				// um/s. Start and stop speed.
+uint8_t buildPlatformRampShape = MOTION_PROFILE_TRAPEZOID;
+
+
+// Set build platform acceleration in mm/s². ***********************************
+void buildPlatformSetAcceleration (uint16_t input)
+{
+	if (input < 1) input = 1;
+	buildPlatformAcceleration = input;
+}
+
+// Set start and stop speed in um/s. *******************************************
+void buildPlatformSetStartSpeed (uint16_t input)
+{
+	if (input < 1) input = 1;
+	buildPlatformStartSpeed = input;
+}
+
+// Set ramp shape. 0: trapezoid, 1: S-curve. ***********************************
+void buildPlatformSetRampShape (uint8_t input)
+{
+	if (input == MOTION_PROFILE_SCURVE) buildPlatformRampShape = MOTION_PROFILE_SCURVE;
+	else buildPlatformRampShape = MOTION_PROFILE_TRAPEZOID;
+}
+
+
+// Plan the ramp for the next move. Cruise rate in steps/s. *******************
+// The stepper must be stopped, the ISR walks through the ramp table.
+void buildPlatformPlanMoveRate (uint32_t steps, float rate)
+{
+	// Cap speed.
+	if (rate > BUILD_PLATFORM_STEP_RATE_MAX) rate = BUILD_PLATFORM_STEP_RATE_MAX;
+
+	// Fill the ramp table. Always start at lowest speed, or below if the
+	// cruise rate is lower. Each level gets its own prescaler.
+	motionPlannerPlan(	&buildPlatformProfile,
+				steps,
+				buildPlatformMicronsToRate(buildPlatformStartSpeed),
+				rate,
+				(float)buildPlatformAcceleration * buildPlatformResolution,
+				buildPlatformRampShape	);
+}
+
+// Plan the ramp for the next move. Cruise speed in um/s. *********************
+void buildPlatformPlanMove (uint32_t steps, uint16_t feedrate)
+{
+	buildPlatformPlanMoveRate(steps, buildPlatformMicronsToRate(feedrate));
+}
+
+
+// Update position in standard layers from the step position. ******************
+void buildPlatformUpdatePosition (void)
+{
+	int32_t steps = stepGeneratorGetPosition(&buildStepper);
+	// Below home while homing.
+	if (steps < 0) steps = 0;
+	buildPlatformPosition = steps / buildPlatformMinimumMove;
+}
+
+
+// Stop where we are. Interrupt safe. ******************************************
+void buildPlatformLockPosition (void)
+{
+	buildPlatformUpdatePosition();
+	buildPlatformSetTargetSteps(stepGeneratorGetPosition(&buildStepper));
+}
+
+
+// Called from step generator at the end of a move. ****************************
+void buildPlatformMoveFinished (void)
+{
+	ledGreenOff();
+	ledYellowOff();
 }
 
-uint16_t buildRampSlope = 400;
-uint16_t buildRampLength;
-uint16_t buildNumberOfSteps;
-volatile uint16_t buildRampUpEnd;
-volatile uint16_t buildRampDownStart;
-volatile uint16_t buildRampCounter;
 
 // Compare build platform current and target position. *************************
-void buildPlatformComparePosition (uint8_t buildPlatformSpeed)
+void buildPlatformComparePosition (uint16_t feedrate)
 {
-	// Calc timer compare value. *******************************************
-	if (!(TCCR1B & (1 << CS10)))
-	{
-		buildTimerTargetCompareValue = buildPlatformSpeed * (-2621) + 10686;
-		// Cap speed.
-		if (buildTimerTargetCompareValue < BUILD_PLATFORM_TIMER_COMPARE_VALUE_MIN)	buildTimerTargetCompareValue = BUILD_PLATFORM_TIMER_COMPARE_VALUE_MIN;
-		// Don't use target speed right from the start. Always start at lowest speed.
-		buildTimerCompareValue = 8065;	// Reset only if not running.
-		// Set timer compare value. Range between 202 and 8065, corresponding to 20 mm/s and 0.5 mm/s.
-		timer1SetCompareValue(buildTimerCompareValue);
-	}	
+	buildPlatformUpdatePosition();
+	// Homing runs the stepper on its own.
+	if (stepGeneratorRunning(&buildStepper) || buildPlatformHomingFlag) return;
+
+	// Go from step position to target.
+	int32_t position = stepGeneratorGetPosition(&buildStepper);
+	int32_t target = buildPlatformGetTargetSteps();
 
 	// Move upwards.
-	if (buildPlatformPosition < buildPlatformTargetPosition && !(TCCR1B & (1 << CS10)))
+	if (position < target)
 	{
 		if (!(LIMITBUILDTOPPOLL & (1 << LIMITBUILDTOPPIN)))	// Check end switch (active high).
 		{
-			// Get number of steps to move.
-			buildNumberOfSteps = buildPlatformTargetPosition - buildPlatformPosition;
-	//		sendStringUSB("N steps: ");
-	//		sendByteAsStringUSB(buildNumberOfSteps);
-			// Calculate ramping points.
-			// Consider end speed and calculate ramp length by slope.
-			buildRampLength = (buildTimerCompareValue - buildTimerTargetCompareValue) / buildRampSlope;
-			// If ramp will be longer than half of the number of steps...
-			if (buildNumberOfSteps < buildRampLength * 2)
-			{
-				// Calc ramp length 
-				buildRampLength = buildNumberOfSteps / 2;
-			}
-			
-			buildRampUpEnd = buildRampLength;
-	//		sendStringUSB("Up end: ");
-	//		sendByteAsStringUSB(buildRampUpEnd);
-			buildRampDownStart = buildNumberOfSteps - buildRampLength;
-	//		sendStringUSB("Down start length: ");
-	//		sendByteAsStringUSB(buildRampDownStart);
-			
-			// Reset counter for ramping.
-			buildRampCounter = 0;
-	
+			// Plan ramp for number of steps to move.
+			buildPlatformPlanMove(target - position, feedrate);
+
 			ledYellowOn();
 			// Set upward direction.
 			buildPlatformUpwards();
 			
-			// Enable stepper.
+			// Enable stepper and go.
 			buildPlatformEnableStepper();
-
+			stepGeneratorStart(&buildStepper, target - position, 1);
 		}
 //		else printerOperatingFlag = 1;
 	}
 	// Move downwards. *****************************************************
-	else if (buildPlatformPosition > buildPlatformTargetPosition && !(TCCR1B & (1 << CS10)))
+	else if (position > target)
 	{
 		if (!(LIMITBUILDBOTTOMPOLL & (1 << LIMITBUILDBOTTOMPIN)))
 		{
-			// Get number of steps to move.
-			buildNumberOfSteps = buildPlatformPosition - buildPlatformTargetPosition;
-			// Calculate ramping points.
-			// Consider end speed and calculate ramp length by slope.
-			buildRampLength = (buildTimerCompareValue - buildTimerTargetCompareValue) / buildRampSlope;
-			// If ramp will be longer than half of the number of steps...
-			if (buildNumberOfSteps < buildRampLength * 2)
-			{
-				// Calc ramp length 
-				buildRampLength = buildNumberOfSteps / 2;
-			}
-			buildRampUpEnd = buildRampLength;
-			buildRampDownStart = buildNumberOfSteps - buildRampLength;
-			
-			// Reset counter for ramping.
-			buildRampCounter = 0;
+			// Plan ramp for number of steps to move.
+			buildPlatformPlanMove(position - target, feedrate);
 			
 			ledGreenOn();
 			// Set downward direction.
 			buildPlatformDownwards();
 			
-			// Enable stepper.
+			// Enable stepper and go.
 			buildPlatformEnableStepper();
+			stepGeneratorStart(&buildStepper, position - target, -1);
 		}
 //		else printerOperatingFlag = 1;
 	}
-	// Move to home position.
-	// Only if homing flag set and motor not running.
-	else if (buildPlatformHomingFlag && !(TCCR1B & (1 << CS10)))
+}
+
+
+// *****************************************************************************
+// Peel variables and functions. ***********************************************
+// *****************************************************************************
+// One tilt cycle and one layer up in a single command. The layer move starts
+// while the tilt is still returning instead of waiting for the host.
+#define PEEL_IDLE 0
+#define PEEL_TILT 1		// Tilting, layer move not started yet.
+#define PEEL_LIFT 2		// Layer move started, waiting for both steppers.
+uint8_t peelState = PEEL_IDLE;
+int16_t peelBuildOffset = 0;	// Tilt steps after start of tilt return at which the layer move starts. Negative: during forward tilt.
+uint8_t peelTiltSpeed = 0;	// 0: use tilt speed.
+uint8_t peelBuildSpeed = 0;	// 0: use build platform speed.
+int32_t peelTiltStart;
+uint8_t peelMicronsFlag = 0;	// Move by peelMove instead of one layer.
+int16_t peelMove;		// um.
+
+
+void peelSetBuildOffset (int16_t input)
+{
+	peelBuildOffset = input;
+}
+
+void peelSetTiltSpeed (uint8_t input)
+{
+	if (input > TILT_SPEED_MAX) input = TILT_SPEED_MAX;
+	peelTiltSpeed = input;
+}
+
+void peelSetBuildSpeed (uint8_t input)
+{
+	if (input > BUILDPLATFORM_SPEED_MAX) input = BUILDPLATFORM_SPEED_MAX;
+	peelBuildSpeed = input;
+}
+
+uint8_t peelIdle (void)
+{
+	return peelState == PEEL_IDLE;
+}
+
+
+// Start peel. *****************************************************************
+void peel (void)
+{
+	if (peelState != PEEL_IDLE) return;
+	// Enable build platform driver now, so the layer move can start
+	// right away later on.
+	buildPlatformEnableStepper();
+	peelTiltStart = stepGeneratorGetPosition(&tiltStepper);
+	tilt(tiltAngle, peelTiltSpeed ? peelTiltSpeed : tiltSpeed);
+	peelMicronsFlag = 0;
+	peelState = PEEL_TILT;
+}
+
+// Start peel with a move in um, used by the print job. ************************
+void peelMicrons (int16_t input)
+{
+	if (peelState != PEEL_IDLE) return;
+	peel();
+	peelMove = input;
+	peelMicronsFlag = 1;
+}
+
+
+// Run peel. Call in main loop. ************************************************
+void peelService (void)
+{
+	if (peelState == PEEL_TILT)
 	{
-		// Home limit switch not active (low).
-		if (!(LIMITBUILDBOTTOMPOLL & (1 << LIMITBUILDBOTTOMPIN)))
+		// Tilt steps done so far, forward and return.
+		int32_t tiltSteps = stepGeneratorGetPosition(&tiltStepper) - peelTiltStart;
+		if (tiltStepper.direction < 0) tiltSteps = 2 * (int32_t)tiltAngleSteps - tiltSteps;
+
+		// Start layer move at the offset or when the tilt is done.
+		if (tiltSteps >= (int32_t)tiltAngleSteps + peelBuildOffset || !tiltStepperRunning())
 		{
-			// Ramping.
-			// Consider end speed and calculate ramp length by slope.
-			buildRampLength = (buildTimerCompareValue - buildTimerTargetCompareValue) / buildRampSlope;
-			buildRampUpEnd = buildRampLength;
-	//		sendStringUSB("Up end: ");
-	//		sendByteAsStringUSB(buildRampUpEnd);
-			buildRampDownStart = 65535;
-	//		sendStringUSB("Down start length: ");
-	//		sendByteAsStringUSB(buildRampDownStart);
-			// Set a dummy value for build ramp down start point.
-			buildRampCounter = 0;
-			ledGreenOn();
-			// Set downward direction.
-			buildPlatformDownwards();
-			
-			// Enable stepper.
-			buildPlatformEnableStepper();
-		}
-		// Switch pressed.
-		else
-		{
-			buildPlatformPosition = 0;
+			if (peelMicronsFlag) buildPlatformMoveMicrons(peelMove);
+			else buildPlatformLayerUp();
+			buildPlatformComparePosition(peelBuildSpeed ? buildPlatformSpeedToFeedrate(peelBuildSpeed) : buildPlatformFeedrate);
+			peelState = PEEL_LIFT;
 		}
 	}
+	else if (peelState == PEEL_LIFT)
+	{
+		if (!tiltStepperRunning() && !stepGeneratorRunning(&buildStepper)) peelState = PEEL_IDLE;
+	}
 }
 
 
 
-// Control build platform movement. ********************************************TODO: ramping
-void buildPlatformControl(void)
+// *****************************************************************************
+// Homing. *********************************************************************
+// *****************************************************************************
+// Fast approach down to the bottom switch, back off, then approach again at
+// low speed. The bottom switch ISR stops the stepper and zeroes the position,
+// home is where the slow approach closes the switch. Overshoot of the fast
+// approach does not matter. Each stage is aborted after the timeout.
+#define HOMING_IDLE 0
+#define HOMING_FAST 1		// Down until the switch closes.
+#define HOMING_BACKOFF 2	// Up off the switch.
+#define HOMING_SLOW 3		// Down until the switch closes again.
+uint8_t homingState = HOMING_IDLE;
+uint8_t homingFailedFlag = 0;
+uint16_t homingFastSpeed = 2500;	// um/s.
+uint16_t homingSlowSpeed = 250;		// um/s.
+uint16_t homingBackoff = 500;		// um.
+uint16_t homingTimeout = 150;		// s per stage.
+uint32_t homingStageTime;		// ms in the current stage.
+uint16_t homingLastTime;
+
+
+void homingSetFastSpeed (uint16_t input)
 {
-	
-/*	if (buildTimerCompareValue > buildTimerTargetCompareValue)
+	if (input < 1) input = 1;
+	homingFastSpeed = input;
+}
+
+void homingSetSlowSpeed (uint16_t input)
+{
+	if (input < 1) input = 1;
+	homingSlowSpeed = input;
+}
+
+void homingSetBackoff (uint16_t input)
+{
+	homingBackoff = input;
+}
+
+void homingSetTimeout (uint16_t input)
+{
+	if (input < 1) input = 1;
+	homingTimeout = input;
+}
+
+uint8_t homingIdle (void)
+{
+	return homingState == HOMING_IDLE;
+}
+
+// Last homing ran into a timeout or the switch did not open. ******************
+uint8_t homingFailed (void)
+{
+	return homingFailedFlag;
+}
+
+
+// Start a stage. **************************************************************
+static void homingStage (uint8_t stage)
+{
+	uint8_t bottom = LIMITBUILDBOTTOMPOLL & (1 << LIMITBUILDBOTTOMPIN);	// Active high.
+	homingState = stage;
+	homingStageTime = 0;
+	homingLastTime = schedulerTime();
+
+	if (stage == HOMING_BACKOFF)
 	{
-		buildTimerCompareValue -= 20;
-		// Testing
-		timer1SetCompareValue(buildTimerCompareValue);
+		uint32_t steps = (uint32_t)homingBackoff * buildPlatformResolution / 1000;
+		if (steps < 1) steps = 1;
+		buildPlatformPlanMoveRate(steps, buildPlatformMicronsToRate(homingFastSpeed));
+		ledYellowOn();
+		buildPlatformUpwards();
+		buildPlatformEnableStepper();
+		stepGeneratorStart(&buildStepper, steps, 1);
 	}
-*/
-	// Adjust position every nth step. ********************
-	// Upward direction.
-	if (!(BUILDDIRPORT & (1 << BUILDDIRPIN)))
+	// Approach. Skip if the switch is closed already.
+	else if (!bottom)
 	{
-		// Increment step counter every step.
-		// Test if steps per standard layer are reached.
-		if (++buildPlatformCount == buildPlatformMinimumMove)	// should be configured to be 0.01 mm
-		{
-			buildRampCounter += 1;
-		//	sendByteAsStringUSB(buildRampCounter);
-			// Ramp up.
-			if (buildRampCounter < buildRampUpEnd)
-			{
-				buildTimerCompareValue -= buildRampSlope;
-				timer1SetCompareValue(buildTimerCompareValue);
-			}
-			// If ramping down.
-			if (buildRampCounter > buildRampDownStart)
-			{
-				buildTimerCompareValue += buildRampSlope;
-				timer1SetCompareValue(buildTimerCompareValue);
-			}	
-			// Reset step counter
-			buildPlatformCount = 0;
-			// Deactivate stepper if target reached.
-			buildPlatformPosition++;
-			if (buildPlatformPosition == buildPlatformTargetPosition)
-			{
-				// Disable stepper.
-				ledGreenOff();
-				ledYellowOff();
-				buildPlatformStopStepper();
-		//		menuChanged();
-			}
-			else if (buildPlatformPosition > buildPlatformTargetPosition)
-			{
-				// Reverse. 
-				ledGreenOn();
-				buildPlatformDownwards();//BUILDDIRPORT |= (1 << BUILDDIRPIN);
-				menuChanged();
-			}
-		}
+		uint16_t speed = (stage == HOMING_FAST) ? homingFastSpeed : homingSlowSpeed;
+		// Ramp up only, run until the limit switch is hit.
+		buildPlatformPlanMoveRate(MOTION_STEPS_ENDLESS, buildPlatformMicronsToRate(speed));
+		ledGreenOn();
+		buildPlatformDownwards();
+		buildPlatformEnableStepper();
+		stepGeneratorStart(&buildStepper, MOTION_STEPS_ENDLESS, -1);
 	}
-	// Downward direction.
-	else
+}
+
+
+// Start homing. ***************************************************************
+void homingStart (void)
+{
+	homingFailedFlag = 0;
+	buildPlatformHomingFlag = 1;
+	// The stage replans the ramp the ISR walks through.
+	stepGeneratorStop(&buildStepper);
+	homingStage(HOMING_FAST);
+}
+
+
+// Abort homing and stay where we are. *****************************************
+void homingStop (void)
+{
+	buildPlatformStopStepper();
+	homingState = HOMING_IDLE;
+	buildPlatformHomingFlag = 0;
+	positionAuditLost();
+	// Below the old zero that zero means nothing, restart counting here.
+	if (stepGeneratorGetPosition(&buildStepper) < 0) stepGeneratorSetPosition(&buildStepper, 0);
+	buildPlatformLockPosition();
+	ledGreenOff();
+	ledYellowOff();
+}
+
+
+// Run homing. Call in main loop. **********************************************
+void homingService (void)
+{
+	if (homingState == HOMING_IDLE) return;
+
+	// Stage timeout.
+	uint16_t time = schedulerTime();
+	homingStageTime += (uint16_t)(time - homingLastTime);
+	homingLastTime = time;
+	if (homingStageTime > (uint32_t)homingTimeout * 1000)
 	{
-		// Increment step counter every step.
-		if (++buildPlatformCount == buildPlatformMinimumMove)
-		{
-			// Ramping.
-			buildRampCounter += 1;
-			// Ramp up.
-			if (buildRampCounter < buildRampUpEnd)
-			{
-				buildTimerCompareValue -= buildRampSlope;
-				timer1SetCompareValue(buildTimerCompareValue);
-			}
-			// If ramping down.
-			if ((buildRampCounter > buildRampDownStart)  && !(buildPlatformHomingFlag))
-			{
-		//		sendStringUSB("foo")
-				buildTimerCompareValue += buildRampSlope;
-				timer1SetCompareValue(buildTimerCompareValue);
-			}	
-			// Dont check if homing. Go until limit switch is hit.
-			if (buildPlatformHomingFlag)
-			{
-				buildPlatformCount = 0;
-				--buildPlatformPosition;
-//				menuChanged();
-			}
-			else
-			{
-				// Reset step counter
-				buildPlatformCount = 0;
-				// Deactivate stepper if target reached.
-				buildPlatformPosition--;
-				if (buildPlatformPosition == buildPlatformTargetPosition)
-				{
-					ledGreenOff();
-					ledYellowOff();
-					buildPlatformStopStepper();
-				//	menuChanged();
-				}
-				else if (buildPlatformPosition < buildPlatformTargetPosition)
-				{
-					ledYellowOn();
-					buildPlatformUpwards();
-				//	menuChanged();
-				}
-			}
-		}
+		homingStop();
+		homingFailedFlag = 1;
+		return;
 	}
-	
-	// Stop on stop flag.
-	if (stopFlag)
+
+	// Wait for the stage to end. Approach moves are stopped by the switch.
+	if (stepGeneratorRunning(&buildStepper)) return;
+	uint8_t bottom = LIMITBUILDBOTTOMPOLL & (1 << LIMITBUILDBOTTOMPIN);
+
+	switch (homingState)
 	{
-		// Dectivate stepper timer clock source.
-		ledYellowOff();
-		ledGreenOff();
-		buildPlatformStopStepper();
-		//TCCR1B &= ~(1 << CS10);
-		// Reset stop flag.
-		stopFlag = 0;
-		// Set target position to current position.
-		buildPlatformTargetPosition = buildPlatformPosition;
-		menuValueSet(buildPlatformTargetPosition,20);
-	//	menuChanged();
+		case HOMING_FAST:
+			homingStage(HOMING_BACKOFF);
+			break;
+
+		case HOMING_BACKOFF:
+			// Backoff too short to open the switch.
+			if (bottom)
+			{
+				homingStop();
+				homingFailedFlag = 1;
+			}
+			else homingStage(HOMING_SLOW);
+			break;
+
+		case HOMING_SLOW:
+			// Home.
+			stepGeneratorSetPosition(&buildStepper, 0);
+			buildPlatformPosition = 0;
+			buildPlatformSetTargetSteps(0);
+			homingState = HOMING_IDLE;
+			buildPlatformHomingFlag = 0;
+			positionAuditHomed();
+			break;
 	}
 }
 
+
 /*
 
 // *****************************************************************************
@@ -1224,68 +1426,237 @@ void beamerControl(void)
 // *****************************************************************************
 // Servo control function. *****************************************************
 // *****************************************************************************
-uint8_t servoIdleCount = 0;
-uint8_t shutterOpenPos = 4;
-uint8_t shutterClosePos = 6;
+uint16_t shutterOpenPulse = 1400;		// us.
+uint16_t shutterClosePulse = 1600;		// us.
+uint16_t shutterSlew = 0;			// us per frame, 0: jump.
+uint8_t servoSlewCounts = 0;			// Timer counts per frame.
+volatile uint16_t servoCompare = 0;		// Pulse width in timer counts.
+volatile uint16_t servoTarget = 0;
 
 void servoControl (void)
 {
-	// Run this function on every servo timer overflow.
-	// On the 10th overflow, set the pin high.
-	if(servoIdleCount++ == 10)
+	// Run this function on every servo timer overflow while slewing.
+	// Move the pulse width one step closer to the target each frame.
+	if (servoCompare + servoSlewCounts < servoTarget)
+	{
+		servoCompare += servoSlewCounts;
+	}
+	else if (servoCompare > servoTarget + servoSlewCounts)
+	{
+		servoCompare -= servoSlewCounts;
+	}
+	else
+	{
+		// Arrived. No more interrupts until the next move.
+		servoCompare = servoTarget;
+		TIMSK4 &= ~(1 << TOIE4);
+	}
+	// Double buffered, takes effect with the next frame.
+	timer4SetCompareValue(servoCompare);
+}
+
+// Set servo pulse width in us.
+void servoSetPulse(uint16_t input)
+{
+	if (input < SERVO_PULSE_MIN) input = SERVO_PULSE_MIN;
+	else if (input > SERVO_PULSE_MAX) input = SERVO_PULSE_MAX;
+
+	uint8_t sreg = SREG;
+	cli();
+	// Pulse lasts compare value + 1 counts.
+	servoTarget = (input + SERVO_US_PER_COUNT / 2) / SERVO_US_PER_COUNT - 1;
+	// Jump if slew is off, the servo is not running or has no position yet.
+	if (!servoSlewCounts || !(TCCR4B & (1 << CS43 | 1 << CS40)) || !servoCompare)
 	{
-		SERVOPORT |= (1 << SERVOPIN);
-		servoIdleCount = 0;
+		servoCompare = servoTarget;
+		timer4SetCompareValue(servoCompare);
+		TIMSK4 &= ~(1 << TOIE4);
 	}
+	// Slew in the overflow ISR.
+	else if (servoCompare != servoTarget)
+	{
+		TIMSK4 |= (1 << TOIE4);
+	}
+	SREG = sreg;
 }
 
-// Set servo position between 0 and 10.
+// Set servo position between 1 and 10.
 void servoSetPosition(uint8_t input)
 {
 	if (input <= 10 && input > 0)
 	{
-		// Full timer run from 0 to 255 takes 0.00204 seconds.
-		// We need an interval from 0.001 to 0.002 seconds.
-		// One step takes 0.000008 seconds.
-		// 0.002 / 0.000008 = 250.
-		// 0.001 / 0.000008 = 125.
-		// Convert 0--10 to 125--250:
-		// 	Timer value = 12.5 * input + 125.
-		uint16_t tempVal = 125 * input + 1250;
-	//	tempVal /= 10;
-		uint8_t timerVal = tempVal / 10;
-		timer4SetCompareValue(timerVal);
+		// 1 ms to 2 ms in steps of 0.1 ms.
+		servoSetPulse(1000 + 100 * input);
 	}
 }
 
 void shutterSetOpenPos (uint8_t input)
 {
-	shutterOpenPos = input;
+	if (input <= 10 && input > 0) shutterOpenPulse = 1000 + 100 * input;
 }
 
 void shutterSetClosePos (uint8_t input)
 {
-	shutterClosePos = input;
+	if (input <= 10 && input > 0) shutterClosePulse = 1000 + 100 * input;
+}
+
+void shutterSetOpenPulse (uint16_t input)
+{
+	shutterOpenPulse = input;
+}
+
+void shutterSetClosePulse (uint16_t input)
+{
+	shutterClosePulse = input;
+}
+
+void shutterSetSlew (uint16_t input)
+{
+	shutterSlew = input;
+	// Round up, any slew moves at least one count per frame.
+	servoSlewCounts = (input + SERVO_US_PER_COUNT - 1) / SERVO_US_PER_COUNT;
 }
 
 void shutterOpen (void)
 {
-	servoSetPosition(shutterOpenPos);
+	servoSetPulse(shutterOpenPulse);
 }
 
 void shutterClose (void)
 {
-	servoSetPosition(shutterClosePos);
+	servoSetPulse(shutterClosePulse);
 }
 
 void shutterEnable(void)
 {
-	TCCR4B |= (1 << CS43);
+	// Connect OC4D: set at the start of the frame, cleared on compare match.
+	TCCR4C |= (1 << COM4D1);
+	TCCR4B |= (1 << CS43 | 1 << CS40);	// Prescaler 256. Datasheet p 166.
 }
 
 void shutterDisable(void)
 {
 	TCCR4B &= ~(1 << CS43 | 1 << CS42 | 1 << CS41 | 1 << CS40);
+	TIMSK4 &= ~(1 << TOIE4);
+	// Disconnect OC4D, the timer may have stopped in the middle of a pulse.
+	TCCR4C &= ~(1 << COM4D1 | 1 << COM4D0);
+	SERVOPORT &= ~(1 << SERVOPIN);
+	// Finish a pending slew right away.
+	servoCompare = servoTarget;
+	timer4SetCompareValue(servoCompare);
+}
+
+
+// *****************************************************************************
+// Configuration functions. ****************************************************
+// *****************************************************************************
+// Copy settings between the variables and a config block, see config.h.
+void printerGetConfig (config_t *config)
+{
+	// Clear padding, blocks are compared byte by byte.
+	memset(config, 0, sizeof(config_t));
+	config->tiltSpeed = tiltSpeed;
+	config->tiltAngleSteps = tiltAngleSteps;
+	config->tiltAngleFull = tiltAngleFull;
+	config->buildPlatformSpeed = buildPlatformSpeed;
+	config->buildPlatformLayer = buildPlatformLayer;
+	config->buildPlatformBaseLayer = buildPlatformBaseLayer;
+	config->buildPlatformResolution = buildPlatformResolution;
+	config->buildPlatformMinimumMove = buildPlatformMinimumMove;
+	config->buildPlatformAcceleration = buildPlatformAcceleration;
+	config->buildPlatformRampShape = buildPlatformRampShape;
+	config->peelBuildOffset = peelBuildOffset;
+	config->peelTiltSpeed = peelTiltSpeed;
+	config->peelBuildSpeed = peelBuildSpeed;
+	config->shutterOpenPulse = shutterOpenPulse;
+	config->shutterClosePulse = shutterClosePulse;
+	config->shutterSlew = shutterSlew;
+	config->homingFastSpeed = homingFastSpeed;
+	config->homingSlowSpeed = homingSlowSpeed;
+	config->homingBackoff = homingBackoff;
+	config->homingTimeout = homingTimeout;
+	config->tiltReturnSpeed = tiltReturnSpeed;
+	config->tiltAcceleration = tiltAcceleration;
+	config->tiltCreepSpeed = tiltCreepSpeed;
+	config->tiltApproach = tiltApproach;
+	config->auditTolerance = positionAuditGetTolerance();
+	config->auditAction = positionAuditGetAction();
+	config->auditTopReference = positionAuditGetTopReference();
+	memcpy(config->buildPlatformSpeedTable, buildPlatformSpeedTable, sizeof(buildPlatformSpeedTable));
+	config->buildPlatformFeedrate = buildPlatformFeedrate;
+	config->buildPlatformStartSpeed = buildPlatformStartSpeed;
+	config->buildPlatformStepAngle = buildPlatformStepAngle;
+	config->buildPlatformMicrosteps = buildPlatformMicrosteps;
+	config->buildPlatformLead = buildPlatformLead;
+	config->hostTag = configTag;
+}
+
+void printerSetConfig (config_t *config)
+{
+	// Use the set functions, they check the ranges.
+	tiltSetSpeed(config->tiltSpeed);
+	tiltSetAngleMax(config->tiltAngleFull);
+	tiltSetAngle(config->tiltAngleSteps);
+	for (uint8_t i=BUILDPLATFORM_SPEED_MIN; i<=BUILDPLATFORM_SPEED_MAX; i++) buildPlatformSetSpeedTable(i, config->buildPlatformSpeedTable[i - BUILDPLATFORM_SPEED_MIN]);
+	buildPlatformSetSpeed(config->buildPlatformSpeed);
+	buildPlatformSetFeedrate(config->buildPlatformFeedrate);
+	buildPlatformSetStartSpeed(config->buildPlatformStartSpeed);
+	// Mechanics as saved, the resolution is a field of its own.
+	buildPlatformStepAngle = config->buildPlatformStepAngle;
+	buildPlatformMicrosteps = config->buildPlatformMicrosteps;
+	buildPlatformLead = config->buildPlatformLead;
+	buildPlatformSetLayerHeight(config->buildPlatformLayer);
+	buildPlatformSetBaseLayerHeight(config->buildPlatformBaseLayer);
+	buildPlatformSetResolution(config->buildPlatformResolution);
+	buildPlatformSetMinMove(config->buildPlatformMinimumMove);
+	buildPlatformSetAcceleration(config->buildPlatformAcceleration);
+	buildPlatformSetRampShape(config->buildPlatformRampShape);
+	peelSetBuildOffset(config->peelBuildOffset);
+	peelSetTiltSpeed(config->peelTiltSpeed);
+	peelSetBuildSpeed(config->peelBuildSpeed);
+	shutterSetOpenPulse(config->shutterOpenPulse);
+	shutterSetClosePulse(config->shutterClosePulse);
+	shutterSetSlew(config->shutterSlew);
+	homingSetFastSpeed(config->homingFastSpeed);
+	homingSetSlowSpeed(config->homingSlowSpeed);
+	homingSetBackoff(config->homingBackoff);
+	homingSetTimeout(config->homingTimeout);
+	tiltSetReturnSpeed(config->tiltReturnSpeed);
+	tiltSetAcceleration(config->tiltAcceleration);
+	tiltSetCreepSpeed(config->tiltCreepSpeed);
+	tiltSetApproach(config->tiltApproach);
+	positionAuditSetTolerance(config->auditTolerance);
+	positionAuditSetAction(config->auditAction);
+	positionAuditSetTopReference(config->auditTopReference);
+	printerSetConfigTag(config->hostTag);
+}
+
+uint8_t printerLoadConfig (void)
+{
+	config_t config;
+	if (!configLoad(&config)) return 0;
+	printerSetConfig(&config);
+	return 1;
+}
+
+uint8_t printerSaveConfig (void)
+{
+	config_t config;
+	// Writing the EEPROM stalls the main loop.
+	if (printerBusy()) return 0;
+	printerGetConfig(&config);
+	configSave(&config);
+	return 1;
+}
+
+void printerSetConfigTag (uint16_t input)
+{
+	configTag = input;
+}
+
+uint16_t printerGetConfigTag (void)
+{
+	return configTag;
 }
 
 
@@ -1300,24 +1671,25 @@ void printerInit (void)
 	
 	
 	
+	// Initialise step generators. The prescalers come with the ramp levels.
+	stepGeneratorInit(&buildStepper, &buildPlatformProfile, &TCCR1B, &OCR1A, &TCNT1);
+	buildStepper.finishedCallback = buildPlatformMoveFinished;
+	stepGeneratorInit(&tiltStepper, &tiltForwardProfile, &TCCR3B, &OCR3A, &TCNT3);
+
 	// Initialise values.
 	tiltSpeed = 6;
 	tiltAngle = 3;
 	buildPlatformHomingFlag = 0;
 	buildPlatformPosition = 0;
-	buildPlatformTargetPosition = buildPlatformPosition;
+	buildPlatformSetTargetSteps(0);
 //	beamerPosition = 0;
 //	beamerTargetPosition = beamerPosition;
 
 // TODO: Eeprom values get corrupted upon programming. Maybe read eeprom before programming and write file back into eeprom after programming.
 	
-	// Get values from eeprom.
-//	tiltSpeed = eeprom_read_byte (&tiltSpeedEep);
-//	tiltAngle = eeprom_read_byte (&tiltAngleEep);
-	buildPlatformSpeed = eeprom_read_byte (&buildPlatformSpeedEep);
+	// Get values from eeprom. Defaults stay if there is no valid block.
+	printerLoadConfig();
 //	beamerSpeed = eeprom_read_byte (&beamerSpeedEep);
-//	buildPlatformLayer = eeprom_read_byte (&buildPlatformLayerEep);
-//	buildPlatformBaseLayer = eeprom_read_byte (&buildPlatformBaseLayerEep);
 //	beamerHiRes = eeprom_read_byte(&beamerHiResEep);
 //	beamerHiResPosition = eeprom_read_word (&beamerHiResPositionEep);
 //	beamerLoResPosition = eeprom_read_word (&beamerLoResPositionEep);
@@ -1402,8 +1774,8 @@ void printerInit (void)
 uint8_t printerReady(void)
 {
 	// Just finished condition:
-	// Tilt off, beamer platform off, build platform off?
-	if( !(TCCR1B & (1 << CS10)) && !(TCCR3B & (1 << CS30)) )
+	// Tilt off, beamer platform off, build platform off, motion queue empty, no peel running?
+	if (!printerBusy())
 	{
 		// Just finished: printerOperatingFlag is still 1.
 		if (printerOperatingFlag)
@@ -1427,13 +1799,28 @@ uint8_t printerReady(void)
 	return printerReadyFlag;
 }
 
+uint8_t printerBusy(void)
+{
+	return stepGeneratorRunning(&buildStepper) || stepGeneratorRunning(&tiltStepper) || !motionQueueIdle() || !peelIdle() || !homingIdle() || !printJobIdle() || exposureRunning();
+}
+
+
+// Camera pulse. Set the pin, the 1 ms tick clears it. **********************
+volatile uint8_t cameraPulseCount = 0;		// ms left.
 
-// Function to toggle camera pin.
 void triggerCamera ( void )
 {
+	uint8_t sreg = SREG;
+	cli();
 	CAMPORT |= (1 << CAMPIN);
-	_delay_ms(50);
-	CAMPORT &= ~(1 << CAMPIN);
+	cameraPulseCount = CAMERA_PULSE_LENGTH;
+	SREG = sreg;
+}
+
+// Call from 1 ms timer ISR.
+void cameraTick ( void )
+{
+	if (cameraPulseCount && --cameraPulseCount == 0) CAMPORT &= ~(1 << CAMPIN);
 }
 
 
@@ -10,11 +10,16 @@
 #include <stdio.h>
 #include <util/delay.h>
 #include "../hardware.h"
+#include "stepGenerator.h"
 
 // *****************************************************************************
 // Init function. **************************************************************
 // *****************************************************************************
 void printerInit(void);
+uint8_t printerLoadConfig(void);					// Apply stored settings. Returns 0 if there are none.
+uint8_t printerSaveConfig(void);					// Store current settings. Returns 0 while busy, nothing written.
+void printerSetConfigTag(uint16_t input);				// Saved with the settings, see loadConfig command.
+uint16_t printerGetConfigTag(void);
 
 
 // *****************************************************************************
@@ -28,9 +33,8 @@ void printerInit(void);
 uint8_t tiltSpeed;
 uint16_t tiltAngle;
 volatile uint16_t tiltTimerCompareValue;
-volatile uint16_t tiltCounter;
-volatile uint16_t tiltCounterMax;
 volatile uint8_t tiltingFlag;
+stepGenerator_t tiltStepper;
 uint16_t tiltAngleSteps;
 //int16_t tiltTimerCompareValue;
 
@@ -44,10 +48,14 @@ void tiltStepperSetForward ( void );
 void tiltStepperSetBackward ( void );
 uint8_t tiltStepperGetDirection(void);
 void tilt(uint8_t tiltAngle, uint8_t tiltSpeed);
-void tiltControl(void);
+void tiltReturn(void);
 void tiltDisableStepper(void);
 void stopTiltStepper(void);
 void tiltSetSpeed(uint8_t input);
+void tiltSetReturnSpeed(uint16_t input);				// °/s, 0: same as forward.
+void tiltSetAcceleration(uint32_t input);				// °/s².
+void tiltSetCreepSpeed(uint16_t input);					// °/s, start speed and speed into the switch.
+void tiltSetApproach(uint8_t input);					// °, distance before the switch at creep speed.
 
 
 
@@ -60,22 +68,42 @@ void tiltSetSpeed(uint8_t input);
 #define BUILDPLATFORM_MAX_STANDARD_LAYERS 50				// Maximum number of standard layers per actual layer. 50 --> 0.5 mm.
 #define BUILDPLATFORM_SPEED_MAX 4
 #define BUILDPLATFORM_SPEED_MIN 1
-uint8_t buildPlatformSpeed;						// Stepper speed from 1--4.
-volatile uint8_t buildPlatformCount;					// Step counter.
+#define BUILDPLATFORM_TRAVEL_MAX 250						// mm. Target limit, beyond the top switch.
+uint8_t buildPlatformSpeed;						// Speed index from 1--4, picks a speed table entry.
+uint16_t buildPlatformFeedrate;						// Cruise speed in um/s.
 uint8_t buildPlatformLayer;					// Layer height in multiples of standard layer.
 uint8_t buildPlatformBaseLayer;
-volatile uint16_t buildPlatformPosition;				// Current position in standard layers.
-volatile uint16_t buildPlatformTargetPosition;			// Target position in standard layers.
+uint16_t buildPlatformResolution;					// Steps per mm.
+uint8_t buildPlatformMinimumMove;					// Steps per standard layer.
+volatile int32_t buildPlatformTargetSteps;				// Target position in steps.
+volatile uint16_t buildPlatformPosition;				// Current position in standard layers. For display.
+volatile uint16_t buildPlatformTargetPosition;			// Target position in standard layers. For display.
 volatile uint8_t buildPlatformHomingFlag;
-volatile uint8_t stopFlag;
-volatile int16_t buildTimerCompareValue;
+stepGenerator_t buildStepper;						// Build platform step generator, position in steps.
+
+// Position and target from the same moment.
+typedef struct
+{
+	stepGeneratorSnapshot_t stepper;
+	int32_t target;							// Steps.
+} buildPlatformSnapshot_t;
 
 
 // Build platform functions. ***************************************************
 void buildPlatformAdjustSpeed (uint8_t input);
 void buildPlatformSetSpeed (uint8_t input);
-void buildPlatformSetResolution (uint16_t input);
-void buildPlatformSetMinMove (uint16_t input);
+void buildPlatformSetResolution (uint16_t input);			// Steps per mm.
+void buildPlatformSetStepAngle (uint16_t input);			// 1/100 °, sets the resolution.
+void buildPlatformSetMicrosteps (uint16_t input);			// Sets the resolution.
+void buildPlatformSetLead (uint16_t input);				// um per turn, sets the resolution.
+void buildPlatformSetFeedrate (uint16_t input);				// Cruise speed in um/s.
+void buildPlatformSetSpeedTable (uint8_t index, uint16_t input);	// um/s for speed index 1--4.
+uint16_t buildPlatformSpeedToFeedrate (uint8_t input);			// um/s of speed index 1--4.
+void buildPlatformSetStartSpeed (uint16_t input);			// Start and stop speed in um/s.
+float buildPlatformMicronsToRate (uint16_t input);			// um/s to steps/s.
+void buildPlatformSetMinMove (uint16_t input);				// Steps per standard layer.
+void buildPlatformSetAcceleration (uint16_t input);			// Acceleration in mm/s².
+void buildPlatformSetRampShape (uint8_t input);			// 0: trapezoid, 1: S-curve.
 //void buildPlatformSetLayerHeight (uint8_t numberOfBaseLayers);		// Set the number of base layers per layer.
 //uint8_t buildPlatformGetLayerHeight (void);				// Get the number of base layers per layer.
 void buildPlatformAdjustLayerHeight (uint8_t input);			// Increase or decrease the number of standard layers per layer.
@@ -84,11 +112,19 @@ void buildPlatformAdjustBaseLayerHeight (uint8_t input);		// Increase or decreas
 void buildPlatformSetBaseLayerHeight (uint8_t input);
 void buildPlatformHome (void);						// Move build platform to lowest position using end switch.
 void buildPlatformTop (void);						// Move build platform to top position using end switch.
-void buildPlatformMove (int16_t);					// Move by specific number of steps.
-//void buildPlatformSetTarget(int16_t input);				// Set build platform target position.
-void buildPlatformComparePosition(uint8_t buildPlatformSpeed);		// Compare current and target position, start stepper if mismatch.
-
-void buildPlatformControl(void);
+void buildPlatformMove (int16_t);					// Move by number of standard layers.
+void buildPlatformMoveSteps (int32_t input);				// Move by number of steps.
+void buildPlatformMoveMicrons (int16_t input);				// Move by um, using steps per mm.
+void buildPlatformSetTargetSteps (int32_t input);			// Clamped to 0 -- BUILDPLATFORM_TRAVEL_MAX.
+int32_t buildPlatformGetTargetSteps (void);				// Interrupt safe read.
+void buildPlatformGetSnapshot (buildPlatformSnapshot_t *snapshot);	// Interrupt safe read.
+void buildPlatformPlanMove(uint32_t steps, uint16_t feedrate);		// Plan acceleration ramp, pick the prescaler, load first compare value. um/s.
+void buildPlatformPlanMoveRate(uint32_t steps, float rate);		// Same with cruise rate in steps/s.
+void buildPlatformComparePosition(uint16_t feedrate);			// Compare current and target position, start stepper if mismatch. um/s.
+
+void buildPlatformUpdatePosition(void);					// Update position in standard layers from step position.
+void buildPlatformLockPosition(void);					// Set target to current position.
+void buildPlatformMoveFinished(void);
 void buildPlatformDisableStepper(void);						// Disable stepper.
 void buildPlatformStopStepper(void);
 
@@ -97,6 +133,34 @@ void buildPlatformBaseLayerUp(void);
 
 
 
+// *****************************************************************************
+// Peel functions. *************************************************************
+// *****************************************************************************
+void peel(void);							// Tilt and move layer up, overlapped.
+void peelMicrons(int16_t input);					// Same, but move by input um instead of a layer.
+void peelService(void);							// Call in main loop.
+uint8_t peelIdle(void);
+void peelSetBuildOffset(int16_t input);					// Tilt steps after start of tilt return. Negative: before.
+void peelSetTiltSpeed(uint8_t input);					// 0: use tilt speed.
+void peelSetBuildSpeed(uint8_t input);					// 0: use build platform speed.
+
+
+
+// *****************************************************************************
+// Homing functions. ***********************************************************
+// *****************************************************************************
+void homingStart(void);							// Fast approach, backoff, slow approach.
+void homingStop(void);
+void homingService(void);						// Call in main loop.
+uint8_t homingIdle(void);
+uint8_t homingFailed(void);						// Last homing timed out.
+void homingSetFastSpeed(uint16_t input);				// um/s.
+void homingSetSlowSpeed(uint16_t input);				// um/s.
+void homingSetBackoff(uint16_t input);					// um.
+void homingSetTimeout(uint16_t input);					// s per stage.
+
+
+
 // *****************************************************************************
 // Beamer functions. ***********************************************************
 // *****************************************************************************
@@ -132,21 +196,40 @@ void beamerDisableStepper(void);
 void beamerControl(void);
 
 // *****************************************************************************
-// Other functions. ************************************************************
+// Shutter servo functions. ****************************************************
 // *****************************************************************************
-void disableSteppers(void);
-uint8_t printerReady(void);
+// Timer 4 generates the servo signal in hardware (fast PWM on OC4D). The
+// overflow interrupt only runs while the servo slews to a new position.
 
-void servoControl(void);
-void servoSetPosition(uint8_t);
+// Variables. ******************************************************************
+#define SERVO_PULSE_MIN 500				// us.
+#define SERVO_PULSE_MAX 2500				// us.
+
+void servoControl(void);					// Call from timer 4 overflow ISR.
+void servoSetPosition(uint8_t);					// 1--10 for 1.1--2 ms.
+void servoSetPulse(uint16_t input);				// us.
 void shutterEnable(void);
 void shutterDisable(void);
-void shutterSetOpenPos (uint8_t input);
+void shutterSetOpenPos (uint8_t input);				// 1--10, see servoSetPosition().
 void shutterSetClosePos (uint8_t input);
+void shutterSetOpenPulse (uint16_t input);			// us.
+void shutterSetClosePulse (uint16_t input);			// us.
+void shutterSetSlew (uint16_t input);				// us per frame, 0: jump.
 void shutterOpen (void);
 void shutterClose (void);
 
-void triggerCamera (void);
+
+
+// *****************************************************************************
+// Other functions. ************************************************************
+// *****************************************************************************
+void disableSteppers(void);
+uint8_t printerReady(void);
+uint8_t printerBusy(void);						// 1 while anything moves, a job or an exposure runs.
+
+#define CAMERA_PULSE_LENGTH 50						// ms.
+void triggerCamera (void);						// Start a camera pulse, does not wait.
+void cameraTick (void);							// Call from 1 ms timer ISR. Ends the pulse.
 
 uint16_t numberOfSlices;
 void printerSetNumberOfSlices(uint16_t);
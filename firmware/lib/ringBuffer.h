@@ -0,0 +1,113 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Byte ring buffer. ***********************************************************
+// *****************************************************************************
+// Lock free single producer, single consumer ring shared by all I/O paths.
+// One side may run in an ISR, the other in the main loop. Only the producer
+// writes the head and only the consumer writes the tail. Both are single
+// bytes, so reads and writes are atomic on the AVR and no interrupts have to
+// be disabled. The data byte is stored before the head is moved on, the
+// consumer reads it before the tail is moved on.
+// Sizes must be a power of two, max 256. One byte stays free to tell a full
+// ring from an empty one.
+// The functions are inline so ISRs don't pay for a call.
+
+// Buffer sizes. Tune here. ****************************************************
+#define UART_RX_BUFFER_SIZE 32				// Command input.
+#define UART_TX_BUFFER_SIZE 64				// Replies and events.
+#define USB_TX_BUFFER_SIZE 128				// Telemetry frames and replies.
+
+#if (UART_RX_BUFFER_SIZE & (UART_RX_BUFFER_SIZE - 1)) || (UART_RX_BUFFER_SIZE > 256)
+#error UART_RX_BUFFER_SIZE must be a power of two, max 256
+#endif
+#if (UART_TX_BUFFER_SIZE & (UART_TX_BUFFER_SIZE - 1)) || (UART_TX_BUFFER_SIZE > 256)
+#error UART_TX_BUFFER_SIZE must be a power of two, max 256
+#endif
+#if (USB_TX_BUFFER_SIZE & (USB_TX_BUFFER_SIZE - 1)) || (USB_TX_BUFFER_SIZE > 256)
+#error USB_TX_BUFFER_SIZE must be a power of two, max 256
+#endif
+
+// Variables. ******************************************************************
+typedef struct
+{
+	volatile uint8_t *data;
+	uint8_t mask;					// Size - 1.
+	volatile uint8_t head;				// Next free byte, written by the producer.
+	volatile uint8_t tail;				// Next byte to read, written by the consumer.
+} ringBuffer_t;
+
+// Define a ring and its storage, e.g. RING_BUFFER(static, uartTxRing, UART_TX_BUFFER_SIZE);
+// The storage class applies to both, leave it empty for global rings.
+#define RING_BUFFER(storage, name, size) \
+	storage volatile uint8_t name##Data[size]; \
+	storage ringBuffer_t name = {name##Data, (size) - 1, 0, 0}
+
+
+// Both sides. *****************************************************************
+static inline uint8_t ringBufferUsed(ringBuffer_t *ring)
+{
+	return (ring->head - ring->tail) & ring->mask;
+}
+
+static inline uint8_t ringBufferFree(ringBuffer_t *ring)
+{
+	return ring->mask - ringBufferUsed(ring);
+}
+
+static inline uint8_t ringBufferEmpty(ringBuffer_t *ring)
+{
+	return ring->head == ring->tail;
+}
+
+
+// Producer. *******************************************************************
+// Returns 0 if the ring is full.
+static inline uint8_t ringBufferPut(ringBuffer_t *ring, uint8_t byte)
+{
+	uint8_t head = ring->head;
+	uint8_t nextHead = (head + 1) & ring->mask;
+	if (nextHead == ring->tail) return 0;
+	ring->data[head] = byte;
+	ring->head = nextHead;
+	return 1;
+}
+
+// Whole frame or nothing, so the consumer never sees a partial frame.
+// Returns 0 if it does not fit.
+static inline uint8_t ringBufferWrite(ringBuffer_t *ring, const uint8_t *data, uint8_t length)
+{
+	if (length > ringBufferFree(ring)) return 0;
+	uint8_t head = ring->head;
+	for (uint8_t i=0; i<length; i++)
+	{
+		ring->data[head] = data[i];
+		head = (head + 1) & ring->mask;
+	}
+	ring->head = head;
+	return 1;
+}
+
+
+// Consumer. *******************************************************************
+// Returns 0 if the ring is empty.
+static inline uint8_t ringBufferGet(ringBuffer_t *ring, uint8_t *byte)
+{
+	uint8_t tail = ring->tail;
+	if (tail == ring->head) return 0;
+	*byte = ring->data[tail];
+	ring->tail = (tail + 1) & ring->mask;
+	return 1;
+}
+
+// Drop everything that is queued.
+static inline void ringBufferFlush(ringBuffer_t *ring)
+{
+	ring->tail = ring->head;
+}
+
+#endif // RINGBUFFER_H
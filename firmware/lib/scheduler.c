@@ -0,0 +1,79 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+#ifdef SIMULATION
+#include "../sim/sim.h"
+#endif
+
+
+// *****************************************************************************
+// Scheduler variables. ********************************************************
+// *****************************************************************************
+schedulerTask_t schedulerTasks[SCHEDULER_TASK_COUNT];
+
+// Counted in the timer 0 ISR.
+volatile uint16_t schedulerTicks = 0;		// ms.
+
+
+// Register a task. ************************************************************
+void schedulerAdd(uint8_t task, void (*function)(void), uint16_t period)
+{
+	schedulerTasks[task].function = function;
+	schedulerSetPeriod(task, period);
+}
+
+// Change period. The next run is one period from now. *************************
+void schedulerSetPeriod(uint8_t task, uint16_t period)
+{
+	schedulerTasks[task].period = period;
+	schedulerTasks[task].last = schedulerTime();
+}
+
+// Read tick count. ************************************************************
+uint16_t schedulerTime(void)
+{
+	// 16 bit read, don't let the ISR change it halfway.
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t ticks = schedulerTicks;
+	SREG = sreg;
+	return ticks;
+}
+
+
+
+// *****************************************************************************
+// Run due tasks. Call in main loop. *******************************************
+// *****************************************************************************
+void schedulerRun(void)
+{
+#ifdef SIMULATION
+	// The host build has no clock of its own, every pass costs simLoopCycles.
+	simLoopPass();
+#endif
+
+	uint16_t now = schedulerTime();
+	for (uint8_t i=0; i<SCHEDULER_TASK_COUNT; i++)
+	{
+		schedulerTask_t *task = &schedulerTasks[i];
+		if (!task->function || !task->period) continue;
+		if ((uint16_t)(now - task->last) < task->period) continue;
+
+		// Keep the rate, but don't catch up on runs missed while blocked.
+		task->last += task->period;
+		if ((uint16_t)(now - task->last) >= task->period) task->last = now;
+		task->function();
+	}
+}
+
+
+
+// *****************************************************************************
+// Tick. Call from 1 ms timer ISR. *********************************************
+// *****************************************************************************
+void schedulerTick(void)
+{
+	schedulerTicks++;
+}
@@ -0,0 +1,45 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Task scheduler. *************************************************************
+// *****************************************************************************
+// Cooperative housekeeping tasks, run from the main loop. Timer 0 counts a
+// 1 ms tick, schedulerRun() calls every task whose period has elapsed.
+// Tasks must not block, motion and command input run on every pass outside
+// the scheduler.
+
+// Variables. ******************************************************************
+// Task slots.
+#define SCHEDULER_TASK_USB 0			// USB servicing.
+#define SCHEDULER_TASK_DONE 1			// "done" reporting.
+#define SCHEDULER_TASK_TELEMETRY 2		// Telemetry frames, period set by host.
+#define SCHEDULER_TASK_STEPPER_IDLE 3		// Disable idle steppers.
+#define SCHEDULER_TASK_MENU 4			// Menu redraw.
+#define SCHEDULER_TASK_COUNT 5
+
+// Default periods in ms.
+#define SCHEDULER_PERIOD_USB 1
+#define SCHEDULER_PERIOD_DONE 1
+#define SCHEDULER_PERIOD_STEPPER_IDLE 100
+#define SCHEDULER_PERIOD_MENU 100
+
+typedef struct
+{
+	void (*function)(void);
+	uint16_t period;			// ms, 0: off.
+	uint16_t last;				// Tick of last run.
+} schedulerTask_t;
+
+
+// Functions. ******************************************************************
+void schedulerAdd(uint8_t task, void (*function)(void), uint16_t period);
+void schedulerSetPeriod(uint8_t task, uint16_t period);	// ms, 0: off.
+uint16_t schedulerTime(void);			// Tick count in ms, wraps.
+void schedulerRun(void);			// Call in main loop.
+void schedulerTick(void);			// Call from 1 ms timer ISR.
+
+#endif // SCHEDULER_H
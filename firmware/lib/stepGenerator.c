@@ -0,0 +1,121 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include "stepGenerator.h"
+
+
+// *****************************************************************************
+// Setup. **********************************************************************
+// *****************************************************************************
+void stepGeneratorInit(stepGenerator_t *axis, motionProfile_t *profile, volatile uint8_t *timerControl, volatile uint16_t *timerCompare, volatile uint16_t *timerCounter)
+{
+	axis->profile = profile;
+	axis->timerControl = timerControl;
+	axis->timerCompare = timerCompare;
+	axis->timerCounter = timerCounter;
+	axis->clockSelect = 0;
+	axis->position = 0;
+	axis->direction = 1;
+	axis->stepsRemaining = 0;
+	axis->runOut = 0;
+	axis->finished = 1;
+	axis->finishedCallback = 0;
+	axis->profile->rampLength = 0;
+}
+
+
+
+// *****************************************************************************
+// Load a planned move. ********************************************************
+// *****************************************************************************
+// Safe to call from the finished callback inside the ISR. From main context the
+// timer must be stopped.
+void stepGeneratorLoad(stepGenerator_t *axis, uint32_t steps, int8_t direction)
+{
+	axis->direction = direction;
+	axis->stepsRemaining = steps;
+	axis->rampSteps = 0;
+	axis->level = 0;
+	axis->compareAccumulator = 0;
+	axis->finished = 0;
+	if (axis->profile->rampLength)
+	{
+		axis->phase = STEP_GENERATOR_PHASE_ACCELERATE;
+		axis->levelStepsRemaining = axis->profile->ramp[0].steps;
+		stepGeneratorSetLevel(axis, &axis->profile->ramp[0]);
+	}
+	else
+	{
+		axis->phase = STEP_GENERATOR_PHASE_CRUISE;
+		stepGeneratorSetLevel(axis, &axis->profile->cruise);
+	}
+	// 16 bit register access uses the shared TEMP register.
+	uint8_t sreg = SREG;
+	cli();
+	*axis->timerCompare = axis->compareValue;
+	SREG = sreg;
+}
+
+void stepGeneratorStart(stepGenerator_t *axis, uint32_t steps, int8_t direction)
+{
+	if (steps == 0)
+	{
+		axis->finished = 1;
+		return;
+	}
+	stepGeneratorLoad(axis, steps, direction);
+	// The counter stopped anywhere. Past a lower compare value it would run
+	// through the full range first. Prescaler of the first ramp level.
+	uint8_t sreg = SREG;
+	cli();
+	*axis->timerCounter = 0;
+	SREG = sreg;
+	*axis->timerControl = (*axis->timerControl & ~STEP_GENERATOR_CLOCK_MASK) | axis->clockSelect;
+}
+
+void stepGeneratorStop(stepGenerator_t *axis)
+{
+	*axis->timerControl &= ~STEP_GENERATOR_CLOCK_MASK;
+	axis->finished = 1;
+}
+
+uint8_t stepGeneratorRunning(stepGenerator_t *axis)
+{
+	return (*axis->timerControl & STEP_GENERATOR_CLOCK_MASK) != 0;
+}
+
+
+
+// *****************************************************************************
+// Position. *******************************************************************
+// *****************************************************************************
+// The position is 32 bit and written by the ISR, read it with interrupts off.
+int32_t stepGeneratorGetPosition(stepGenerator_t *axis)
+{
+	int32_t position;
+	uint8_t sreg = SREG;
+	cli();
+	position = axis->position;
+	SREG = sreg;
+	return position;
+}
+
+void stepGeneratorSetPosition(stepGenerator_t *axis, int32_t input)
+{
+	uint8_t sreg = SREG;
+	cli();
+	axis->position = input;
+	SREG = sreg;
+}
+
+// Position, remaining steps and direction from the same step.
+void stepGeneratorGetSnapshot(stepGenerator_t *axis, stepGeneratorSnapshot_t *snapshot)
+{
+	uint8_t sreg = SREG;
+	cli();
+	snapshot->position = axis->position;
+	snapshot->stepsRemaining = axis->stepsRemaining;
+	snapshot->direction = axis->direction;
+	snapshot->running = (*axis->timerControl & STEP_GENERATOR_CLOCK_MASK) != 0;
+	SREG = sreg;
+}
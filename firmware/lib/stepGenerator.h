@@ -0,0 +1,190 @@
+#ifndef STEPGENERATOR_H
+#define STEPGENERATOR_H
+
+#include <avr/io.h>
+#include <stdint.h>
+#include "motionPlanner.h"
+
+// *****************************************************************************
+// Step generator. *************************************************************
+// *****************************************************************************
+// Lean step core shared by the build platform and tilt stepper timers.
+// The timers run in CTC mode and toggle the stepper clock pin in hardware.
+// The ISR calls stepGeneratorTick() on the rising edge only. The tick has no
+// loops and no function calls (except the end of move callback). It
+//	- counts the absolute position and the remaining steps,
+//	- walks through the ramp table planned by motionPlannerPlan(),
+//	- adds up the fractional part of the compare value in a fixed point
+//	  accumulator and writes the resulting compare value directly,
+//	- switches the timer prescaler when a new ramp level needs another one.
+//	  This happens right after the compare match, with the counter near 0.
+//	  The counter is cleared with the switch, so no period is counted in
+//	  mixed units or runs through the full 16 bit range. The prescaler
+//	  itself is not reset, timer 0 shares it.
+// Everything else (LEDs, menu, position bookkeeping) is done in the main loop.
+
+// Variables. ******************************************************************
+#define STEP_GENERATOR_PHASE_ACCELERATE 0
+#define STEP_GENERATOR_PHASE_CRUISE 1
+#define STEP_GENERATOR_PHASE_DECELERATE 2
+#define STEP_GENERATOR_PHASE_DONE 3
+
+#define STEP_GENERATOR_CLOCK_MASK 0x07		// CSn2:0, the same for timer 1 and 3.
+
+typedef struct
+{
+	motionProfile_t *profile;			// Ramp table, filled by motionPlannerPlan(). May be switched while stopped.
+	// Timer registers.
+	volatile uint8_t *timerControl;			// TCCRnB.
+	volatile uint16_t *timerCompare;		// OCRnA.
+	volatile uint16_t *timerCounter;		// TCNTn.
+	volatile uint8_t clockSelect;			// Clock select bits of the current ramp level.
+	// ISR state.
+	volatile int32_t position;			// Absolute position in steps.
+	volatile int8_t direction;			// 1 or -1.
+	volatile uint32_t stepsRemaining;		// Steps until the end of the move.
+	volatile uint32_t rampSteps;			// Steps spent accelerating so far.
+	volatile uint16_t levelStepsRemaining;		// Steps left on the current level.
+	volatile uint8_t level;				// Current ramp level.
+	volatile uint8_t phase;
+	volatile uint16_t compareValue;			// Current compare value, integer part.
+	volatile uint8_t compareFraction;		// Current compare value, fraction in 1/256.
+	volatile uint8_t compareAccumulator;		// Fixed point accumulator for the fraction.
+	volatile uint8_t runOut;			// Keep going at start speed after the last step.
+	volatile uint8_t finished;			// Set by ISR at the end of a move.
+	void (*finishedCallback)(void);			// Called from ISR at the end of a move.
+} stepGenerator_t;
+
+// Consistent copy of the ISR state, see stepGeneratorGetSnapshot().
+typedef struct
+{
+	int32_t position;				// Steps.
+	uint32_t stepsRemaining;
+	int8_t direction;
+	uint8_t running;
+} stepGeneratorSnapshot_t;
+
+
+// Functions. ******************************************************************
+void stepGeneratorInit(stepGenerator_t *axis, motionProfile_t *profile, volatile uint8_t *timerControl, volatile uint16_t *timerCompare, volatile uint16_t *timerCounter);
+void stepGeneratorLoad(stepGenerator_t *axis, uint32_t steps, int8_t direction);	// Reset ISR state for the planned profile. Timer not started.
+void stepGeneratorStart(stepGenerator_t *axis, uint32_t steps, int8_t direction);	// Load and start the timer.
+void stepGeneratorStop(stepGenerator_t *axis);
+uint8_t stepGeneratorRunning(stepGenerator_t *axis);
+int32_t stepGeneratorGetPosition(stepGenerator_t *axis);				// Interrupt safe read.
+void stepGeneratorSetPosition(stepGenerator_t *axis, int32_t input);			// Interrupt safe write.
+void stepGeneratorGetSnapshot(stepGenerator_t *axis, stepGeneratorSnapshot_t *snapshot);	// Interrupt safe read.
+
+
+// Load a ramp level into the compare value. ***********************************
+static inline void stepGeneratorSetLevel(stepGenerator_t *axis, motionRampEntry_t *entry)
+{
+	axis->compareValue = entry->compareValue;
+	axis->compareFraction = entry->compareFraction;
+	axis->clockSelect = entry->clockSelect;
+}
+
+
+// *****************************************************************************
+// Step. Call from the stepper timer ISR on every step. ************************
+// *****************************************************************************
+static inline void stepGeneratorTick(stepGenerator_t *axis)
+{
+	axis->position += axis->direction;
+
+	// End of move. ***********************************************
+	if (axis->stepsRemaining != MOTION_STEPS_ENDLESS && --axis->stepsRemaining == 0)
+	{
+		if (axis->runOut)
+		{
+			// Keep running until a limit switch stops us.
+			axis->stepsRemaining = MOTION_STEPS_ENDLESS;
+		}
+		else
+		{
+			*axis->timerControl &= ~STEP_GENERATOR_CLOCK_MASK;
+			axis->finished = 1;
+			// The callback may load and start the next move.
+			if (axis->finishedCallback) axis->finishedCallback();
+			return;
+		}
+	}
+
+	// Ramp. Only index the ramp table. ***************************
+	switch (axis->phase)
+	{
+		case STEP_GENERATOR_PHASE_ACCELERATE:
+			axis->rampSteps++;
+			// Start ramping down once the remaining distance equals the ramp up.
+			// Mirror the current level: run as many steps on it as were spent
+			// on it while ramping up.
+			if (axis->stepsRemaining <= axis->rampSteps)
+			{
+				axis->levelStepsRemaining = axis->profile->ramp[axis->level].steps - axis->levelStepsRemaining + 1;
+				axis->phase = STEP_GENERATOR_PHASE_DECELERATE;
+			}
+			else if (--axis->levelStepsRemaining == 0)
+			{
+				// Next level or top speed reached.
+				if (++axis->level == axis->profile->rampLength)
+				{
+					axis->phase = STEP_GENERATOR_PHASE_CRUISE;
+					stepGeneratorSetLevel(axis, &axis->profile->cruise);
+				}
+				else
+				{
+					axis->levelStepsRemaining = axis->profile->ramp[axis->level].steps;
+					stepGeneratorSetLevel(axis, &axis->profile->ramp[axis->level]);
+				}
+			}
+			break;
+
+		case STEP_GENERATOR_PHASE_CRUISE:
+			// Start ramping down from the top level.
+			if (axis->profile->rampLength && axis->stepsRemaining <= axis->rampSteps)
+			{
+				axis->level = axis->profile->rampLength - 1;
+				axis->levelStepsRemaining = axis->profile->ramp[axis->level].steps;
+				axis->phase = STEP_GENERATOR_PHASE_DECELERATE;
+				stepGeneratorSetLevel(axis, &axis->profile->ramp[axis->level]);
+			}
+			break;
+
+		case STEP_GENERATOR_PHASE_DECELERATE:
+			if (--axis->levelStepsRemaining == 0)
+			{
+				// Lowest level done, stay at start speed.
+				if (axis->level == 0)
+				{
+					axis->phase = STEP_GENERATOR_PHASE_DONE;
+				}
+				else
+				{
+					axis->level--;
+					axis->levelStepsRemaining = axis->profile->ramp[axis->level].steps;
+					stepGeneratorSetLevel(axis, &axis->profile->ramp[axis->level]);
+				}
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	// Fixed point compare value. *********************************
+	// Add up the fraction, the carry stretches this period by one tick.
+	// No cli() needed, we are inside the ISR already.
+	uint16_t accumulator = axis->compareAccumulator + axis->compareFraction;
+	axis->compareAccumulator = accumulator;
+	*axis->timerCompare = axis->compareValue + (accumulator >> 8);
+
+	// Prescaler switch. ******************************************
+	uint8_t control = *axis->timerControl;
+	if ((control & STEP_GENERATOR_CLOCK_MASK) != axis->clockSelect)
+	{
+		*axis->timerCounter = 0;
+		*axis->timerControl = (control & ~STEP_GENERATOR_CLOCK_MASK) | axis->clockSelect;
+	}
+}
+
+#endif // STEPGENERATOR_H
@@ -0,0 +1,117 @@
+#include <avr/io.h>
+#include <stdint.h>
+#include "../hardware.h"
+#include "telemetry.h"
+#include "binaryCommands.h"
+#include "motionQueue.h"
+#include "printerFunctions.h"
+#include "virtualSerial.h"
+#include "scheduler.h"
+#include "positionAudit.h"
+
+
+// *****************************************************************************
+// Telemetry variables. ********************************************************
+// *****************************************************************************
+uint16_t telemetryPeriod = 0;			// ms, 0: off.
+uint8_t telemetryCounter = 0;			// Frame counter, lets the host spot dropped frames.
+
+
+// Set period in ms. 0 switches telemetry off. *********************************
+void telemetrySetPeriod(uint16_t input)
+{
+	if (input && input < TELEMETRY_PERIOD_MIN) input = TELEMETRY_PERIOD_MIN;
+	telemetryPeriod = input;
+	schedulerSetPeriod(SCHEDULER_TASK_TELEMETRY, input);
+}
+
+
+// Append little endian values. ************************************************
+static uint8_t telemetryPut16(uint8_t *frame, uint8_t index, uint16_t value)
+{
+	frame[index++] = value;
+	frame[index++] = value >> 8;
+	return index;
+}
+
+static uint8_t telemetryPut32(uint8_t *frame, uint8_t index, uint32_t value)
+{
+	index = telemetryPut16(frame, index, value);
+	return telemetryPut16(frame, index, value >> 16);
+}
+
+
+// *****************************************************************************
+// Send a frame. Scheduler task, runs once per period. ************************
+// *****************************************************************************
+void telemetryService(void)
+{
+	uint8_t frame[TELEMETRY_PAYLOAD_SIZE + 5];
+	uint8_t index = 0;
+	uint16_t compareBuild, compareTilt;
+	uint8_t flags;
+
+	// 16 bit timer registers share the TEMP register with the ISRs.
+	uint8_t sreg = SREG;
+	cli();
+	compareBuild = OCR1A;
+	compareTilt = OCR3A;
+	SREG = sreg;
+
+	frame[index++] = BINARY_SYNC;
+	frame[index++] = TELEMETRY_FRAME_TYPE;
+	frame[index++] = telemetryCounter++;
+	frame[index++] = TELEMETRY_PAYLOAD_SIZE;
+
+	// Positions. Build platform position and target from the same moment.
+	buildPlatformSnapshot_t build;
+	buildPlatformGetSnapshot(&build);
+	index = telemetryPut16(frame, index, buildPlatformPosition);
+	index = telemetryPut16(frame, index, build.target / buildPlatformMinimumMove);
+	index = telemetryPut32(frame, index, build.stepper.position);
+	index = telemetryPut32(frame, index, stepGeneratorGetPosition(&tiltStepper));
+
+	// Motion queue.
+	frame[index++] = motionQueueActiveSegment();
+	frame[index++] = motionQueueDepth();
+
+	// Timers.
+	index = telemetryPut16(frame, index, compareBuild);
+	index = telemetryPut16(frame, index, compareTilt);
+
+	// Limit switches, active high.
+	flags = 0;
+	if (LIMITBUILDBOTTOMPOLL & (1 << LIMITBUILDBOTTOMPIN)) flags |= (1 << 0);
+	if (LIMITBUILDTOPPOLL & (1 << LIMITBUILDTOPPIN)) flags |= (1 << 1);
+	if (LIMITTILTPOLL & (1 << LIMITTILTPIN)) flags |= (1 << 2);
+	frame[index++] = flags;
+
+	// Print progress.
+	index = telemetryPut16(frame, index, printerGetSlice());
+	index = telemetryPut16(frame, index, printerGetNumberOfSlices());
+
+	// Status.
+	flags = 0;
+	if (stepGeneratorRunning(&buildStepper)) flags |= (1 << 0);
+	if (stepGeneratorRunning(&tiltStepper)) flags |= (1 << 1);
+	if (buildPlatformHomingFlag) flags |= (1 << 2);
+	if (printerGetState()) flags |= (1 << 3);
+	if (homingFailed()) flags |= (1 << 4);
+	if (positionAuditFailed()) flags |= (1 << 5);
+	frame[index++] = flags;
+
+	// Lost USB messages, lets the host spot a missing reply.
+	index = telemetryPut16(frame, index, usbDroppedCount());
+
+	// Position audit, see positionAudit.h.
+	index = telemetryPut16(frame, index, positionAuditGetDrift(POSITION_AUDIT_BOTTOM));
+	index = telemetryPut16(frame, index, positionAuditGetDrift(POSITION_AUDIT_TOP));
+
+	// Checksum over everything but the sync byte.
+	uint8_t crc = 0;
+	for (uint8_t i=1; i<index; i++) crc = binaryCrc8(crc, frame[i]);
+	frame[index++] = crc;
+
+	// Dropped if the ring is full, counted in usbDropped.
+	queueDataUSB(frame, index);
+}
@@ -0,0 +1,45 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Telemetry. ******************************************************************
+// *****************************************************************************
+// Periodic status frame on USB. Off by default, switch on with "telemetry <ms>".
+// The frame is queued into the USB transmit ring and sent by manageUSB(), the
+// main loop never waits for the host. Frames that don't fit are dropped.
+// The scheduler runs telemetryService() once per period.
+// Frame:
+//	sync (0xA5) | 0xFE | counter | length | payload | crc
+// Same sync and CRC-8 as the binary command protocol (see binaryCommands.h).
+// Payload, little endian:
+//	uint16	build platform position (standard layers)
+//	uint16	build platform target position (standard layers)
+//	int32	build platform position (steps)
+//	int32	tilt position (steps)
+//	uint8	active motion segment
+//	uint8	motion queue depth
+//	uint16	timer 1 compare value (build platform), ticks of the current prescaler
+//	uint16	timer 3 compare value (tilt), ticks of the current prescaler
+//	uint8	limit switches: bit 0 build bottom, bit 1 build top, bit 2 tilt
+//	uint16	slice
+//	uint16	number of slices
+//	uint8	status: bit 0 build platform running, bit 1 tilt running, bit 2 homing, bit 3 printing,
+//		bit 4 last homing failed, bit 5 position drift over tolerance since homing
+//	uint16	USB messages dropped because the transmit ring was full
+//	int16	last drift at the bottom limit switch (steps)
+//	int16	last drift at the top limit switch (steps)
+
+// Variables. ******************************************************************
+#define TELEMETRY_FRAME_TYPE 0xFE		// In place of the opcode.
+#define TELEMETRY_PAYLOAD_SIZE 30
+#define TELEMETRY_PERIOD_MIN 10			// ms.
+
+
+// Functions. ******************************************************************
+void telemetrySetPeriod(uint16_t input);	// ms, 0: off.
+void telemetryService(void);			// Scheduler task, see scheduler.h.
+
+#endif // TELEMETRY_H
@@ -11,9 +11,9 @@ DESCRIPTION:
     receiving a byte. The interrupt handling routines use circular buffers
     for buffering received and transmitted data.
     
-    The UART_RX_BUFFER_SIZE and UART_TX_BUFFER_SIZE variables define
-    the buffer size in bytes. Note that these variables must be a 
-    power of 2.
+    The UART_RX_BUFFER_SIZE and UART_TX_BUFFER_SIZE variables in
+    ringBuffer.h define the buffer size in bytes. Note that these
+    variables must be a power of 2.
     
 USAGE:
     Refere to the header file uart.h for a description of the routines. 
@@ -91,24 +91,15 @@ Date        Description
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <string.h>
 #include "uart.h"
+#include "ringBuffer.h"
 
 
 /*
  *  constants and macros
  */
 
-/* size of RX/TX buffers */
-#define UART_RX_BUFFER_MASK ( UART_RX_BUFFER_SIZE - 1)
-#define UART_TX_BUFFER_MASK ( UART_TX_BUFFER_SIZE - 1)
-
-#if ( UART_RX_BUFFER_SIZE & UART_RX_BUFFER_MASK )
-#error RX buffer size is not a power of 2
-#endif
-#if ( UART_TX_BUFFER_SIZE & UART_TX_BUFFER_MASK )
-#error TX buffer size is not a power of 2
-#endif
-
 #if defined(__AVR_AT90S2313__) \
  || defined(__AVR_AT90S4414__) || defined(__AVR_AT90S4434__) \
  || defined(__AVR_AT90S8515__) || defined(__AVR_AT90S8535__) \
@@ -303,22 +294,18 @@ Date        Description
 /*
  *  module global variables
  */
-static volatile unsigned char UART_TxBuf[UART_TX_BUFFER_SIZE];
-static volatile unsigned char UART_RxBuf[UART_RX_BUFFER_SIZE];
-static volatile unsigned char UART_TxHead;
-static volatile unsigned char UART_TxTail;
-static volatile unsigned char UART_RxHead;
-static volatile unsigned char UART_RxTail;
+/* RX: ISR produces, main loop consumes. TX: the other way round. */
+RING_BUFFER(static, UART_TxRing, UART_TX_BUFFER_SIZE);
+RING_BUFFER(static, UART_RxRing, UART_RX_BUFFER_SIZE);
 static volatile unsigned char UART_LastRxError;
+volatile unsigned int uart_txDropped;
 
 #if defined( ATMEGA_USART1 )
-static volatile unsigned char UART1_TxBuf[UART_TX_BUFFER_SIZE];
-static volatile unsigned char UART1_RxBuf[UART_RX_BUFFER_SIZE];
-static volatile unsigned char UART1_TxHead;
-static volatile unsigned char UART1_TxTail;
-static volatile unsigned char UART1_RxHead;
-static volatile unsigned char UART1_RxTail;
+/* RX: ISR produces, main loop consumes. TX: the other way round. */
+RING_BUFFER(static, UART1_TxRing, UART_TX_BUFFER_SIZE);
+RING_BUFFER(static, UART1_RxRing, UART_RX_BUFFER_SIZE);
 static volatile unsigned char UART1_LastRxError;
+volatile unsigned int uart1_txDropped;
 #endif
 
 
@@ -332,7 +319,6 @@ Function: UART Receive Complete interrupt
 Purpose:  called when the UART has received a character
 **************************************************************************/
 {
-    unsigned char tmphead;
     unsigned char data;
     unsigned char usr;
     unsigned char lastRxError;
@@ -353,17 +339,10 @@ Purpose:  called when the UART has received a character
     lastRxError = (usr & (_BV(FE)|_BV(DOR)) );
 #endif
         
-    /* calculate buffer index */ 
-    tmphead = ( UART_RxHead + 1) & UART_RX_BUFFER_MASK;
-    
-    if ( tmphead == UART_RxTail ) {
+    /* store received data in buffer */
+    if ( !ringBufferPut(&UART_RxRing, data) ) {
         /* error: receive buffer overflow */
         lastRxError = UART_BUFFER_OVERFLOW >> 8;
-    }else{
-        /* store new index */
-        UART_RxHead = tmphead;
-        /* store received data in buffer */
-        UART_RxBuf[tmphead] = data;
     }
     UART_LastRxError = lastRxError;   
 }
@@ -375,15 +354,12 @@ Function: UART Data Register Empty interrupt
 Purpose:  called when the UART is ready to transmit the next byte
 **************************************************************************/
 {
-    unsigned char tmptail;
+    unsigned char data;
 
     
-    if ( UART_TxHead != UART_TxTail) {
-        /* calculate and store new buffer index */
-        tmptail = (UART_TxTail + 1) & UART_TX_BUFFER_MASK;
-        UART_TxTail = tmptail;
+    if ( ringBufferGet(&UART_TxRing, &data) ) {
         /* get one byte from buffer and write it to UART */
-        UART0_DATA = UART_TxBuf[tmptail];  /* start transmission */
+        UART0_DATA = data;  /* start transmission */
     }else{
         /* tx buffer empty, disable UDRE interrupt */
         UART0_CONTROL &= ~_BV(UART0_UDRIE);
@@ -399,10 +375,8 @@ Returns:  none
 **************************************************************************/
 void uart_init(unsigned int baudrate)
 {
-    UART_TxHead = 0;
-    UART_TxTail = 0;
-    UART_RxHead = 0;
-    UART_RxTail = 0;
+    ringBufferFlush(&UART_TxRing);
+    ringBufferFlush(&UART_RxRing);
     
 #if defined( AT90_UART )
     /* set baud rate */
@@ -477,21 +451,14 @@ Returns:  lower byte:  received byte from ringbuffer
 **************************************************************************/
 unsigned int uart_getc(void)
 {    
-    unsigned char tmptail;
     unsigned char data;
 
 
-    if ( UART_RxHead == UART_RxTail ) {
+    /* get data from receive buffer */
+    if ( !ringBufferGet(&UART_RxRing, &data) ) {
         return UART_NO_DATA;   /* no data available */
     }
     
-    /* calculate /store buffer index */
-    tmptail = (UART_RxTail + 1) & UART_RX_BUFFER_MASK;
-    UART_RxTail = tmptail; 
-    
-    /* get data from receive buffer */
-    data = UART_RxBuf[tmptail];
-    
     return (UART_LastRxError << 8) + data;
 
 }/* uart_getc */
@@ -505,17 +472,11 @@ Returns:  none
 **************************************************************************/
 void uart_putc(unsigned char data)
 {
-    unsigned char tmphead;
-
-    
-    tmphead  = (UART_TxHead + 1) & UART_TX_BUFFER_MASK;
-    
-    while ( tmphead == UART_TxTail ){
-        ;/* wait for free space in buffer */
+    if ( !ringBufferPut(&UART_TxRing, data) ) {
+        /* buffer full, don't wait for the UART */
+        uart_txDropped++;
+        return;
     }
-    
-    UART_TxBuf[tmphead] = data;
-    UART_TxHead = tmphead;
 
     /* enable UDRE interrupt */
     UART0_CONTROL    |= _BV(UART0_UDRIE);
@@ -531,12 +492,37 @@ Returns:  none
 **************************************************************************/
 void uart_puts(const char *s )
 {
-    while (*s) 
-      uart_putc(*s++);
+    size_t length = strlen(s);
+
+    if ( length > 255 ) {
+        uart_txDropped++;
+        return;
+    }
+    uart_putdata((const unsigned char *)s, length);
 
 }/* uart_puts */
 
 
+/*************************************************************************
+Function: uart_putdata()
+Purpose:  write a whole message to ringbuffer for transmitting via UART
+Input:    data and length
+Returns:  none
+**************************************************************************/
+void uart_putdata(const unsigned char *data, unsigned char length)
+{
+    if ( !ringBufferWrite(&UART_TxRing, data, length) ) {
+        /* not enough room, drop the whole message, never a part of it */
+        uart_txDropped++;
+        return;
+    }
+
+    /* enable UDRE interrupt */
+    UART0_CONTROL    |= _BV(UART0_UDRIE);
+
+}/* uart_putdata */
+
+
 /*************************************************************************
 Function: uart_puts_p()
 Purpose:  transmit string from program memory to UART
@@ -562,7 +548,7 @@ Returns:  Integer number of bytes in the receive buffer
 **************************************************************************/
 int uart_available(void)
 {
-        return (UART_RX_BUFFER_MASK + UART_RxHead - UART_RxTail) % UART_RX_BUFFER_MASK;
+        return ringBufferUsed(&UART_RxRing);
 }/* uart_available */
 
 
@@ -575,7 +561,7 @@ Returns:  None
 **************************************************************************/
 void uart_flush(void)
 {
-        UART_RxHead = UART_RxTail;
+        ringBufferFlush(&UART_RxRing);
 }/* uart_flush */
 
 #endif
@@ -591,7 +577,6 @@ Function: UART1 Receive Complete interrupt
 Purpose:  called when the UART1 has received a character
 **************************************************************************/
 {
-    unsigned char tmphead;
     unsigned char data;
     unsigned char usr;
     unsigned char lastRxError;
@@ -604,17 +589,10 @@ Purpose:  called when the UART1 has received a character
     /* */
     lastRxError = (usr & (_BV(FE1)|_BV(DOR1)) );
         
-    /* calculate buffer index */ 
-    tmphead = ( UART1_RxHead + 1) & UART_RX_BUFFER_MASK;
-    
-    if ( tmphead == UART1_RxTail ) {
+    /* store received data in buffer */
+    if ( !ringBufferPut(&UART1_RxRing, data) ) {
         /* error: receive buffer overflow */
         lastRxError = UART_BUFFER_OVERFLOW >> 8;
-    }else{
-        /* store new index */
-        UART1_RxHead = tmphead;
-        /* store received data in buffer */
-        UART1_RxBuf[tmphead] = data;
     }
     UART1_LastRxError = lastRxError;   
 }
@@ -626,15 +604,12 @@ Function: UART1 Data Register Empty interrupt
 Purpose:  called when the UART1 is ready to transmit the next byte
 **************************************************************************/
 {
-    unsigned char tmptail;
+    unsigned char data;
 
     
-    if ( UART1_TxHead != UART1_TxTail) {
-        /* calculate and store new buffer index */
-        tmptail = (UART1_TxTail + 1) & UART_TX_BUFFER_MASK;
-        UART1_TxTail = tmptail;
+    if ( ringBufferGet(&UART1_TxRing, &data) ) {
         /* get one byte from buffer and write it to UART */
-        UART1_DATA = UART1_TxBuf[tmptail];  /* start transmission */
+        UART1_DATA = data;  /* start transmission */
     }else{
         /* tx buffer empty, disable UDRE interrupt */
         UART1_CONTROL &= ~_BV(UART1_UDRIE);
@@ -650,10 +625,8 @@ Returns:  none
 **************************************************************************/
 void uart1_init(unsigned int baudrate)
 {
-    UART1_TxHead = 0;
-    UART1_TxTail = 0;
-    UART1_RxHead = 0;
-    UART1_RxTail = 0;
+    ringBufferFlush(&UART1_TxRing);
+    ringBufferFlush(&UART1_RxRing);
     
 
     /* Set baud rate */
@@ -685,21 +658,14 @@ Returns:  lower byte:  received byte from ringbuffer
 **************************************************************************/
 unsigned int uart1_getc(void)
 {    
-    unsigned char tmptail;
     unsigned char data;
 
 
-    if ( UART1_RxHead == UART1_RxTail ) {
+    /* get data from receive buffer */
+    if ( !ringBufferGet(&UART1_RxRing, &data) ) {
         return UART_NO_DATA;   /* no data available */
     }
     
-    /* calculate /store buffer index */
-    tmptail = (UART1_RxTail + 1) & UART_RX_BUFFER_MASK;
-    UART1_RxTail = tmptail; 
-    
-    /* get data from receive buffer */
-    data = UART1_RxBuf[tmptail];
-    
     return (UART1_LastRxError << 8) + data;
 
 }/* uart1_getc */
@@ -713,17 +679,11 @@ Returns:  none
 **************************************************************************/
 void uart1_putc(unsigned char data)
 {
-    unsigned char tmphead;
-
-    
-    tmphead  = (UART1_TxHead + 1) & UART_TX_BUFFER_MASK;
-    
-    while ( tmphead == UART1_TxTail ){
-        ;/* wait for free space in buffer */
+    if ( !ringBufferPut(&UART1_TxRing, data) ) {
+        /* buffer full, don't wait for the UART */
+        uart1_txDropped++;
+        return;
     }
-    
-    UART1_TxBuf[tmphead] = data;
-    UART1_TxHead = tmphead;
 
     /* enable UDRE interrupt */
     UART1_CONTROL    |= _BV(UART1_UDRIE);
@@ -739,12 +699,37 @@ Returns:  none
 **************************************************************************/
 void uart1_puts(const char *s )
 {
-    while (*s) 
-      uart1_putc(*s++);
+    size_t length = strlen(s);
+
+    if ( length > 255 ) {
+        uart1_txDropped++;
+        return;
+    }
+    uart1_putdata((const unsigned char *)s, length);
 
 }/* uart1_puts */
 
 
+/*************************************************************************
+Function: uart1_putdata()
+Purpose:  write a whole message to ringbuffer for transmitting via UART
+Input:    data and length
+Returns:  none
+**************************************************************************/
+void uart1_putdata(const unsigned char *data, unsigned char length)
+{
+    if ( !ringBufferWrite(&UART1_TxRing, data, length) ) {
+        /* not enough room, drop the whole message, never a part of it */
+        uart1_txDropped++;
+        return;
+    }
+
+    /* enable UDRE interrupt */
+    UART1_CONTROL    |= _BV(UART1_UDRIE);
+
+}/* uart1_putdata */
+
+
 /*************************************************************************
 Function: uart1_puts_p()
 Purpose:  transmit string from program memory to UART1
@@ -770,7 +755,7 @@ Returns:  Integer number of bytes in the receive buffer
 **************************************************************************/
 int uart1_available(void)
 {
-        return (UART_RX_BUFFER_MASK + UART1_RxHead - UART1_RxTail) % UART_RX_BUFFER_MASK;
+        return ringBufferUsed(&UART1_RxRing);
 }/* uart1_available */
 
 
@@ -783,7 +768,7 @@ Returns:  None
 **************************************************************************/
 void uart1_flush(void)
 {
-        UART1_RxHead = UART1_RxTail;
+        ringBufferFlush(&UART1_RxRing);
 }/* uart1_flush */
 
 #endif
@@ -58,6 +58,11 @@ Date        Description
 			that it would be as close as possible to Peter Fleury's original
 			library, but has scoping issues accessing internal variables from
 			another program.  Go C!
+10/17/2026  Receive and transmit buffers are rings from ringBuffer.h, where
+			their sizes are set. uart_putc() drops the byte instead of
+			waiting when the transmit ring is full, see uart_txDropped.
+			uart_puts() and uart_putdata() queue whole messages or drop
+			them as a whole, so a full ring never cuts a line or frame.
 
 ************************************************************************/
 
@@ -73,10 +78,8 @@ Date        Description
  *  receiving a byte. The interrupt handling routines use circular buffers
  *  for buffering received and transmitted data.
  *
- *  The UART_RX_BUFFER_SIZE and UART_TX_BUFFER_SIZE constants define
+ *  The UART_RX_BUFFER_SIZE and UART_TX_BUFFER_SIZE constants in ringBuffer.h define
  *  the size of the circular buffers in bytes. Note that these constants must be a power of 2.
- *  You may need to adapt this constants to your target and your application by adding 
- *  CDEFS += -DUART_RX_BUFFER_SIZE=nn -DUART_RX_BUFFER_SIZE=nn to your Makefile.
  *
  *  @note Based on Atmel Application Note AVR306
  *  @author Peter Fleury pfleury@gmx.ch  http://jump.to/fleury
@@ -107,14 +110,8 @@ Date        Description
 #define UART_BAUD_SELECT_DOUBLE_SPEED(baudRate,xtalCpu) (((xtalCpu)/((baudRate)*8l)-1)|0x8000)
 
 
-/** Size of the circular receive buffer, must be power of 2 */
-#ifndef UART_RX_BUFFER_SIZE
-#define UART_RX_BUFFER_SIZE 32
-#endif
-/** Size of the circular transmit buffer, must be power of 2 */
-#ifndef UART_TX_BUFFER_SIZE
-#define UART_TX_BUFFER_SIZE 32
-#endif
+/** Sizes of the circular buffers, see ringBuffer.h */
+#include "ringBuffer.h"
 
 /* test if the size of the circular buffers fits into SRAM */
 #if ( (UART_RX_BUFFER_SIZE+UART_TX_BUFFER_SIZE) >= (RAMEND-0x60 ) )
@@ -172,6 +169,9 @@ extern unsigned int uart_getc(void);
 
 /**
  *  @brief   Put byte to ringbuffer for transmitting via UART
+ *
+ *  Does not wait. The byte is dropped if the ringbuffer is full.
+ *
  *  @param   data byte to be transmitted
  *  @return  none
  */
@@ -183,7 +183,7 @@ extern void uart_putc(unsigned char data);
  *
  *  The string is buffered by the uart library in a circular buffer
  *  and one character at a time is transmitted to the UART using interrupts.
- *  Blocks if it can not write the whole string into the circular buffer.
+ *  Characters that do not fit into the circular buffer are dropped.
  * 
  *  @param   s string to be transmitted
  *  @return  none
@@ -196,7 +196,7 @@ extern void uart_puts(const char *s );
  *
  * The string is buffered by the uart library in a circular buffer
  * and one character at a time is transmitted to the UART using interrupts.
- * Blocks if it can not write the whole string into the circular buffer.
+ * Characters that do not fit into the circular buffer are dropped.
  *
  * @param    s program memory string to be transmitted
  * @return   none
@@ -223,6 +223,22 @@ extern int uart_available(void);
  */
 extern void uart_flush(void);
 
+/**
+ *  @brief   Bytes or messages dropped because the transmit buffer was full
+ */
+extern volatile unsigned int uart_txDropped;
+
+/**
+ *  @brief   Put a whole message to the ringbuffer for transmitting via the UART
+ *
+ *  All or nothing: if the ring has no room for all bytes, the message is
+ *  dropped and counted in uart_txDropped.
+ *  @param   data    bytes to be transmitted
+ *  @param   length  number of bytes
+ *  @return  none
+ */
+extern void uart_putdata(const unsigned char *data, unsigned char length);
+
 
 /** @brief  Initialize USART1 (only available on selected ATmegas) @see uart_init */
 extern void uart1_init(unsigned int baudrate);
@@ -232,6 +248,8 @@ extern unsigned int uart1_getc(void);
 extern void uart1_putc(unsigned char data);
 /** @brief  Put string to ringbuffer for transmitting via USART1 (only available on selected ATmega) @see uart_puts */
 extern void uart1_puts(const char *s );
+/** @brief  Put a whole message to ringbuffer for transmitting via USART1 (only available on selected ATmega) @see uart_putdata */
+extern void uart1_putdata(const unsigned char *data, unsigned char length);
 /** @brief  Put string from program memory to ringbuffer for transmitting via USART1 (only available on selected ATmega) @see uart_puts_p */
 extern void uart1_puts_p(const char *s );
 /** @brief  Macro to automatically put a string constant into program memory */
@@ -240,6 +258,8 @@ extern void uart1_puts_p(const char *s );
 extern int uart1_available(void);
 /** @brief   Flush bytes waiting in receive buffer */
 extern void uart1_flush(void);
+/** @brief   Bytes or messages dropped because the transmit buffer of USART1 was full */
+extern volatile unsigned int uart1_txDropped;
 
 /**@}*/
 
@@ -20,13 +20,13 @@ USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface =
 					{
 						.Address          = CDC_TX_EPADDR,
 						.Size             = CDC_TXRX_EPSIZE,
-						.Banks            = 1,
+						.Banks            = CDC_TXRX_BANKS,
 					},
 				.DataOUTEndpoint =
 					{
 						.Address          = CDC_RX_EPADDR,
 						.Size             = CDC_TXRX_EPSIZE,
-						.Banks            = 1,
+						.Banks            = CDC_TXRX_BANKS,
 					},
 				.NotificationEndpoint =
 					{
@@ -37,109 +37,107 @@ USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface =
 			},
 	};
 
+// Transmit ring buffer. ******************************************************
+// Everything sent is queued here and written to the IN endpoint by manageUSB()
+// as far as there is room, so the main loop never waits for the host.
+RING_BUFFER(static, usbTxRing, USB_TX_BUFFER_SIZE);
+uint16_t usbDropped = 0;		// Messages that did not fit.
+uint8_t usbPeak = 0;			// Highest fill level.
+uint8_t usbOpened = 0;			// Host raised DTR, cleared when read.
+
+uint16_t usbDroppedCount(void)
+{
+	return usbDropped;
+}
+
+uint8_t usbPeakFill(void)
+{
+	return usbPeak;
+}
+
+uint8_t usbPortOpened(void)
+{
+	uint8_t opened = usbOpened;
+	usbOpened = 0;
+	return opened;
+}
+
 //****************************************************************************//
 //******************* Sending and receiving functions. ***********************//
 //****************************************************************************//
 
-// Function: Send string via USB. **********************************************
-uint8_t sendStringUSB(char* dataString)
+// Function: Queue a message for sending. Does not wait. ***********************
+// Returns 0 and drops the whole message if it does not fit.
+uint8_t queueDataUSB(uint8_t* data, uint16_t length)
 {
-	// Send string and return error variable.
-	// See http://www.fourwalledcubicle.com/files/LUFA/Doc/120730/html/group___group___endpoint_stream_r_w.html#ga7f0d584afdd478f8fdf20b9daf58394b
-	uint8_t errorCode = CDC_Device_SendString(&VirtualSerial_CDC_Interface, dataString);
-	
-	// Evaluate error code and signal LEDs.
-	if (errorCode == ENDPOINT_RWSTREAM_Timeout)
+	// Make room with what the endpoint takes right now.
+	if (length > ringBufferFree(&usbTxRing)) drainUSB();
+	if (length > ringBufferFree(&usbTxRing))
 	{
+		usbDropped++;
 		// Blink if hardware exists.
 		#if defined LED1ONBOARDPORT
 		ledYellowToggle();
-		_delay_us(20);
-		ledYellowToggle();
-		_delay_us(10);
-		ledYellowToggle();
-		_delay_us(20);
-		ledYellowToggle();
-		#endif
-	}
-	else if (errorCode == ENDPOINT_RWSTREAM_NoError)
-	{
-		// Blink if hardware exists.
-		#if defined LED2ONBOARDPORT
-		ledGreenToggle();
-		_delay_us(20);
-		ledGreenToggle();
 		#endif
+		return 0;
 	}
-	return errorCode;
+	ringBufferWrite(&usbTxRing, data, length);
+	uint8_t used = ringBufferUsed(&usbTxRing);
+	if (used > usbPeak) usbPeak = used;
+	return 1;
 }
 
-void sendByteAsStringUSB(uint16_t dataByte)
+// Function: Send string via USB. **********************************************
+uint8_t sendStringUSB(char* dataString)
 {
-	char dataString[10];
-	itoa( dataByte, dataString, 10 );
-	strcat(dataString,"\n");
-	// Send string and return error variable.
-	// See http://www.fourwalledcubicle.com/files/LUFA/Doc/120730/html/group___group___endpoint_stream_r_w.html#ga7f0d584afdd478f8fdf20b9daf58394b
-	uint8_t errorCode = CDC_Device_SendString(&VirtualSerial_CDC_Interface, dataString);
+	return queueDataUSB((uint8_t*)dataString, strlen(dataString));
+}
 
-	// Evaluate error code and signal LEDs.
-	if (errorCode == ENDPOINT_READYWAIT_Timeout)
-	{
-		// Blink if hardware exists.
-		#if defined LED1ONBOARDPORT
-		ledYellowToggle();
-		_delay_us(20);
-		ledYellowToggle();
-		_delay_us(10);
-		ledYellowToggle();
-		_delay_us(20);
-		ledYellowToggle();
-		#endif
-	}
-	else if (errorCode == ENDPOINT_READYWAIT_NoError)
-	{
-		// Blink if hardware exists.
-		#if defined LED2ONBOARDPORT
-		ledGreenToggle();
-		_delay_us(20);
-		ledGreenToggle();
-		#endif
-	}
-	//CDC_Device_Flush(&VirtualSerial_CDC_Interface);
+// Function: Send number as decimal string with newline via USB. ***************
+void sendByteAsStringUSB(uint16_t dataByte)
+{
+	char dataString[7];			// "65535\n"
+	utoa(dataByte, dataString, 10);
+	uint8_t length = strlen(dataString);
+	dataString[length++] = '\n';
+	queueDataUSB((uint8_t*)dataString, length);
 }
 
 // Function: Send byte via USB. ************************************************
 void sendByteUSB(uint8_t dataByte)
 {
-	// Send byte and return error variable.
-	// See http://www.fourwalledcubicle.com/files/LUFA/Doc/120730/html/group___group___endpoint_r_w___x_m_e_g_a.html#gaa42b7eb8d1be3afadb97097bf2605740
-	uint8_t errorCode = CDC_Device_SendByte(&VirtualSerial_CDC_Interface, dataByte);
+	queueDataUSB(&dataByte, 1);
+}
+
+// Function: Send raw bytes via USB. *******************************************
+uint8_t sendDataUSB(uint8_t* data, uint16_t length)
+{
+	// Unlike strings, binary data may contain zeros.
+	return queueDataUSB(data, length);
+}
+
 
-	// Evaluate error code and signal LEDs.
-	if (errorCode == ENDPOINT_READYWAIT_Timeout)
+// Function: Write queued bytes to the IN endpoint. ****************************
+// Stops when both endpoint banks are busy, the rest goes on the next call.
+void drainUSB(void)
+{
+	if (ringBufferEmpty(&usbTxRing)) return;
+	// Drop queued data while no host is listening.
+	if ((USB_DeviceState != DEVICE_STATE_Configured) || !(VirtualSerial_CDC_Interface.State.LineEncoding.BaudRateBPS))
 	{
-		// Blink if hardware exists.
-		#if defined LED1ONBOARDPORT
-		ledYellowToggle();
-		_delay_us(20);
-		ledYellowToggle();
-		_delay_us(10);
-		ledYellowToggle();
-		_delay_us(20);
-		ledYellowToggle();
-		#endif
+		ringBufferFlush(&usbTxRing);
+		return;
 	}
-	else if (errorCode == ENDPOINT_READYWAIT_NoError)
+
+	Endpoint_SelectEndpoint(VirtualSerial_CDC_Interface.Config.DataINEndpoint.Address);
+	uint8_t data;
+	while (Endpoint_IsReadWriteAllowed() && ringBufferGet(&usbTxRing, &data))
 	{
-		// Blink if hardware exists.
-		#if defined LED2ONBOARDPORT
-		ledGreenToggle();
-		_delay_us(20);
-		ledGreenToggle();
-		#endif
+		Endpoint_Write_8(data);
+		// Bank full, hand it to the host.
+		if (!Endpoint_IsReadWriteAllowed()) Endpoint_ClearIN();
 	}
-	//CDC_Device_Flush(&VirtualSerial_CDC_Interface);
+	// A partly filled bank is flushed by CDC_Device_USBTask().
 }
 
 
@@ -203,6 +201,9 @@ void manageUSB(uint8_t receiving)
 		CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
 	}
 
+	// Send queued data as far as the endpoint banks allow.
+	drainUSB();
+
 	// Call CDC and USB management functions for proper operation.
 	// Must be called every at least every 30 ms in device mode.
 	// See http://www.fourwalledcubicle.com/files/LUFA/Doc/120730/html/group___group___u_s_b_management.html#gac4059f84a2fc0b926c31868c744f5853
@@ -253,3 +254,10 @@ void EVENT_USB_Device_ControlRequest(void)
 {
 	CDC_Device_ProcessControlRequest(&VirtualSerial_CDC_Interface);
 }
+
+// Event handler for the CDC control line change event. ************************
+// Terminal programs and pyserial raise DTR when they open the port.
+void EVENT_CDC_Device_ControLineStateChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo)
+{
+	if (CDCInterfaceInfo->State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR) usbOpened = 1;
+}
@@ -5,16 +5,35 @@
 #ifndef _VIRTUALSERIAL_H_
 #define _VIRTUALSERIAL_H_
 
+#ifndef SIMULATION
 // Include LUFA stuff.
 #include "Descriptors.h"
 
 #include <LUFA/Drivers/USB/USB.h>
 #include <LUFA/Platform/Platform.h>
+#else
+// Host build, see sim/simUsb.c. Includes what Descriptors.h brings in.
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#endif
+
+// Transmit ring buffer, size see ringBuffer.h. All send functions only queue,
+// manageUSB() writes to the endpoint as far as the host takes the data.
+// Nothing waits for the host. A message that does not fit is dropped as a
+// whole and counted.
+#include "ringBuffer.h"
 
 // Function prototypes sending and receiving.
+// Send functions return 0 if the message was dropped.
 uint8_t sendStringUSB(char* dataString);
 void sendByteAsStringUSB(uint16_t dataByte);
 void sendByteUSB(uint8_t dataByte);
+uint8_t sendDataUSB(uint8_t* data, uint16_t length);
+uint8_t queueDataUSB(uint8_t* data, uint16_t length);
+void drainUSB(void);					// Write queued bytes to the endpoint. Does not wait.
+uint16_t usbDroppedCount(void);				// Messages dropped because the ring was full.
+uint8_t usbPeakFill(void);				// Highest fill level of the ring, bytes.
+uint8_t usbPortOpened(void);				// 1 once after the host opened the port.
 uint16_t bytesWaitingUSB(void);
 uint16_t receiveByteUSB(void);
 char receiveCharUSB(void);
@@ -0,0 +1,222 @@
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "watchdog.h"
+#include "positionAudit.h"
+#include "printJob.h"
+#include "printerFunctions.h"
+#include "virtualSerial.h"
+#include "uartSerial.h"
+
+
+// *****************************************************************************
+// Watchdog variables. *********************************************************
+// *****************************************************************************
+// Not cleared at start up, watchdogInit() checks the magic.
+watchdogRecord_t watchdogRecord __attribute__((section(".noinit")));
+
+watchdogRecord_t watchdogLast;			// Record from before the reset.
+uint8_t watchdogLastValid = 0;
+uint8_t watchdogUartPending = 0;		// Report once on UART after the reset.
+
+
+// *****************************************************************************
+// Checksum. *******************************************************************
+// *****************************************************************************
+// Fletcher style sums modulo 256, no division. Cheap enough for every main
+// loop pass, and the second sum depends on the byte order.
+static uint16_t watchdogChecksum (void)
+{
+	const uint8_t *data = (const uint8_t*)&watchdogRecord;
+	uint8_t sum1 = 0x5A;
+	uint8_t sum2 = 0xC3;
+	for (uint8_t i=0; i<offsetof(watchdogRecord_t, isr); i++)
+	{
+		sum1 += data[i];
+		sum2 += sum1;
+	}
+	return ((uint16_t)sum2 << 8) | sum1;
+}
+
+// Call with interrupts off after changing a checksummed field.
+static void watchdogSeal (void)
+{
+	watchdogRecord.checksum = watchdogChecksum();
+}
+
+static uint8_t watchdogRecordValid (void)
+{
+	return watchdogRecord.magic == WATCHDOG_MAGIC
+		&& watchdogRecord.checksum == watchdogChecksum()
+		&& watchdogRecord.isr == (uint8_t)~watchdogRecord.isrCheck;
+}
+
+
+
+// *****************************************************************************
+// Start up. *******************************************************************
+// *****************************************************************************
+void watchdogInit (void)
+{
+	// A watchdog reset leaves the watchdog running at the shortest timeout.
+	// The Caterina bootloader clears MCUSR before we get here, see watchdog.h.
+	uint8_t cause = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+
+	// After power on the SRAM holds garbage. PORF can't be relied on behind
+	// the bootloader, the checksum has to catch it.
+	if (!(cause & (1 << PORF)) && watchdogRecordValid())
+	{
+		watchdogLast = watchdogRecord;
+		watchdogLast.resetCause = cause;
+		watchdogLast.command[WATCHDOG_COMMAND_SIZE - 1] = '\0';
+		watchdogLastValid = 1;
+		watchdogUartPending = 1;
+	}
+
+	// Fresh record for this run.
+	memset(&watchdogRecord, 0, sizeof(watchdogRecord));
+	watchdogRecord.magic = WATCHDOG_MAGIC;
+	WATCHDOG_ISR_LEAVE();
+	watchdogSeal();
+}
+
+void watchdogRecover (void)
+{
+	if (!watchdogLastValid) return;
+	stepGeneratorSetPosition(&buildStepper, watchdogLast.buildSteps);
+	buildPlatformLockPosition();
+	printerSetSlice(watchdogLast.slice);
+	// Steppers were stopped before the reset, the count is as good as after homing.
+	if ((watchdogLast.flags & WATCHDOG_HOMED) && (watchdogLast.flags & WATCHDOG_EXACT)) positionAuditHomed();
+}
+
+void watchdogStart (void)
+{
+	wdt_enable(WATCHDOG_TIMEOUT);
+	// Interrupt first, reset on the next timeout.
+	WDTCSR |= (1 << WDIE);
+}
+
+
+
+// *****************************************************************************
+// Record. *********************************************************************
+// *****************************************************************************
+static void watchdogSnapshot (uint8_t flags)
+{
+	if (positionAuditReferenced()) flags |= WATCHDOG_HOMED;
+	if (!printJobIdle() || printerGetState()) flags |= WATCHDOG_PRINTING;
+	// The watchdog interrupt must not land between the fields.
+	uint8_t sreg = SREG;
+	cli();
+	watchdogRecord.buildSteps = stepGeneratorGetPosition(&buildStepper);
+	watchdogRecord.slice = printerGetSlice();
+	watchdogRecord.flags = flags;
+	watchdogSeal();
+	SREG = sreg;
+}
+
+void watchdogNoteCommand (char *command)
+{
+	uint8_t sreg = SREG;
+	cli();
+	strncpy(watchdogRecord.command, command, WATCHDOG_COMMAND_SIZE - 1);
+	watchdogSeal();
+	SREG = sreg;
+}
+
+void watchdogNoteOpcode (uint8_t opcode)
+{
+	uint8_t sreg = SREG;
+	cli();
+	strcpy(watchdogRecord.command, "bin ");
+	utoa(opcode, watchdogRecord.command + 4, 16);
+	watchdogSeal();
+	SREG = sreg;
+}
+
+void watchdogClear (void)
+{
+	watchdogLastValid = 0;
+}
+
+
+
+// *****************************************************************************
+// Report. *********************************************************************
+// *****************************************************************************
+static void watchdogAppend (char *string, int32_t value)
+{
+	ltoa(value, string + strlen(string), 10);
+	strcat(string, " ");
+}
+
+void watchdogReport (uint8_t channel)
+{
+	char reportString[24 + WATCHDOG_COMMAND_SIZE + 24];
+	if (!watchdogLastValid) strcpy(reportString, "crash none\n");
+	else
+	{
+		strcpy(reportString, "crash ");
+		watchdogAppend(reportString, watchdogLast.resetCause);
+		watchdogAppend(reportString, watchdogLast.isr);
+		watchdogAppend(reportString, watchdogLast.buildSteps);
+		watchdogAppend(reportString, watchdogLast.slice);
+		watchdogAppend(reportString, watchdogLast.flags);
+		strcat(reportString, watchdogLast.command);
+		strcat(reportString, "\n");
+	}
+	if (!channel) sendStringUSB(reportString);
+	else	sendStringUART(reportString);
+}
+
+
+
+// *****************************************************************************
+// Feed. Call every main loop pass. ********************************************
+// *****************************************************************************
+void watchdogService (void)
+{
+	// The timeout stopped the steppers. Slow pass or not, finish the reset.
+	if (watchdogRecord.flags & WATCHDOG_EXACT) while (1);
+	wdt_reset();
+	watchdogSnapshot(0);
+
+	uint8_t opened = usbPortOpened();
+	if (!watchdogLastValid) return;
+	if (opened) watchdogReport(0);
+	if (watchdogUartPending)
+	{
+		watchdogUartPending = 0;
+		watchdogReport(1);
+	}
+}
+
+
+
+// *****************************************************************************
+// Fault paths. ****************************************************************
+// *****************************************************************************
+// Main loop hangs. Stop where we are, so the step count stays exact until the
+// reset. The reset follows on the next timeout.
+void watchdogTimeout (void)
+{
+	stepGeneratorStop(&buildStepper);
+	stepGeneratorStop(&tiltStepper);
+	watchdogSnapshot(WATCHDOG_EXACT);
+}
+
+void watchdogFatal (uint8_t isr)
+{
+	cli();
+	WATCHDOG_ISR_ENTER(isr);
+	watchdogTimeout();
+	wdt_enable(WDTO_15MS);
+	while (1);
+}
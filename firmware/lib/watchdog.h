@@ -0,0 +1,92 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Watchdog and crash record. **************************************************
+// *****************************************************************************
+// The main loop feeds the watchdog once per pass. If it hangs for
+// WATCHDOG_TIMEOUT, the watchdog interrupt stops both steppers, so the step
+// count stays exact, and saves the position. The next timeout resets the
+// chip. An ISR that hangs with interrupts off gets the reset without the
+// interrupt, unexpected interrupts (BADISR_vect) force it right away.
+// The crash record lives in .noinit and survives the reset. After power on
+// the SRAM holds garbage, so the record is only taken over if the magic, a
+// checksum and the complement of the ISR id match. The main loop updates the
+// checksum with every change, the ISRs only touch the ISR id and its
+// complement. Contents:
+//	last command line, binary frames as "bin <opcode>" (hex),
+//	ISR running at the time, see WATCHDOG_ISR_x,
+//	build platform position and slice, updated every main loop pass,
+//	MCUSR after the reset. Not available behind the Caterina (avr109)
+//	bootloader, it clears MCUSR before it starts the application, the
+//	field reads 0 then.
+// After a reset other than power on, the firmware starts with motors off,
+// shutter closed and no print job. If the position was exact and the build
+// platform homed, the step count is restored and the host may resume without
+// homing. Otherwise the last known position is restored for reference only.
+// The record is sent every time the host opens the USB port, on UART once
+// after the reset, and with "crash", until "crashClear":
+//	"crash <mcusr> <isr> <steps> <slice> <flags> <command>"
+//	flags: bit 0 homed, bit 1 position exact, bit 2 printing.
+// Without a record "crash none" is sent.
+
+// Variables. ******************************************************************
+#define WATCHDOG_TIMEOUT WDTO_1S		// Per stage, interrupt then reset.
+#define WATCHDOG_MAGIC 0xC4A5			// Record valid.
+#define WATCHDOG_COMMAND_SIZE 16		// Including '\0'.
+
+// ISR running.
+#define WATCHDOG_ISR_NONE 0			// Main loop.
+#define WATCHDOG_ISR_TICK 1			// Timer 0 compare A.
+#define WATCHDOG_ISR_BUILD 2			// Timer 1 compare A.
+#define WATCHDOG_ISR_TILT 3			// Timer 3 compare A.
+#define WATCHDOG_ISR_EXPOSURE 4			// Timer 0 compare B.
+#define WATCHDOG_ISR_SERVO 5			// Timer 4 overflow.
+#define WATCHDOG_ISR_BUILD_TOP 6		// INT1.
+#define WATCHDOG_ISR_BUILD_BOTTOM 7		// INT0.
+#define WATCHDOG_ISR_TILT_SWITCH 8		// INT6.
+#define WATCHDOG_ISR_BAD 0xFF			// Unexpected interrupt.
+
+// Record flags.
+#define WATCHDOG_HOMED (1 << 0)
+#define WATCHDOG_EXACT (1 << 1)
+#define WATCHDOG_PRINTING (1 << 2)
+
+typedef struct
+{
+	// Covered by the checksum.
+	uint16_t magic;
+	uint8_t resetCause;			// MCUSR, filled in after the reset.
+	volatile uint8_t flags;
+	volatile int32_t buildSteps;
+	uint16_t slice;
+	char command[WATCHDOG_COMMAND_SIZE];
+	// Written by the ISRs.
+	volatile uint8_t isr;
+	volatile uint8_t isrCheck;		// ~isr.
+	uint16_t checksum;			// Fletcher style sums of the fields up to isr.
+} watchdogRecord_t;
+
+extern watchdogRecord_t watchdogRecord;		// Live record, .noinit.
+
+// Mark ISRs. No nesting, so leaving always goes back to the main loop.
+#define WATCHDOG_ISR_ENTER(id) (watchdogRecord.isr = (id), watchdogRecord.isrCheck = (uint8_t)~(id))
+#define WATCHDOG_ISR_LEAVE() WATCHDOG_ISR_ENTER(WATCHDOG_ISR_NONE)
+
+
+// Functions. ******************************************************************
+void watchdogInit(void);			// First thing at start up. Takes over the record and clears MCUSR.
+void watchdogRecover(void);			// After printerInit(): restore the position.
+void watchdogStart(void);			// Right before the main loop.
+void watchdogService(void);			// Call every main loop pass.
+void watchdogNoteCommand(char *command);	// Command line about to run.
+void watchdogNoteOpcode(uint8_t opcode);	// Binary frame about to run.
+void watchdogReport(uint8_t channel);		// Send the record. 0: USB, 1: UART.
+void watchdogClear(void);			// Forget the record.
+void watchdogTimeout(void);			// Call from WDT_vect.
+void watchdogFatal(uint8_t isr);		// Save the record and reset. Does not return.
+
+#endif // WATCHDOG_H
@@ -17,6 +17,13 @@
 #include "lib/menu.h"
 #include "lib/printerFunctions.h"
 #include "lib/printerCommands.h"
+#include "lib/motionQueue.h"
+#include "lib/printJob.h"
+#include "lib/exposure.h"
+#include "lib/telemetry.h"
+#include "lib/positionAudit.h"
+#include "lib/watchdog.h"
+#include "lib/scheduler.h"
 
 
 // *****************************************************************************
@@ -42,10 +49,11 @@ uint8_t menuIdleCount = 0;
 
 
 
-// Main loop timer stuff. ******************************************************
-volatile uint8_t timerFlag = 0;
-volatile uint16_t timerCount = 0;
-volatile uint16_t timerMilliSeconds = 100;	// ms
+// Scheduler tasks. ************************************************************
+void usbTask(void);
+void doneTask(void);
+void stepperIdleTask(void);
+void menuTask(void);
 
 
 // *****************************************************************************
@@ -73,12 +81,21 @@ int main(void)
 
 //	menuChanged();
 
+	// Register housekeeping tasks. ******************************************
+	schedulerAdd(SCHEDULER_TASK_USB, usbTask, SCHEDULER_PERIOD_USB);
+	schedulerAdd(SCHEDULER_TASK_DONE, doneTask, SCHEDULER_PERIOD_DONE);
+	schedulerAdd(SCHEDULER_TASK_TELEMETRY, telemetryService, 0);	// Off until the host asks.
+	schedulerAdd(SCHEDULER_TASK_STEPPER_IDLE, stepperIdleTask, SCHEDULER_PERIOD_STEPPER_IDLE);
+	schedulerAdd(SCHEDULER_TASK_MENU, menuTask, SCHEDULER_PERIOD_MENU);
+
 	// Enable interrupts. *****************************************************
 	sei();
 
 	
 	// Initialise printer. ****************************************************
 	printerInit();
+	// Back from a crash? Take over the position. See watchdog.h.
+	watchdogRecover();
 
 
 	// Show splash screen. ****************************************************
@@ -93,6 +110,9 @@ int main(void)
 	ledYellowOff();
 	ledGreenOff();
 
+	// Supervise the main loop from here on. *********************************
+	watchdogStart();
+
 
 
 	// ************************************************************************
@@ -100,34 +120,27 @@ int main(void)
 	// ************************************************************************
 	while(1)
 	{
+		// Feed the watchdog, update the crash record.
+		watchdogService();
+
 		//**************************************************************
 		//************ Receive printer control commands. ***************
 		//**************************************************************
 		
 		// Receive and analyse incoming data. ******************
-		// Use echo -n "command" > /dev/ttyACM0	to send commands. -n option is important to suppress newline char at end of string.
+		// Use echo "command" > /dev/ttyACM0 to send commands. Lines end with \n or \r.
+		// Without terminator a command runs 10 ms after its last byte.
 		processCommandInput();
 				
 		//**************************************************************
-		//************* Update menu. ***********************************
+		//************* Run queued motion segments. ********************
 		//**************************************************************
-
-//		// Check inputs. ***********************************************
-//		menuButton = buttonCheck();
-//		menuMove = rotaryEncoderCheck();
-		// Reset menu idle counter on button press or encoder action.
-//		if (menuButton || menuMove)
-//		{
-//			menuIdleCount = 0;
-//		}
-				
-		
-		// Evaluate inputs and update menu accordingly. ****************
-//		menuEvaluateInput(menuButton, menuMove);
-		
-		// Draw menu. **************************************************
-//		menuDraw();
-
+		motionQueueService();
+		peelService();
+		homingService();
+		printJobService();
+		exposureService();
+		positionAuditService();
 
 
 		//**************************************************************
@@ -136,58 +149,16 @@ int main(void)
 
 		// Check for difference between current and set build platform position.
 		// Start stepper if difference detected.
-		buildPlatformComparePosition(buildPlatformSpeed);
+		buildPlatformComparePosition(buildPlatformFeedrate);
 //		beamerComparePosition(beamerSpeed);
 
-		
-		// Do things in intervals of timerMilliSeconds. ****************
-		if (timerFlag)
-		{	
-			// Reset timer flag.
-			timerFlag = 0;
-			
-			// Update LCD if stepper is running.
-			if (TCCR3B & (1 << CS30) || TCCR1B & (1 << CS10))
-			{
-//				menuChanged();
-			}
-
-			// Disable steppers if idle for more than 100 seconds or print has ended.
-			if ( !( (TCCR1B & (1 << CS10)) || (TCCR3B & (1 << CS30)) || (TCCR4B & (1 << CS43 | 1 << CS40)) ) )
-			{
-				if (++stepperIdleCount == 1000 && !(printerGetState()))
-				{
-					stepperIdleCount = 0;
-					disableSteppers();	// Dont do this to avoid loosing steps. Do this on purpose only and not during prints.
-//					tiltDisableStepper();	// That's OK, loosing steps in tilt is not that much of a problem.
-				}
-			}
-			
-			
-			// Jump back to home screen if idle for more than 20 seconds.
-//			if (++menuIdleCount == 200)
-//			{
-//				menuIdleCount = 0;
-//				menuGoInfoScreen();
-//			}
-			
-			
-			// Send data. **************************************************
-			// Operation finished?
-			if(printerReady())
-			{
-				_delay_ms(100);
-				if (!(getUartFlag())) sendStringUSB("done\n");	// Important: don't forget newline character.
-				else	sendStringUART("done\n");
-			}
-
-		} // timerFlag.
-		
-
-		// Take care of usb connection. **************************************
-		manageUSB(1);	// Paramter 1 if receiving function was used before, otherwise 0.
-
 
+		//**************************************************************
+		//************* Housekeeping. **********************************
+		//**************************************************************
+		// USB, "done", telemetry, idle steppers and menu, each in its own
+		// interval. See the tasks below.
+		schedulerRun();
 
 
 	} // Main while loop.
@@ -196,28 +167,101 @@ int main(void)
 }
 
 
+
+// *****************************************************************************
+// Scheduler tasks. ************************************************************
+// *****************************************************************************
+
+// Take care of usb connection. Every ms. **************************************
+void usbTask(void)
+{
+	manageUSB(1);	// Paramter 1 if receiving function was used before, otherwise 0.
+}
+
+// Operation finished? Every ms, so "done" goes out right away. ****************
+void doneTask(void)
+{
+	if(printerReady())
+	{
+		if (!(getUartFlag())) sendStringUSB("done\n");	// Important: don't forget newline character.
+		else	sendStringUART("done\n");
+	}
+}
+
+// Disable steppers if idle for more than 100 seconds. Every 100 ms. ***********
+void stepperIdleTask(void)
+{
+	if ( !( stepGeneratorRunning(&buildStepper) || stepGeneratorRunning(&tiltStepper) || (TCCR4B & (1 << CS43 | 1 << CS40)) ) )
+	{
+		if (++stepperIdleCount == 1000 && !(printerGetState()))
+		{
+			stepperIdleCount = 0;
+			disableSteppers();	// Dont do this to avoid loosing steps. Do this on purpose only and not during prints.
+//			tiltDisableStepper();	// That's OK, loosing steps in tilt is not that much of a problem.
+		}
+	}
+}
+
+// Update menu. Every 100 ms. **************************************************
+void menuTask(void)
+{
+	// Check inputs. ***********************************************
+//	menuButton = buttonCheck();
+//	menuMove = rotaryEncoderCheck();
+	// Reset menu idle counter on button press or encoder action.
+//	if (menuButton || menuMove)
+//	{
+//		menuIdleCount = 0;
+//	}
+
+	// Evaluate inputs and update menu accordingly. ****************
+//	menuEvaluateInput(menuButton, menuMove);
+
+	// Update LCD if stepper is running.
+	if (stepGeneratorRunning(&tiltStepper) || stepGeneratorRunning(&buildStepper))
+	{
+//		menuChanged();
+	}
+
+	// Draw menu. **************************************************
+//	menuDraw();
+
+	// Jump back to home screen if idle for more than 20 seconds.
+//	if (++menuIdleCount == 200)
+//	{
+//		menuIdleCount = 0;
+//		menuGoInfoScreen();
+//	}
+}
+
+
 	
 	
 
 
 // *****************************************************************************
-// Compare interrupt subroutine. Runs every 10e-4 seconds. *********************
+// Compare interrupt subroutine. Runs every millisecond. ***********************
 // *****************************************************************************
 
 // Main loop CTC timer. ********************************************************
 ISR (TIMER0_COMPA_vect)
 {
-	// If timerCycles reached (e.g. 10 for one millisecond)
-	// set flag for main loop and reset counter.
-	if(timerCount == timerMilliSeconds*10)
-	{
-		timerFlag = 1;
-		timerCount = 0;
-	}
-	else
-	{
-		timerCount++;
-	}	
+	ISR_PROFILE_BEGIN(PROFILEOTHERPIN);
+	WATCHDOG_ISR_ENTER(WATCHDOG_ISR_TICK);
+	// Scheduler tick. The tasks run in the main loop.
+	schedulerTick();
+	// Count down dwell time of queued motion segments.
+	motionQueueTick();
+	// Count down settle time of the print job.
+	printJobTick();
+	// Count whole ms of the exposure.
+	exposureTick();
+	// Count idle time of incoming command lines.
+	commandInputTick();
+	// End camera pulses.
+	cameraTick();
+	WATCHDOG_ISR_LEAVE();
+	ISR_PROFILE_END(PROFILEOTHERPIN);
 }
 
 
@@ -225,16 +269,16 @@ ISR (TIMER0_COMPA_vect)
 // Build platform stepper CTC timer. ***************************************************
 ISR (TIMER1_COMPA_vect)
 {
+	ISR_PROFILE_BEGIN(PROFILEBUILDPIN);
+	WATCHDOG_ISR_ENTER(WATCHDOG_ISR_BUILD);
 	// Count on rising edge only.
 	if (BUILDCLOCKPOLL & (1 << BUILDCLOCKPIN))// && BUILDENABLEPORT & (1 << BUILDENABLEPIN))
 	{
-
-//		if (!buildPlatformHomingFlag)
-//		{
-			// Count steps, compare current to target position etc.
-			buildPlatformControl();
-//		}
+		// Count step, ramp, load next compare value.
+		stepGeneratorTick(&buildStepper);
 	}
+	WATCHDOG_ISR_LEAVE();
+	ISR_PROFILE_END(PROFILEBUILDPIN);
 }
 
 
@@ -242,28 +286,43 @@ ISR (TIMER1_COMPA_vect)
 // Tilt stepper CTC timer. *******************************************
 ISR (TIMER3_COMPA_vect)
 {
+	ISR_PROFILE_BEGIN(PROFILETILTPIN);
+	WATCHDOG_ISR_ENTER(WATCHDOG_ISR_TILT);
 	// Count on rising edge only.
 	if (TILTCLOCKPOLL & (1 << TILTCLOCKPIN))
 	{
 		// Control tilt.
-		tiltControl();
+		stepGeneratorTick(&tiltStepper);
 	}
+	WATCHDOG_ISR_LEAVE();
+	ISR_PROFILE_END(PROFILETILTPIN);
 }
 
 
 
-// Tilt stepper CTC timer. *****************************************************
-// Compare match interrupt.
-ISR (TIMER4_COMPD_vect)
+// Exposure timer. *************************************************************
+// Timer 0 channel B, armed in the last ms of an exposure only.
+ISR (TIMER0_COMPB_vect)
 {
-	// Reset servo signal pin on compare match.
-	SERVOPORT &= ~(1 << SERVOPIN);
+	ISR_PROFILE_BEGIN(PROFILEOTHERPIN);
+	WATCHDOG_ISR_ENTER(WATCHDOG_ISR_EXPOSURE);
+	exposureCompare();
+	WATCHDOG_ISR_LEAVE();
+	ISR_PROFILE_END(PROFILEOTHERPIN);
 }
-// Timer overflow interrupt.
+
+
+
+// Servo PWM timer. ************************************************************
+// Timer overflow interrupt. Only enabled while the servo slews.
 ISR (TIMER4_OVF_vect)
 {
-	// Skip a couple of timer cycles and then set servo pin high.
+	ISR_PROFILE_BEGIN(PROFILEOTHERPIN);
+	WATCHDOG_ISR_ENTER(WATCHDOG_ISR_SERVO);
+	// Move servo pulse width towards the target.
 	servoControl();
+	WATCHDOG_ISR_LEAVE();
+	ISR_PROFILE_END(PROFILEOTHERPIN);
 }
 
 
@@ -271,35 +330,46 @@ ISR (TIMER4_OVF_vect)
 // Limit switch build platform top. ********************************************
 ISR (INT1_vect)
 {
+	ISR_PROFILE_BEGIN(PROFILEOTHERPIN);
+	WATCHDOG_ISR_ENTER(WATCHDOG_ISR_BUILD_TOP);
 	ledYellowOff();
 	// Disable build platform clock timer.
 	buildPlatformDisableStepper();
 //	TCCR1B &= ~(1 << CS10);		// Deactivate timer by disabling clock source.
 	// Lock position.
-	buildPlatformTargetPosition = buildPlatformPosition;
+	positionAuditSwitch(POSITION_AUDIT_TOP, buildStepper.position);
+	buildPlatformLockPosition();
 //	menuValueSet(buildPlatformTargetPosition,20);			// TO DO: put this into set function for buildPlatformTargetPosition!
 //	menuChanged();
+	WATCHDOG_ISR_LEAVE();
+	ISR_PROFILE_END(PROFILEOTHERPIN);
 }
 
 // Limit switch build platform bottom. *****************************************
 ISR (INT0_vect)
 {
+	ISR_PROFILE_BEGIN(PROFILEOTHERPIN);
+	WATCHDOG_ISR_ENTER(WATCHDOG_ISR_BUILD_BOTTOM);
 
 	ledGreenOff();
 	// Disable build platform clock timer.
 	buildPlatformStopStepper();
 //	TCCR1B &= ~(1 << CS10);		// Deactivate timer by disabling clock source.
-	// Reset flags and position.
-	buildPlatformHomingFlag = 0;
+	// Reset position. Homing picks up from here in the main loop.
+	positionAuditSwitch(POSITION_AUDIT_BOTTOM, buildStepper.position);
+	buildStepper.position = 0;
 	buildPlatformPosition = 0;
 //	sendByteAsStringUSB(buildPlatformPosition);
 //	menuChanged();
-	// GO UP A BIT AND THEN DOWN AT LOWEST SPEED TO INCREASE HOMING PRECISION!
+	WATCHDOG_ISR_LEAVE();
+	ISR_PROFILE_END(PROFILEOTHERPIN);
 }
 
 // Limit switch tilt.
 ISR (INT6_vect)
 {
+	ISR_PROFILE_BEGIN(PROFILEOTHERPIN);
+	WATCHDOG_ISR_ENTER(WATCHDOG_ISR_TILT_SWITCH);
 	ledGreenOff();
 	if (tiltStepperRunning() && !(tiltStepperGetDirection()))
 	{
@@ -307,17 +377,22 @@ ISR (INT6_vect)
 		// Set forward direction for next run.
 		tiltStepperSetForward();
 	}
+	WATCHDOG_ISR_LEAVE();
+	ISR_PROFILE_END(PROFILEOTHERPIN);
 }	
 
-// Catch any unexpected interrupts and flash LED.
+// Main loop hangs. Save the crash record, the next timeout resets. **********
+ISR (WDT_vect)
+{
+	watchdogTimeout();
+}
+
+// Catch any unexpected interrupts. Save the crash record and reset.
 ISR (BADISR_vect)
 {
-	while(1)
-	{
-		ledYellowToggle();
-		ledGreenToggle();
-		_delay_ms(50);
-	}
+	ledYellowOn();
+	ledGreenOn();
+	watchdogFatal(WATCHDOG_ISR_BAD);
 }
 
 //********************************** EOF *************************************//
@@ -0,0 +1,26 @@
+// Simulated EEPROM for the host build. ****************************************
+// Backed by a RAM array in sim.c, erased (0xFF) on start.
+
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EEMEM __attribute__((section("simEeprom")))
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+uint16_t eeprom_read_word(const uint16_t *address);
+uint32_t eeprom_read_dword(const uint32_t *address);
+void eeprom_read_block(void *destination, const void *source, size_t length);
+void eeprom_write_byte(uint8_t *address, uint8_t value);
+void eeprom_write_word(uint16_t *address, uint16_t value);
+void eeprom_write_dword(uint32_t *address, uint32_t value);
+void eeprom_write_block(const void *source, void *destination, size_t length);
+#define eeprom_update_byte eeprom_write_byte
+#define eeprom_update_word eeprom_write_word
+#define eeprom_update_dword eeprom_write_dword
+#define eeprom_update_block eeprom_write_block
+#define eeprom_busy_wait()
+
+#endif // SIM_AVR_EEPROM_H
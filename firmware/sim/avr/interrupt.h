@@ -0,0 +1,15 @@
+// Simulated interrupt handling for the host build. ****************************
+// An ISR is an ordinary function named after its vector. The simulator calls
+// it when the interrupt is due, enabled and the I bit in SREG is set.
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void)
+#define ISR_NOBLOCK
+#define sei() (SREG |= (1 << SREG_I))
+#define cli() (SREG &= ~(1 << SREG_I))
+
+#endif // SIM_AVR_INTERRUPT_H
@@ -0,0 +1,178 @@
+// Simulated ATmega32U4 register file for the host build. **********************
+// Registers are plain variables defined in sim.c. Firmware code reads and
+// writes them as usual, the simulator evaluates them when time advances.
+// Only the registers and bits the firmware uses are present. Bit numbers
+// match the data sheet.
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+// sim.c defines these before including this file to create the storage.
+#ifndef SIM_REGISTER8
+#define SIM_REGISTER8(name) extern volatile uint8_t name;
+#define SIM_REGISTER16(name) extern volatile uint16_t name;
+#endif
+
+// Ports. **********************************************************************
+SIM_REGISTER8(PORTB) SIM_REGISTER8(DDRB) SIM_REGISTER8(PINB)
+SIM_REGISTER8(PORTC) SIM_REGISTER8(DDRC) SIM_REGISTER8(PINC)
+SIM_REGISTER8(PORTD) SIM_REGISTER8(DDRD) SIM_REGISTER8(PIND)
+SIM_REGISTER8(PORTE) SIM_REGISTER8(DDRE) SIM_REGISTER8(PINE)
+SIM_REGISTER8(PORTF) SIM_REGISTER8(DDRF) SIM_REGISTER8(PINF)
+
+#define PIN0 0
+#define PIN1 1
+#define PIN2 2
+#define PIN3 3
+#define PIN4 4
+#define PIN5 5
+#define PIN6 6
+#define PIN7 7
+
+// Status and reset. ***********************************************************
+SIM_REGISTER8(SREG)
+SIM_REGISTER8(MCUSR)
+SIM_REGISTER8(WDTCSR)
+SIM_REGISTER8(USBCON)
+
+#define SREG_I 7
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define JTRF 4
+#define WDIE 6
+#define OTGPADE 4
+
+// External interrupts. ********************************************************
+SIM_REGISTER8(EICRA) SIM_REGISTER8(EICRB) SIM_REGISTER8(EIMSK) SIM_REGISTER8(EIFR)
+
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define ISC20 4
+#define ISC21 5
+#define ISC30 6
+#define ISC31 7
+#define ISC60 4
+#define ISC61 5
+#define INT0 0
+#define INT1 1
+#define INT2 2
+#define INT3 3
+#define INT6 6
+#define INTF0 0
+#define INTF1 1
+#define INTF6 6
+
+// Timer 0, 8 bit. *************************************************************
+SIM_REGISTER8(TCCR0A) SIM_REGISTER8(TCCR0B) SIM_REGISTER8(TCNT0)
+SIM_REGISTER8(OCR0A) SIM_REGISTER8(OCR0B) SIM_REGISTER8(TIMSK0) SIM_REGISTER8(TIFR0)
+
+#define WGM00 0
+#define WGM01 1
+#define COM0A0 6
+#define COM0A1 7
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM02 3
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+#define TOV0 0
+#define OCF0A 1
+#define OCF0B 2
+
+// Timer 1 and 3, 16 bit. ******************************************************
+SIM_REGISTER8(TCCR1A) SIM_REGISTER8(TCCR1B) SIM_REGISTER8(TCCR1C) SIM_REGISTER16(TCNT1)
+SIM_REGISTER16(OCR1A) SIM_REGISTER16(OCR1B) SIM_REGISTER16(OCR1C) SIM_REGISTER16(ICR1)
+SIM_REGISTER8(TIMSK1) SIM_REGISTER8(TIFR1)
+SIM_REGISTER8(TCCR3A) SIM_REGISTER8(TCCR3B) SIM_REGISTER8(TCCR3C) SIM_REGISTER16(TCNT3)
+SIM_REGISTER16(OCR3A) SIM_REGISTER16(OCR3B) SIM_REGISTER16(OCR3C) SIM_REGISTER16(ICR3)
+SIM_REGISTER8(TIMSK3) SIM_REGISTER8(TIFR3)
+
+#define WGM10 0
+#define WGM11 1
+#define COM1C0 2
+#define COM1C1 3
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define FOC1A 7
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCIE1C 3
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define OCF1C 3
+
+#define WGM30 0
+#define WGM31 1
+#define COM3A0 6
+#define COM3A1 7
+#define CS30 0
+#define CS31 1
+#define CS32 2
+#define WGM32 3
+#define WGM33 4
+#define FOC3A 7
+#define TOIE3 0
+#define OCIE3A 1
+#define TOV3 0
+#define OCF3A 1
+
+// Timer 4, high speed. 10 bit. ***********************************************
+// Counter, top and compare D hold all 10 bits. The firmware writes TC4H
+// before the low byte, so assigning the full value keeps them right.
+SIM_REGISTER8(TCCR4A) SIM_REGISTER8(TCCR4B) SIM_REGISTER8(TCCR4C) SIM_REGISTER8(TCCR4D) SIM_REGISTER8(TCCR4E)
+SIM_REGISTER16(TCNT4) SIM_REGISTER8(TC4H)
+SIM_REGISTER8(OCR4A) SIM_REGISTER8(OCR4B) SIM_REGISTER16(OCR4C) SIM_REGISTER16(OCR4D)
+SIM_REGISTER8(TIMSK4) SIM_REGISTER8(TIFR4)
+
+#define PWM4B 0
+#define PWM4A 1
+#define COM4A0 6
+#define COM4A1 7
+#define CS40 0
+#define CS41 1
+#define CS42 2
+#define CS43 3
+#define PSR4 6
+#define PWM4D 0
+#define COM4D0 2
+#define COM4D1 3
+#define WGM40 0
+#define WGM41 1
+#define TOIE4 2
+#define OCIE4B 5
+#define OCIE4A 6
+#define OCIE4D 7
+#define TOV4 2
+#define OCF4B 5
+#define OCF4A 6
+#define OCF4D 7
+
+// General timer control. ******************************************************
+SIM_REGISTER8(GTCCR)
+
+#define PSRSYNC 0
+#define PSRASY 1
+#define TSM 7
+
+// Memory. *********************************************************************
+#define RAMEND 0x0AFF
+#define E2END 0x03FF
+
+#endif // SIM_AVR_IO_H
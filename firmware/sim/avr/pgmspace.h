@@ -0,0 +1,20 @@
+// Simulated program memory for the host build. ********************************
+// Flash and RAM share one address space on the host.
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#define pgm_read_dword(address) (*(const uint32_t*)(address))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strcmp_P strcmp
+#define strlen_P strlen
+
+#endif // SIM_AVR_PGMSPACE_H
@@ -0,0 +1,9 @@
+// Simulated clock prescaler for the host build. *******************************
+
+#ifndef SIM_AVR_POWER_H
+#define SIM_AVR_POWER_H
+
+#define clock_div_1 0
+#define clock_prescale_set(division)
+
+#endif // SIM_AVR_POWER_H
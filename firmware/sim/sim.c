@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Create the register storage.
+#define SIM_REGISTER8(name) volatile uint8_t name;
+#define SIM_REGISTER16(name) volatile uint16_t name;
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/delay.h>
+#include "../hardware.h"
+#include "sim.h"
+
+
+// *****************************************************************************
+// Simulation variables. *******************************************************
+// *****************************************************************************
+uint64_t simCycles = 0;
+uint32_t simLoopCycles = SIM_LOOP_CYCLES;
+uint8_t simTrace = 0;
+uint64_t simTimeLimit = (uint64_t)SIM_TIME_LIMIT * SIM_CYCLES_PER_MS;
+uint64_t simNextFrame = SIM_CYCLES_PER_MS;	// Next USB frame.
+uint32_t simIdleTime = 0;			// ms without stepper clock or USB traffic.
+
+// Firmware entry point, renamed from main.
+int firmwareMain(void);
+
+
+// *****************************************************************************
+// Interrupt vectors. **********************************************************
+// *****************************************************************************
+// Weak, so firmware without one of the ISRs still links. Like on the chip,
+// an enabled interrupt without ISR ends up in BADISR_vect.
+void INT0_vect(void) __attribute__((weak));
+void INT1_vect(void) __attribute__((weak));
+void INT6_vect(void) __attribute__((weak));
+void TIMER0_COMPA_vect(void) __attribute__((weak));
+void TIMER0_COMPB_vect(void) __attribute__((weak));
+void TIMER1_COMPA_vect(void) __attribute__((weak));
+void TIMER3_COMPA_vect(void) __attribute__((weak));
+void TIMER4_COMPD_vect(void) __attribute__((weak));
+void TIMER4_OVF_vect(void) __attribute__((weak));
+void BADISR_vect(void) __attribute__((weak));
+
+typedef struct
+{
+	const char *name;
+	volatile uint8_t *flags;
+	volatile uint8_t *mask;
+	uint8_t bit;
+	void (*handler)(void);
+	uint32_t count;
+} simVector_t;
+
+// In order of priority.
+simVector_t simVectors[] =
+{
+	{ "INT0",		&EIFR,	&EIMSK,		INTF0,	INT0_vect,		0 },
+	{ "INT1",		&EIFR,	&EIMSK,		INTF1,	INT1_vect,		0 },
+	{ "INT6",		&EIFR,	&EIMSK,		INTF6,	INT6_vect,		0 },
+	{ "TIMER1_COMPA",	&TIFR1,	&TIMSK1,	OCF1A,	TIMER1_COMPA_vect,	0 },
+	{ "TIMER0_COMPA",	&TIFR0,	&TIMSK0,	OCF0A,	TIMER0_COMPA_vect,	0 },
+	{ "TIMER0_COMPB",	&TIFR0,	&TIMSK0,	OCF0B,	TIMER0_COMPB_vect,	0 },
+	{ "TIMER3_COMPA",	&TIFR3,	&TIMSK3,	OCF3A,	TIMER3_COMPA_vect,	0 },
+	{ "TIMER4_COMPD",	&TIFR4,	&TIMSK4,	OCF4D,	TIMER4_COMPD_vect,	0 },
+	{ "TIMER4_OVF",		&TIFR4,	&TIMSK4,	TOV4,	TIMER4_OVF_vect,	0 }
+};
+#define SIM_VECTOR_COUNT (sizeof(simVectors) / sizeof(simVectors[0]))
+
+// Run pending interrupts while the I bit is set. ******************************
+static void simDispatch(void)
+{
+	while (SREG & (1 << SREG_I))
+	{
+		simVector_t *vector = 0;
+		for (uint8_t i=0; i<SIM_VECTOR_COUNT; i++)
+		{
+			if (*simVectors[i].flags & *simVectors[i].mask & (1 << simVectors[i].bit))
+			{
+				vector = &simVectors[i];
+				break;
+			}
+		}
+		if (!vector) break;
+
+		// Hardware clears the flag and the I bit on entry, RETI sets the I bit.
+		*vector->flags &= ~(1 << vector->bit);
+		vector->count++;
+		cli();
+		if (vector->handler) vector->handler();
+		else if (BADISR_vect) BADISR_vect();
+		else
+		{
+			fprintf(stderr, "sim: no ISR for %s\n", vector->name);
+			simExit(2);
+		}
+		sei();
+	}
+}
+
+
+
+// *****************************************************************************
+// Mechanics and limit switches. ***********************************************
+// *****************************************************************************
+typedef struct
+{
+	const char *name;
+	int32_t position;		// Steps, switch side is 0.
+	uint32_t steps;			// Steps done.
+	uint64_t lastStep;		// Cycle of last step.
+	uint32_t minInterval;		// Shortest step interval in cycles.
+	uint32_t skip;			// Lose every skip-th step upwards, 0: none.
+} simAxis_t;
+
+simAxis_t simBuild = { "build", 20000, 0, 0, 0, 0 };	// 10 mm above the bottom switch.
+simAxis_t simTilt = { "tilt", 0, 0, 0, 0, 0 };		// Resting on the switch.
+int32_t simBuildTop = 300000;				// Top switch, 150 mm.
+
+// Set an input pin and flag its external interrupt on a matching edge. ******
+static void simSetInput(volatile uint8_t *pins, uint8_t pin, uint8_t level, uint8_t interrupt, const char *name)
+{
+	if (((*pins >> pin) & 1) == level) return;
+	if (level) *pins |= (1 << pin);
+	else *pins &= ~(1 << pin);
+
+	// Sense control: 0 low level (not simulated), 1 any edge, 2 falling, 3 rising.
+	uint8_t sense;
+	if (interrupt < 4) sense = (EICRA >> (2 * interrupt)) & 3;
+	else sense = (EICRB >> (2 * (interrupt - 4))) & 3;
+	if (sense == 1 || (sense == 2 && !level) || (sense == 3 && level)) EIFR |= (1 << interrupt);
+
+	char text[40];
+	snprintf(text, sizeof(text), "%s switch %s", name, level ? "closed" : "open");
+	simPrint("sim", text);
+}
+
+static void simUpdateSwitches(void)
+{
+	simSetInput(&LIMITBUILDBOTTOMPOLL, LIMITBUILDBOTTOMPIN, simBuild.position <= 0, INT0, "build bottom");
+	simSetInput(&LIMITBUILDTOPPOLL, LIMITBUILDTOPPIN, simBuild.position >= simBuildTop, INT1, "build top");
+	simSetInput(&LIMITTILTPOLL, LIMITTILTPIN, simTilt.position <= 0, INT6, "tilt");
+}
+
+// Step an axis if its driver is enabled. **************************************
+static void simStep(simAxis_t *axis, uint8_t enabled, int8_t direction)
+{
+	if (!enabled) return;
+	// Stalled motor lifting the load: the pulse comes, the axis does not move.
+	if (!(axis->skip && direction > 0 && (axis->steps + 1) % axis->skip == 0)) axis->position += direction;
+	if (axis->steps && (!axis->minInterval || simCycles - axis->lastStep < axis->minInterval))
+	{
+		axis->minInterval = simCycles - axis->lastStep;
+	}
+	axis->lastStep = simCycles;
+	axis->steps++;
+	if (simTrace) printf("[%10.4f] step: %s %d\n", simMilliSeconds(), axis->name, axis->position);
+}
+
+
+
+// *****************************************************************************
+// Timers. *********************************************************************
+// *****************************************************************************
+// Timers 0, 1 and 3 run in CTC mode: count up to the compare value, clear and
+// set the compare flag. A compare value below the counter lets the counter
+// run through the full range first, like on the chip.
+// Timer 4 counts up to OCR4C with compare D on the way. In PWM mode OC4D,
+// the servo pin, is set at the start of the frame and cleared on compare.
+static const uint16_t simPrescalers[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+
+typedef struct
+{
+	uint32_t phase;			// Cycles since the last count.
+	uint8_t output;			// Level of OCnA.
+} simTimer_t;
+
+simTimer_t simTimer0, simTimer1, simTimer3, simTimer4;
+
+// Cycles until the counter reaches top and clears. 0: stopped. *************
+static uint64_t simTimerDue(simTimer_t *timer, uint32_t prescaler, uint32_t counter, uint32_t top, uint32_t mask)
+{
+	if (!prescaler) return 0;
+	uint64_t ticks = ((top - counter) & mask) + 1;
+	return ticks * prescaler - timer->phase;
+}
+
+// Count elapsed cycles, returns the number of counter ticks. ***************
+static uint32_t simTimerCount(simTimer_t *timer, uint32_t prescaler, uint64_t elapsed)
+{
+	if (!prescaler) return 0;
+	uint64_t phase = timer->phase + elapsed;
+	timer->phase = phase % prescaler;
+	return phase / prescaler;
+}
+
+static uint32_t simTimer4Prescaler(void)
+{
+	uint8_t select = TCCR4B & 0x0F;
+	return select ? (1UL << (select - 1)) : 0;
+}
+
+// Servo pin. Prints the pulse width whenever it changes. *******************
+uint64_t simServoRise = 0;			// Cycle of the rising edge, 0: low.
+uint32_t simServoPulse = 0;			// Last pulse width in us.
+
+static void simServoOutput(uint8_t level)
+{
+	if (!(TCCR4C & (1 << PWM4D)) || ((TCCR4C >> COM4D0) & 3) != 2) return;
+	if (level)
+	{
+		simServoRise = simCycles;
+		return;
+	}
+	if (!simServoRise) return;
+	uint32_t pulse = (simCycles - simServoRise) / (SIM_CYCLES_PER_MS / 1000);
+	simServoRise = 0;
+	if (pulse == simServoPulse) return;
+	simServoPulse = pulse;
+	char text[40];
+	snprintf(text, sizeof(text), "servo pulse %u us", pulse);
+	simPrint("sim", text);
+}
+
+static uint64_t simEarliest(uint64_t current, uint64_t due)
+{
+	return (due && due < current) ? due : current;
+}
+
+// Camera pin. Prints every change. *****************************************
+uint8_t simCameraLevel = 0;
+
+static void simCameraOutput(void)
+{
+	uint8_t level = (CAMPORT & (1 << CAMPIN)) ? 1 : 0;
+	if (level == simCameraLevel) return;
+	simCameraLevel = level;
+	simPrint("sim", level ? "camera pin high" : "camera pin low");
+}
+
+// Run a 16 bit stepper timer and its clock pin. ******************************
+static void simTimer16Run(simTimer_t *timer, volatile uint8_t *controlA, volatile uint8_t *controlB,
+	volatile uint16_t *counter, volatile uint16_t *compare, volatile uint8_t *flags,
+	volatile uint8_t *pins, uint8_t pin, uint8_t outputMode, uint64_t elapsed, uint8_t isBuild)
+{
+	uint32_t prescaler = simPrescalers[*controlB & 0x07];
+	uint64_t due = simTimerDue(timer, prescaler, *counter, *compare, 0xFFFF);
+	uint32_t ticks = simTimerCount(timer, prescaler, elapsed);
+	if (!ticks) return;
+	if (elapsed < due)
+	{
+		*counter += ticks;
+		return;
+	}
+
+	// Compare match.
+	*counter = 0;
+	*flags |= (1 << OCF1A);
+	// Toggle OCnA if connected (COMnA1:0 = 01).
+	if (((*controlA >> outputMode) & 3) != 1) return;
+	timer->output ^= 1;
+	if (timer->output) *pins |= (1 << pin);
+	else *pins &= ~(1 << pin);
+	if (!timer->output) return;
+
+	// Rising edge: step.
+	if (isBuild) simStep(&simBuild, BUILDENABLEPORT & (1 << BUILDENABLEPIN), (BUILDDIRPORT & (1 << BUILDDIRPIN)) ? -1 : 1);
+	else simStep(&simTilt, TILTENABLEPORT & (1 << TILTENABLEPIN), (TILTDIRPORT & (1 << TILTDIRPIN)) ? -1 : 1);
+}
+
+
+
+// *****************************************************************************
+// Advance simulated time. *****************************************************
+// *****************************************************************************
+void simAdvance(uint32_t cycles)
+{
+	uint64_t end = simCycles + cycles;
+	while (simCycles < end)
+	{
+		// Step to the next event.
+		uint64_t elapsed = end - simCycles;
+		uint32_t prescaler0 = simPrescalers[TCCR0B & 0x07];
+		uint32_t top0 = (TCCR0A & (1 << WGM01)) ? OCR0A : 0xFF;
+		uint32_t prescaler1 = simPrescalers[TCCR1B & 0x07];
+		uint32_t prescaler3 = simPrescalers[TCCR3B & 0x07];
+		uint32_t prescaler4 = simTimer4Prescaler();
+		uint64_t due0Compare = (OCR0B <= top0) ? simTimerDue(&simTimer0, prescaler0, TCNT0, OCR0B, 0xFF) : 0;
+		elapsed = simEarliest(elapsed, simTimerDue(&simTimer0, prescaler0, TCNT0, top0, 0xFF));
+		elapsed = simEarliest(elapsed, due0Compare);
+		elapsed = simEarliest(elapsed, simTimerDue(&simTimer1, prescaler1, TCNT1, OCR1A, 0xFFFF));
+		elapsed = simEarliest(elapsed, simTimerDue(&simTimer3, prescaler3, TCNT3, OCR3A, 0xFFFF));
+		uint64_t due4Overflow = simTimerDue(&simTimer4, prescaler4, TCNT4, OCR4C, 0x3FF);
+		uint64_t due4Compare = (OCR4D <= OCR4C) ? simTimerDue(&simTimer4, prescaler4, TCNT4, OCR4D, 0x3FF) : 0;
+		elapsed = simEarliest(elapsed, due4Overflow);
+		elapsed = simEarliest(elapsed, due4Compare);
+		elapsed = simEarliest(elapsed, simNextFrame - simCycles);
+		simCycles += elapsed;
+
+		// Timer 0.
+		uint64_t due0 = simTimerDue(&simTimer0, prescaler0, TCNT0, top0, 0xFF);
+		uint32_t ticks = simTimerCount(&simTimer0, prescaler0, elapsed);
+		if (ticks && due0Compare && elapsed >= due0Compare) TIFR0 |= (1 << OCF0B);
+		if (ticks && elapsed >= due0)
+		{
+			TCNT0 = 0;
+			TIFR0 |= (TCCR0A & (1 << WGM01)) ? (1 << OCF0A) : (1 << TOV0);
+		}
+		else TCNT0 += ticks;
+
+		// Stepper timers.
+		simTimer16Run(&simTimer1, &TCCR1A, &TCCR1B, &TCNT1, &OCR1A, &TIFR1, &BUILDCLOCKPOLL, BUILDCLOCKPIN, COM1A0, elapsed, 1);
+		simTimer16Run(&simTimer3, &TCCR3A, &TCCR3B, &TCNT3, &OCR3A, &TIFR3, &TILTCLOCKPOLL, TILTCLOCKPIN, COM3A0, elapsed, 0);
+
+		// Timer 4.
+		ticks = simTimerCount(&simTimer4, prescaler4, elapsed);
+		if (ticks)
+		{
+			if (due4Compare && elapsed >= due4Compare)
+			{
+				TIFR4 |= (1 << OCF4D);
+				simServoOutput(0);
+			}
+			if (elapsed >= due4Overflow)
+			{
+				TCNT4 = 0;
+				TIFR4 |= (1 << TOV4);
+				simServoOutput(1);
+			}
+			else TCNT4 += ticks;
+		}
+
+		// USB frame, idle and time limit every ms.
+		if (simCycles >= simNextFrame)
+		{
+			simNextFrame += SIM_CYCLES_PER_MS;
+			simUsbFrame();
+			if (TCCR1B & 0x07 || TCCR3B & 0x07) simIdleTime = 0;
+			else if (simIdleTime < SIM_IDLE_TIME) simIdleTime++;
+			if (simCycles >= simTimeLimit)
+			{
+				simPrint("sim", "time limit reached");
+				simExit(1);
+			}
+		}
+
+		// The switches follow the step, after its ISR.
+		simDispatch();
+		simUpdateSwitches();
+		simDispatch();
+		simCameraOutput();
+	}
+}
+
+// One main loop pass. Ends the run between passes, so a command that is
+// running (e.g. busy waiting) always gets to finish.
+void simLoopPass(void)
+{
+	simAdvance(simLoopCycles);
+	if (simIdleTime >= SIM_IDLE_TIME && simUsbFinished()) simExit(0);
+}
+
+double simMilliSeconds(void)
+{
+	return (double)simCycles / SIM_CYCLES_PER_MS;
+}
+
+void simPrint(const char *source, const char *text)
+{
+	printf("[%10.4f] %s: %s\n", simMilliSeconds(), source, text);
+}
+
+void _delay_ms(double milliSeconds)
+{
+	simAdvance(milliSeconds * SIM_CYCLES_PER_MS);
+}
+
+void _delay_us(double microSeconds)
+{
+	uint32_t cycles = microSeconds * (SIM_CYCLES_PER_MS / 1000);
+	simAdvance(cycles ? cycles : 1);
+}
+
+
+
+// *****************************************************************************
+// EEPROM. *********************************************************************
+// *****************************************************************************
+// EEMEM variables live in their own section, their offset in it is the
+// EEPROM address. Plain numbers are taken as address as well.
+uint8_t simEeprom[E2END + 1];
+const char *simEepromFile = 0;
+extern char __start_simEeprom[] __attribute__((weak));
+extern char __stop_simEeprom[] __attribute__((weak));
+
+static uint16_t simEepromAddress(const void *address, size_t length)
+{
+	uintptr_t offset = (uintptr_t)address;
+	if (__start_simEeprom && (char*)address >= __start_simEeprom && (char*)address < __stop_simEeprom)
+	{
+		offset = (char*)address - __start_simEeprom;
+	}
+	if (offset + length > sizeof(simEeprom))
+	{
+		fprintf(stderr, "sim: EEPROM access out of range\n");
+		simExit(2);
+	}
+	return offset;
+}
+
+void eeprom_read_block(void *destination, const void *source, size_t length)
+{
+	memcpy(destination, &simEeprom[simEepromAddress(source, length)], length);
+}
+
+void eeprom_write_block(const void *source, void *destination, size_t length)
+{
+	memcpy(&simEeprom[simEepromAddress(destination, length)], source, length);
+	// About 3.4 ms per byte.
+	simAdvance(length * (SIM_CYCLES_PER_MS * 34 / 10));
+}
+
+uint8_t eeprom_read_byte(const uint8_t *address)		{ uint8_t value; eeprom_read_block(&value, address, 1); return value; }
+uint16_t eeprom_read_word(const uint16_t *address)		{ uint16_t value; eeprom_read_block(&value, address, 2); return value; }
+uint32_t eeprom_read_dword(const uint32_t *address)		{ uint32_t value; eeprom_read_block(&value, address, 4); return value; }
+void eeprom_write_byte(uint8_t *address, uint8_t value)		{ eeprom_write_block(&value, address, 1); }
+void eeprom_write_word(uint16_t *address, uint16_t value)	{ eeprom_write_block(&value, address, 2); }
+void eeprom_write_dword(uint32_t *address, uint32_t value)	{ eeprom_write_block(&value, address, 4); }
+
+
+
+// *****************************************************************************
+// avr-libc number conversion. *************************************************
+// *****************************************************************************
+char *ultoa(unsigned long value, char *string, int radix)
+{
+	char buffer[33];
+	uint8_t length = 0;
+	do
+	{
+		uint8_t digit = value % radix;
+		buffer[length++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+		value /= radix;
+	} while (value);
+	for (uint8_t i=0; i<length; i++) string[i] = buffer[length - 1 - i];
+	string[length] = '\0';
+	return string;
+}
+
+char *ltoa(long value, char *string, int radix)
+{
+	if (value < 0 && radix == 10)
+	{
+		string[0] = '-';
+		ultoa(-(unsigned long)value, string + 1, radix);
+		return string;
+	}
+	return ultoa(value, string, radix);
+}
+
+// 16 bit like on the chip.
+char *itoa(int value, char *string, int radix)		{ return ltoa((int16_t)value, string, radix); }
+char *utoa(unsigned int value, char *string, int radix)	{ return ultoa((uint16_t)value, string, radix); }
+
+
+
+// *****************************************************************************
+// Start and end. **************************************************************
+// *****************************************************************************
+static void simPrintAxis(simAxis_t *axis)
+{
+	printf("sim: %s at %d steps, %u steps done", axis->name, axis->position, axis->steps);
+	if (axis->minInterval) printf(", max %.0f steps/s", (double)F_CPU / axis->minInterval);
+	printf("\n");
+}
+
+void simExit(int code)
+{
+	fflush(stdout);
+	printf("sim: end at %.4f ms\n", simMilliSeconds());
+	simPrintAxis(&simBuild);
+	simPrintAxis(&simTilt);
+	printf("sim: interrupts");
+	for (uint8_t i=0; i<SIM_VECTOR_COUNT; i++) printf(" %s %u", simVectors[i].name, simVectors[i].count);
+	printf("\n");
+	simLcdPrint();
+
+	if (simEepromFile)
+	{
+		FILE *file = fopen(simEepromFile, "wb");
+		if (file)
+		{
+			fwrite(simEeprom, 1, sizeof(simEeprom), file);
+			fclose(file);
+		}
+	}
+	exit(code);
+}
+
+static void simUsage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options] [script]\n"
+		"Runs the firmware against simulated hardware. Script from stdin if omitted.\n"
+		"  -t <ms>     Time limit, default %d ms.\n"
+		"  -l <cycles> Cycles per main loop pass, default %d.\n"
+		"  -b <steps>  Build platform start position above the bottom switch.\n"
+		"  -T <steps>  Build platform top switch position.\n"
+		"  -s <n>      Build platform loses every n-th step upwards.\n"
+		"  -e <file>   Load EEPROM from file and save it on exit.\n"
+		"  -v          Print every step.\n",
+		name, SIM_TIME_LIMIT, SIM_LOOP_CYCLES);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "t:l:b:T:s:e:v")) != -1)
+	{
+		switch (option)
+		{
+			case 't': simTimeLimit = (uint64_t)atol(optarg) * SIM_CYCLES_PER_MS; break;
+			case 'l': simLoopCycles = atol(optarg); break;
+			case 'b': simBuild.position = atol(optarg); break;
+			case 'T': simBuildTop = atol(optarg); break;
+			case 's': simBuild.skip = atol(optarg); break;
+			case 'e': simEepromFile = optarg; break;
+			case 'v': simTrace = 1; break;
+			default: simUsage(argv[0]);
+		}
+	}
+
+	FILE *script = stdin;
+	if (optind < argc)
+	{
+		script = fopen(argv[optind], "r");
+		if (!script)
+		{
+			perror(argv[optind]);
+			return 2;
+		}
+	}
+	simUsbOpen(script);
+
+	// Erased EEPROM unless there is an image.
+	memset(simEeprom, 0xFF, sizeof(simEeprom));
+	if (simEepromFile)
+	{
+		FILE *file = fopen(simEepromFile, "rb");
+		if (file)
+		{
+			if (fread(simEeprom, 1, sizeof(simEeprom), file)) {}
+			fclose(file);
+		}
+	}
+
+	// Reset values.
+	OCR4C = 0xFF;
+	MCUSR = (1 << PORF);
+	simUpdateSwitches();
+	EIFR = 0;
+
+	return firmwareMain();
+}
@@ -0,0 +1,58 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// *****************************************************************************
+// Host simulation of the printer board. ***************************************
+// *****************************************************************************
+// The firmware is compiled for the host against the register file in
+// sim/avr/io.h. The simulator advances a cycle counter, runs timers 0, 1, 3
+// and 4 from their registers, toggles the stepper clock pins, moves a model
+// of build platform and tilt and drives the limit switch pins from it.
+// Interrupts are injected like on the chip: flag set on the event, ISR
+// called when enabled and the I bit in SREG is set.
+// Time advances in busy waits and once per main loop pass (schedulerRun).
+// Commands come from a script that is streamed in like from the host:
+//	<line>			Sent with "\n" appended.
+//	@hex a5 00 01 00 xx	Raw bytes, e.g. binary frames.
+//	@wait <ms>		Pause sending.
+//	@done			Pause until the printer sent "done".
+//	# ...			Comment.
+// Everything the firmware sends is printed with a time stamp in ms.
+// The run ends when the script is through and both steppers and USB have
+// been idle for SIM_IDLE_TIME ms.
+// Limits: int is 32 bit on the host, ISRs take no time and the menu tables
+// read pointers as 16 bit words, so the menu compiles but can't be navigated.
+
+// Variables. ******************************************************************
+#define SIM_CYCLES_PER_MS (F_CPU / 1000)
+#define SIM_IDLE_TIME 500			// ms.
+#define SIM_USB_PACKET 64			// Bytes per USB frame and direction.
+#define SIM_USB_BANKS 2
+#define SIM_LOOP_CYCLES 1600			// Default cost of a main loop pass.
+#define SIM_TIME_LIMIT 600000			// Default time limit in ms.
+
+extern uint64_t simCycles;			// Simulated time in CPU cycles.
+extern uint32_t simLoopCycles;			// Cost of one main loop pass.
+extern uint8_t simTrace;			// Print every step.
+extern uint32_t simIdleTime;			// ms without stepper clock or USB traffic.
+
+
+// Functions. ******************************************************************
+void simAdvance(uint32_t cycles);		// Run timers and interrupts.
+void simLoopPass(void);				// Called once per main loop pass.
+double simMilliSeconds(void);
+void simPrint(const char *source, const char *text);	// Print with time stamp.
+void simExit(int code);				// Print summary and leave.
+
+// USB host side (simUsb.c).
+void simUsbOpen(FILE *script);
+void simUsbFrame(void);				// Called every ms.
+uint8_t simUsbFinished(void);			// Script sent and read.
+
+// Display (simLcd.c).
+void simLcdPrint(void);				// Print display content if used.
+
+#endif // SIM_H
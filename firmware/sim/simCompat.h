@@ -0,0 +1,14 @@
+// avr-libc extensions the firmware relies on. *********************************
+// Included ahead of every source file of the host build.
+
+#ifndef SIMCOMPAT_H
+#define SIMCOMPAT_H
+
+#include <stdlib.h>
+
+char *itoa(int value, char *string, int radix);
+char *utoa(unsigned int value, char *string, int radix);
+char *ltoa(long value, char *string, int radix);
+char *ultoa(unsigned long value, char *string, int radix);
+
+#endif // SIMCOMPAT_H
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+
+#include "../lib/lcd.h"
+#include "sim.h"
+
+
+// *****************************************************************************
+// Display of the host build. **************************************************
+// *****************************************************************************
+// Replaces lib/lcd.c. Characters go into a text buffer that is printed at
+// the end of the run.
+
+char simLcdText[LCD_LINES][LCD_DISP_LENGTH + 1];
+uint8_t simLcdX = 0;
+uint8_t simLcdY = 0;
+uint8_t simLcdUsed = 0;
+
+void lcd_clrscr(void)
+{
+	memset(simLcdText, ' ', sizeof(simLcdText));
+	for (uint8_t i=0; i<LCD_LINES; i++) simLcdText[i][LCD_DISP_LENGTH] = '\0';
+	simLcdX = 0;
+	simLcdY = 0;
+}
+
+void lcd_init(uint8_t dispAttr)
+{
+	lcd_clrscr();
+}
+
+void lcdSaveCustomChars(const unsigned char *cg)
+{
+}
+
+void lcd_home(void)
+{
+	simLcdX = 0;
+	simLcdY = 0;
+}
+
+void lcd_gotoxy(uint8_t x, uint8_t y)
+{
+	simLcdX = x;
+	simLcdY = y;
+}
+
+void lcd_putc(char c)
+{
+	if (!simLcdUsed)
+	{
+		simLcdUsed = 1;
+		uint8_t x = simLcdX, y = simLcdY;
+		lcd_clrscr();
+		lcd_gotoxy(x, y);
+	}
+	if (c == '\n')
+	{
+		simLcdX = 0;
+		simLcdY = (simLcdY + 1) % LCD_LINES;
+		return;
+	}
+	if (simLcdX < LCD_DISP_LENGTH && simLcdY < LCD_LINES) simLcdText[simLcdY][simLcdX] = c;
+	simLcdX++;
+}
+
+void lcd_puts(const char *s)
+{
+	while (*s) lcd_putc(*s++);
+}
+
+void lcd_puts_p(const char *progmem_s)
+{
+	lcd_puts(progmem_s);
+}
+
+void lcd_command(uint8_t cmd)
+{
+}
+
+void lcd_data(uint8_t data)
+{
+	lcd_putc(data);
+}
+
+void simLcdPrint(void)
+{
+	if (!simLcdUsed) return;
+	for (uint8_t i=0; i<LCD_LINES; i++) printf("sim: lcd |%s|\n", simLcdText[i]);
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+
+#include "../lib/uart.h"
+#include "sim.h"
+
+
+// *****************************************************************************
+// UART of the host build. *****************************************************
+// *****************************************************************************
+// Replaces lib/uart.c for USART1. Nothing comes in, sent lines are printed.
+
+char simUartText[256];
+uint16_t simUartTextLength = 0;
+
+void uart1_init(unsigned int baudrate)
+{
+}
+
+unsigned int uart1_getc(void)
+{
+	return UART_NO_DATA;
+}
+
+void uart1_putc(unsigned char data)
+{
+	if (data == '\n' || simUartTextLength == sizeof(simUartText) - 1)
+	{
+		simUartText[simUartTextLength] = '\0';
+		simPrint("uart", simUartText);
+		simUartTextLength = 0;
+	}
+	else simUartText[simUartTextLength++] = data;
+}
+
+void uart1_puts(const char *s)
+{
+	while (*s) uart1_putc(*s++);
+}
+
+void uart1_putdata(const unsigned char *data, unsigned char length)
+{
+	for (uint8_t i=0; i<length; i++) uart1_putc(data[i]);
+}
+
+void uart1_puts_p(const char *s)
+{
+	uart1_puts(s);
+}
+
+int uart1_available(void)
+{
+	return 0;
+}
+
+void uart1_flush(void)
+{
+}
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+
+#include "../lib/virtualSerial.h"
+#include "../lib/binaryCommands.h"
+#include "../lib/telemetry.h"
+#include "sim.h"
+
+
+// *****************************************************************************
+// USB virtual serial port of the host build. **********************************
+// *****************************************************************************
+// Replaces lib/virtualSerial.c. The host side streams the script into the
+// receive buffer, at most one packet per frame and only as far as the
+// endpoint banks have room. Sent data is printed, text by line and binary
+// frames in hex.
+
+// Host side. ******************************************************************
+// Starts sending once the firmware runs its main loop, like a host that
+// opens the port after enumeration.
+FILE *simUsbScript = 0;
+uint8_t simUsbConnected = 0;
+uint8_t simUsbOpened = 0;			// Port opened, cleared when read.
+uint8_t simUsbLine[256];			// Script line being sent.
+uint16_t simUsbLineLength = 0;
+uint16_t simUsbLineIndex = 0;
+uint64_t simUsbWaitUntil = 0;			// @wait.
+uint8_t simUsbWaitDone = 0;			// @done.
+uint32_t simUsbDoneCount = 0;			// "done" lines received.
+uint32_t simUsbDoneMark = 0;			// Done count when last byte was sent.
+
+// Device receive buffer, the OUT endpoint banks.
+#define SIM_USB_RX_SIZE (SIM_USB_PACKET * SIM_USB_BANKS)
+uint8_t simUsbRx[SIM_USB_RX_SIZE];
+uint16_t simUsbRxHead = 0;
+uint16_t simUsbRxCount = 0;
+
+// Device transmit ring, see queueDataUSB().
+RING_BUFFER(static, usbTxRing, USB_TX_BUFFER_SIZE);
+uint16_t usbDropped = 0;
+uint8_t usbPeak = 0;
+uint16_t simUsbInBudget = SIM_USB_RX_SIZE;	// Bytes the IN endpoint takes this frame.
+
+// Printing.
+char simUsbText[256];				// Text line being received.
+uint16_t simUsbTextLength = 0;
+uint8_t simUsbFrameData[256];			// Binary frame being received.
+uint16_t simUsbFrameLength = 0;
+uint16_t simUsbFrameSize = 0;
+
+
+void simUsbOpen(FILE *script)
+{
+	simUsbScript = script;
+}
+
+// Read the next script line. Returns 0 while waiting or at the end. ***********
+static uint8_t simUsbNextLine(void)
+{
+	if (simUsbWaitUntil > simCycles) return 0;
+	if (simUsbWaitDone && simUsbDoneCount <= simUsbDoneMark) return 0;
+	simUsbWaitUntil = 0;
+	simUsbWaitDone = 0;
+
+	char line[256];
+	if (!simUsbScript || !fgets(line, sizeof(line) - 1, simUsbScript))
+	{
+		simUsbScript = 0;
+		return 0;
+	}
+	line[strcspn(line, "\r\n")] = '\0';
+	simUsbLineLength = 0;
+	simUsbLineIndex = 0;
+
+	if (line[0] == '#' || line[0] == '\0') return 1;
+	if (!strncmp(line, "@wait", 5))
+	{
+		simUsbWaitUntil = simCycles + (uint64_t)atol(line + 5) * SIM_CYCLES_PER_MS;
+	}
+	else if (!strcmp(line, "@done"))
+	{
+		simUsbWaitDone = 1;
+	}
+	else if (!strncmp(line, "@hex", 4))
+	{
+		char *position = line + 4;
+		char *next;
+		while (simUsbLineLength < sizeof(simUsbLine))
+		{
+			long value = strtol(position, &next, 16);
+			if (next == position) break;
+			simUsbLine[simUsbLineLength++] = value;
+			position = next;
+		}
+	}
+	else
+	{
+		simUsbLineLength = strlen(line);
+		memcpy(simUsbLine, line, simUsbLineLength);
+		simUsbLine[simUsbLineLength++] = '\n';
+	}
+	return 1;
+}
+
+// Host sends one packet per frame. ********************************************
+void simUsbFrame(void)
+{
+	simUsbInBudget = SIM_USB_RX_SIZE;
+	if (!simUsbConnected) return;
+	uint8_t packet = SIM_USB_PACKET;
+	while (packet && simUsbRxCount < SIM_USB_RX_SIZE)
+	{
+		if (simUsbLineIndex == simUsbLineLength)
+		{
+			if (!simUsbNextLine()) break;
+			continue;
+		}
+		simUsbRx[(simUsbRxHead + simUsbRxCount++) % SIM_USB_RX_SIZE] = simUsbLine[simUsbLineIndex++];
+		simUsbDoneMark = simUsbDoneCount;
+		simIdleTime = 0;
+		packet--;
+	}
+}
+
+uint8_t simUsbFinished(void)
+{
+	return !simUsbScript && simUsbLineIndex == simUsbLineLength && !simUsbRxCount && ringBufferEmpty(&usbTxRing);
+}
+
+// Print what the device sends. ************************************************
+static void simUsbPrintText(const char *data, uint16_t length)
+{
+	simIdleTime = 0;
+	for (uint16_t i=0; i<length; i++)
+	{
+		if (data[i] == '\n' || simUsbTextLength == sizeof(simUsbText) - 1)
+		{
+			simUsbText[simUsbTextLength] = '\0';
+			simPrint("usb", simUsbText);
+			if (!strcmp(simUsbText, "done")) simUsbDoneCount++;
+			simUsbTextLength = 0;
+		}
+		else simUsbText[simUsbTextLength++] = data[i];
+	}
+}
+
+static void simUsbPrintData(const uint8_t *data, uint16_t length)
+{
+	simIdleTime = 0;
+	char text[3 * 256 + 1];
+	uint16_t index = 0;
+	for (uint16_t i=0; i<length && i<256; i++) index += sprintf(text + index, "%02x ", data[i]);
+	if (index) text[index - 1] = '\0';
+	else text[0] = '\0';
+	simPrint("usb", text);
+}
+
+
+
+// Split what the device sends into text and binary frames. ******************
+// Frames start with the sync byte, which never shows up in text. Telemetry
+// frames carry their length, responses have five bytes.
+static void simUsbReceive(uint8_t byte)
+{
+	if (!simUsbFrameLength && byte != BINARY_SYNC)
+	{
+		simUsbPrintText((char*)&byte, 1);
+		return;
+	}
+	simUsbFrameData[simUsbFrameLength++] = byte;
+	if (simUsbFrameLength == 2) simUsbFrameSize = (byte == TELEMETRY_FRAME_TYPE) ? 0 : 5;
+	if (simUsbFrameLength == 4 && !simUsbFrameSize) simUsbFrameSize = byte + 5;
+	if (simUsbFrameLength == simUsbFrameSize)
+	{
+		simUsbPrintData(simUsbFrameData, simUsbFrameLength);
+		simUsbFrameLength = 0;
+	}
+}
+
+
+
+//****************************************************************************//
+//******************* Sending and receiving functions. ***********************//
+//****************************************************************************//
+uint16_t usbDroppedCount(void)
+{
+	return usbDropped;
+}
+
+uint8_t usbPeakFill(void)
+{
+	return usbPeak;
+}
+
+uint8_t queueDataUSB(uint8_t* data, uint16_t length)
+{
+	if (length > ringBufferFree(&usbTxRing)) drainUSB();
+	if (length > ringBufferFree(&usbTxRing))
+	{
+		usbDropped++;
+		return 0;
+	}
+	ringBufferWrite(&usbTxRing, data, length);
+	uint8_t used = ringBufferUsed(&usbTxRing);
+	if (used > usbPeak) usbPeak = used;
+	return 1;
+}
+
+uint8_t sendStringUSB(char* dataString)
+{
+	return queueDataUSB((uint8_t*)dataString, strlen(dataString));
+}
+
+void sendByteAsStringUSB(uint16_t dataByte)
+{
+	char dataString[7];
+	utoa(dataByte, dataString, 10);
+	uint8_t length = strlen(dataString);
+	dataString[length++] = '\n';
+	queueDataUSB((uint8_t*)dataString, length);
+}
+
+void sendByteUSB(uint8_t dataByte)
+{
+	queueDataUSB(&dataByte, 1);
+}
+
+uint8_t sendDataUSB(uint8_t* data, uint16_t length)
+{
+	return queueDataUSB(data, length);
+}
+
+// The IN endpoint takes simUsbInBudget bytes per frame.
+void drainUSB(void)
+{
+	uint8_t data;
+	while (simUsbInBudget && ringBufferGet(&usbTxRing, &data))
+	{
+		simUsbReceive(data);
+		simUsbInBudget--;
+	}
+}
+
+uint16_t bytesWaitingUSB(void)
+{
+	return simUsbRxCount;
+}
+
+uint16_t receiveByteUSB(void)
+{
+	if (!simUsbRxCount) return 0xFFFF;
+	uint8_t byte = simUsbRx[simUsbRxHead];
+	simUsbRxHead = (simUsbRxHead + 1) % SIM_USB_RX_SIZE;
+	simUsbRxCount--;
+	return byte;
+}
+
+char receiveCharUSB(void)
+{
+	return receiveByteUSB();
+}
+
+void receiveStringUSB (char* inputString, uint8_t stringSize)
+{
+	uint8_t charIndex = 0;
+	while(bytesWaitingUSB() && charIndex < stringSize-1)
+	{
+		inputString[charIndex] = receiveCharUSB();
+		charIndex++;
+	}
+	inputString[charIndex]='\0';
+}
+
+
+
+//****************************************************************************//
+//******************* USB management. Call in main loop. *********************//
+//****************************************************************************//
+// Time per main loop pass is advanced by schedulerRun().
+void manageUSB(uint8_t receiving)
+{
+	if(!receiving)
+	{
+		receiveByteUSB();
+	}
+	if (!simUsbConnected) simUsbOpened = 1;
+	simUsbConnected = 1;
+	drainUSB();
+}
+
+uint8_t usbPortOpened(void)
+{
+	uint8_t opened = simUsbOpened;
+	simUsbOpened = 0;
+	return opened;
+}
+
+void EVENT_USB_Device_Connect(void) {}
+void EVENT_USB_Device_Disconnect(void) {}
+void EVENT_USB_Device_ConfigurationChanged(void) {}
+void EVENT_USB_Device_ControlRequest(void) {}
@@ -0,0 +1,10 @@
+// Simulated busy waits for the host build. ************************************
+// Waiting advances simulated time, so interrupts keep coming in.
+
+#ifndef SIM_UTIL_DELAY_H
+#define SIM_UTIL_DELAY_H
+
+void _delay_ms(double milliSeconds);
+void _delay_us(double microSeconds);
+
+#endif // SIM_UTIL_DELAY_H
@@ -2704,6 +2704,11 @@ class dialogSettings(gtk.Window):
 		self.boxTilt.pack_start(self.entryTiltAngle, expand=False, fill=False)
 		self.entryTiltAngle.show()
 		self.entryTiltAngle.set_sensitive(self.settings['tiltEnable'].value)
+		# Peel offset.
+		self.entryPeelOffset = monkeyprintGuiHelper.entry('peelOffset', self.settings, width=15)
+		self.boxTilt.pack_start(self.entryPeelOffset, expand=False, fill=False)
+		self.entryPeelOffset.show()
+		self.entryPeelOffset.set_sensitive(self.settings['tiltEnable'].value)
 		# Set entry sensitivities.
 		self.setTiltSensitive()
 
@@ -2735,6 +2740,10 @@ class dialogSettings(gtk.Window):
 		self.entryBuildMmPerTurn = monkeyprintGuiHelper.entry('buildMmPerTurn', self.settings, width=15)
 		self.boxBuildStepper.pack_start(self.entryBuildMmPerTurn, expand=False, fill=False)
 		self.entryBuildMmPerTurn.show()
+		# Move speed of the monkeyprint board.
+		self.entryBuildFeedrate = monkeyprintGuiHelper.entry('buildFeedrate', self.settings, width=15)
+		self.boxBuildStepper.pack_start(self.entryBuildFeedrate, expand=False, fill=False)
+		self.entryBuildFeedrate.show()
 		# Ramp slope.
 		#self.entryBuildRampSlope = monkeyprintGuiHelper.entry('buildRampSlope', self.settings, width=15)
 		#self.boxBuildStepper.pack_start(self.entryBuildRampSlope, expand=False, fill=False)
@@ -2967,6 +2976,7 @@ class dialogSettings(gtk.Window):
 		self.entryTiltStepAngle.set_sensitive(self.settings['tiltEnable'].value)
 		self.entryTiltMicrostepping.set_sensitive(self.settings['tiltEnable'].value)
 		self.entryTiltAngle.set_sensitive(self.settings['tiltEnable'].value)
+		self.entryPeelOffset.set_sensitive(self.settings['tiltEnable'].value)
 	#	self.entryTiltGCode.set_sensitive(self.settings['tiltEnable'].value)
 	#	self.entryTiltDistanceGCode.set_sensitive(self.settings['tiltEnable'].value)
 
@@ -48,6 +48,11 @@ class printProcess(threading.Thread):
 		# Are we in debug mode?
 		self.debug = self.settings['debug'].value
 
+		# Status frames from the monkeyprint board during the print, ms.
+		self.telemetryPeriod = 1000
+		self.telemetryDropped = 0
+		self.telemetryDriftReported = False
+
 		# Initialise stop flag.
 		self.stopThread = threading.Event()
 
@@ -110,9 +115,16 @@ class printProcess(threading.Thread):
 
 
 		# Run loop commands for each slice. **********************************
-		print "Running loop commands. ****************************************"
+		# The monkeyprint board runs the whole loop as print job if it can.
+		job = self.compileJob(loopStartIndex)
+		if job != None:
+			print "Running loop as print job. ************************************"
+			self.runJob(job)
+			commandIndex = job['endIndex'] + 1
+		else:
+			print "Running loop commands. ****************************************"
 		# Loop through slices.
-		while self.slice < self.numberOfSlices and not self.stopThread.isSet():
+		while job == None and self.slice < self.numberOfSlices and not self.stopThread.isSet():
 			print "Printing slice " + str(self.slice) + " of " + str(self.numberOfSlices) + ". *********"
 			self.queueStatus.put("printing:nSlices:" + str(self.numberOfSlices))
 			self.queueStatus.put("printing:slice:" + str(self.slice))
@@ -129,6 +141,7 @@ class printProcess(threading.Thread):
 						# ... reset command index to start of loop.
 						commandIndex = loopStartIndex
 					self.slice += 1
+					self.checkTelemetry()
 					break
 				else:
 					self.commandRun(self.printProcessList[commandIndex])
@@ -143,6 +156,8 @@ class printProcess(threading.Thread):
 
 
 		# Shut down nicely. **************************************************
+		if not self.debug and self.settings['monkeyprintBoard'].value:
+			self.serialPrinter.send(['telemetry', 0, True, None])
 		print "Print stopped after " + str(self.slice-1) + " slices."
 		self.queueStatus.put("stopped:slice:"+ str(self.slice-1))
 		# Wait a bit to give people a chance to read the last message.
@@ -163,7 +178,9 @@ class printProcess(threading.Thread):
 		if command[3] == 'internal':
 			print "Internal command:    \"" + command[0] + "\""
 			# Run the respective command.
-			if command[0] == "Expose":
+			if command[0] == "Initialise printer":
+				self.initialisePrinter()
+			elif command[0] == "Expose":
 				self.expose()
 			elif command[0] == "Wait":
 				self.wait(eval(command[1]))
@@ -183,14 +200,160 @@ class printProcess(threading.Thread):
 		elif command[3] == 'serialMonkeyprint':
 			commandString = command[2]
 			print "Monkeyprint command: \"" + command[0] + "\": "  + command[2]
-			self.serialPrinter.send([commandString, None, True,None])
-
-
-
+			# Wait for moves to finish before the next module.
+			self.serialPrinter.send([commandString, None, True, monkeyprintSerial.commandTimeouts.get(commandString)])
+
+
+
+
+
+	# Print job. ##############################################################
+
+	# Turn the loop into a print job for the monkeyprint board. Possible if the
+	# loop only holds layer up, tilt or peel, shutter, wait and one exposure.
+	# The board runs move, settle and exposure of each layer in that order.
+	# If the loop moves after the exposure, the first layer is exposed
+	# without a move before and the move after the last exposure is left out.
+	# Returns None if the loop has to run command by command.
+	def compileJob(self, loopStartIndex):
+		if self.debug or not self.settings['monkeyprintBoard'].value:
+			return None
+		job = {'move': 0, 'tilt': 0, 'flags': 0, 'settle': 0., 'motionFirst': True}
+		exposeIndex = None
+		motionIndex = None
+		shutter = []
+		index = loopStartIndex
+		while self.printProcessList[index][0] != "End loop":
+			command = self.printProcessList[index]
+			if command[3] == 'internal' and command[0] == "Expose" and exposeIndex == None:
+				exposeIndex = index
+			elif command[3] == 'internal' and command[0] == "Wait":
+				job['settle'] += float(eval(command[1]))
+			elif command[3] == 'serialMonkeyprint' and command[2] in ['buildUp', 'tilt', 'peel']:
+				if command[2] == 'buildUp':
+					job['move'] = int(round(float(self.settings['layerHeight'].value) * 1000.))
+				elif command[2] == 'tilt':
+					job['tilt'] = int(self.settings['tiltSpeed'].value)
+				else:
+					job['move'] = int(round(float(self.settings['layerHeight'].value) * 1000.))
+					job['flags'] |= monkeyprintSerial.jobPeel
+				if motionIndex == None:
+					motionIndex = index
+			elif command[3] == 'serialMonkeyprint' and command[2] in ['shutterOpen', 'shutterClose']:
+				shutter.append(command[2])
+			else:
+				return None
+			index += 1
+		job['endIndex'] = index
+		if exposeIndex == None or job['settle'] > 65.:
+			return None
+		if max(self.settings['exposureTime'].value, self.settings['exposureTimeBase'].value) > 65.:
+			return None
+		# The board opens the shutter for the exposure.
+		if 'shutterOpen' in shutter and 'shutterClose' in shutter:
+			job['flags'] |= monkeyprintSerial.jobShutter
+		if self.settings['camTriggerWithExposure'].value:
+			job['flags'] |= monkeyprintSerial.jobCameraStart
+		if self.settings['camTriggerAfterExposure'].value:
+			job['flags'] |= monkeyprintSerial.jobCameraEnd
+		if motionIndex != None and motionIndex > exposeIndex:
+			job['motionFirst'] = False
+		return job
+
+	# Upload the record of the given layer.
+	def sendJobLayer(self, job, layer):
+		move = job['move']
+		tilt = job['tilt']
+		flags = job['flags']
+		if layer == 0 and not job['motionFirst']:
+			move = 0
+			tilt = 0
+			flags &= ~monkeyprintSerial.jobPeel
+		if layer == self.numberOfSlices - 1:
+			flags |= monkeyprintSerial.jobLast
+		if layer < self.settings['numberOfBaseLayers'].value:
+			exposureTime = self.settings['exposureTimeBase'].value
+		else:
+			exposureTime = self.settings['exposureTime'].value
+		return self.serialPrinter.sendJobLayer(move, tilt, flags, int(round(job['settle'] * 1000.)), int(round(exposureTime * 1000.)))
+
+	# Run the print job. The board reports the start and end of each
+	# exposure, the host shows the slice in between and keeps the job ring
+	# filled. While on hold no layers are uploaded, the job stops once the
+	# ring runs empty.
+	def runJob(self, job):
+		layerNext = 0
+		layerExposed = -1
+		self.serialPrinter.sendBinary('jobStart')
+		self.serialPrinter.serial.timeout = 1
+		while not self.stopThread.isSet():
+			# Top up the ring. Layers up to the one exposed last are taken.
+			while layerNext < self.numberOfSlices and layerNext - layerExposed - 1 < monkeyprintSerial.jobSlots and not self.holdThread.isSet():
+				if not self.sendJobLayer(job, layerNext):
+					self.queueConsole.put("   Board did not take layer " + str(layerNext) + ".")
+					self.stopThread.set()
+					break
+				layerNext += 1
+			self.serialPrinter.serial.timeout = 1
+			event = self.serialPrinter.readLine().strip().split(' ')
+			if event[0] == "expose" and len(event) == 2:
+				layerExposed = int(event[1])
+				self.slice = layerExposed
+				print "Printing slice " + str(self.slice) + " of " + str(self.numberOfSlices) + ". *********"
+				self.queueStatus.put("printing:nSlices:" + str(self.numberOfSlices))
+				self.queueStatus.put("printing:slice:" + str(self.slice))
+				self.setGuiSlice(self.slice)
+			elif event[0] == "exposeEnd":
+				self.setGuiSlice(-1)
+				self.slice = layerExposed + 1
+				self.checkTelemetry()
+			elif event[0] == "done":
+				break
+		if self.stopThread.isSet():
+			self.serialPrinter.sendBinary('jobStop')
+			self.setGuiSlice(-1)
+		self.serialPrinter.serial.timeout = None
 
 
 	# Internal print commands. ################################################
 
+	# Send the print settings to the monkeyprint board.
+	def initialisePrinter(self):
+		if self.debug or not self.settings['monkeyprintBoard'].value:
+			return
+		self.queueConsole.put("   Sending printer settings.")
+		self.serialPrinter.send(['nSlices', self.numberOfSlices, True, None])
+		self.serialPrinter.send(['telemetry', self.telemetryPeriod, True, None])
+		# The board keeps the settings in EEPROM. Only sent if the stored
+		# ones are missing or outdated.
+		self.serialPrinter.sendConfig(self.printerSettings())
+
+	# Setting commands of the monkeyprint board, values in the board's units.
+	def printerSettings(self):
+		# The board converts speeds with the mechanics: step angle in 1/100 , lead in um, speed in um/s.
+		buildStepAngle = int(round(float(self.settings['buildStepAngle'].value) * 100.))
+		buildMicrosteps = int(self.settings['buildMicroStepsPerStep'].value)
+		buildLead = int(round(float(self.settings['buildMmPerTurn'].value) * 1000.))
+		buildFeedrate = int(round(float(self.settings['buildFeedrate'].value) * 1000.))
+		buildStepsPerMm = 360. / float(self.settings['buildStepAngle'].value) * buildMicrosteps / float(self.settings['buildMmPerTurn'].value)
+		# Layer up moves the layer height in minimum moves.
+		buildMinimumMove = int(round(buildStepsPerMm * float(self.settings['buildMinimumMove'].value)))
+		layerHeight = int(round(float(self.settings['layerHeight'].value) / float(self.settings['buildMinimumMove'].value)))
+		tiltStepsPerTurn = int(360. / float(self.settings['tiltStepAngle'].value) * float(self.settings['tiltMicroStepsPerStep'].value))
+		tiltAngle = int(float(self.settings['tiltAngle'].value) / (float(self.settings['tiltStepAngle'].value) / float(self.settings['tiltMicroStepsPerStep'].value)))
+		return [	['buildStepAngle', buildStepAngle, True, None],
+				['buildMicrosteps', buildMicrosteps, True, None],
+				['buildLead', buildLead, True, None],
+				['buildFeed', buildFeedrate, True, None],
+				['buildMinMove', buildMinimumMove, True, None],
+				['buildLayer', layerHeight, True, None],
+				['tiltRes', tiltStepsPerTurn, True, None],
+				['tiltAngle', tiltAngle, True, None],
+				['tiltSpeed', int(self.settings['tiltSpeed'].value), True, None],
+				['peelOffset', int(self.settings['peelOffset'].value), True, None],
+				['shttrOpnPs', int(self.settings['shutterPositionOpen'].value), True, None],
+				['shttrClsPs', int(self.settings['shutterPositionClosed'].value), True, None]	]
+
 	# Start exposure by writing slice number to queue.
 	def expose(self):
 		# Get exposure time.
@@ -200,8 +363,16 @@ class printProcess(threading.Thread):
 			self.exposureTime = self.settings['exposureTime'].value
 		self.queueConsole.put("   Exposing with " + str(self.exposureTime) + " s.")
 		self.setGuiSlice(self.slice)
+		# The monkeyprint board times the exposure and holds the camera pin
+		# high during it if exposure triggering has been selected.
+		if not self.debug and self.settings['monkeyprintBoard'].value == True:
+			flags = 0
+			if self.settings['camTriggerWithExposure'].value:
+				flags |= monkeyprintSerial.exposeCamera
+			self.serialPrinter.expose(self.exposureTime, flags)
 		# Wait during exposure. Wait function also fires camera trigger if exposure triggering has been selected.
-		self.wait(self.exposureTime, trigger=(not self.debug and self.settings['camTriggerWithExposure'].value))
+		else:
+			self.wait(self.exposureTime, trigger=(not self.debug and self.settings['camTriggerWithExposure'].value))
 		# Stop exposure by writing -1 to queue.
 		self.setGuiSlice(-1)
 		# Fire the camera trigger if after exposure triggering has been selected.
@@ -276,6 +447,22 @@ class printProcess(threading.Thread):
 	def hold(self):
 		pass
 
+	# Report problems the monkeyprint board announces in its telemetry frames.
+	# Frames are taken apart while reading the replies.
+	def checkTelemetry(self):
+		if self.debug or not self.settings['monkeyprintBoard'].value:
+			return
+		telemetry = self.serialPrinter.telemetry
+		if telemetry == None:
+			return
+		if telemetry['usbDropped'] != self.telemetryDropped:
+			self.queueConsole.put("   Board dropped " + str(telemetry['usbDropped'] - self.telemetryDropped) + " messages.")
+			self.telemetryDropped = telemetry['usbDropped']
+		# Position drift over tolerance since homing.
+		if telemetry['status'] & (1 << 5) and not self.telemetryDriftReported:
+			self.queueConsole.put("   Build platform drifted by " + str(telemetry['driftBottom']) + " steps at the bottom, " + str(telemetry['driftTop']) + " steps at the top.")
+			self.telemetryDriftReported = True
+
 
 	def createSerial(self):
 	# Create printer serial port.
@@ -23,6 +23,8 @@ import serial
 import re
 import threading
 import time
+import struct
+import binascii
 
 #class serialThread(threading.Thread):
 #	# Override init function.
@@ -112,7 +114,7 @@ class printer(threading.Thread):
 						# Place send message in queue.
 						self.queue.put("Sending command \"" + string + "\".")
 						# Send command.
-						self.serial.write(string)
+						self.serial.write(string + "\n")
 						# If retry flag is set...
 						if retry:
 							# ... listen for ack until timeout.
@@ -191,6 +193,83 @@ class printer(threading.Thread):
 
 
 
+# Longest ASCII command line the monkeyprint board accepts, without terminator.
+# The USB endpoints take 64 bytes per packet, so this is limited by the
+# firmware line buffer (COMMAND_LINE_SIZE) only.
+maxCommandLength = 29
+
+# Binary command protocol of the monkeyprint board. See firmware/lib/binaryCommands.h.
+# Frame: sync, opcode, sequence, length, little endian args, crc8 (poly 0x07).
+binarySync = 0xA5
+binaryOpcodes = {	'ping': 0x00, 'tilt': 0x01, 'buildHome': 0x02, 'buildTop': 0x03,
+			'buildBaseUp': 0x04, 'buildUp': 0x05, 'shutterOpen': 0x06, 'shutterClose': 0x07,
+			'shutterEnable': 0x08, 'shutterDisable': 0x09, 'triggerCam': 0x0A, 'peel': 0x0B,
+			'qBuildUp': 0x0C, 'qTilt': 0x0D, 'qShutterOpen': 0x0E, 'qShutterClose': 0x0F,
+			'qCam': 0x10, 'qPeel': 0x11, 'qClear': 0x12, 'qBuildMove': 0x13, 'qDwell': 0x14,
+			'buildLayer': 0x15, 'buildBaseLayer': 0x16, 'tiltSpeed': 0x17, 'tiltAngle': 0x18,
+			'tiltRes': 0x19, 'buildSpeed': 0x1A, 'buildRes': 0x1B, 'buildMinMove': 0x1C,
+			'buildAccel': 0x1D, 'buildRamp': 0x1E, 'buildMove': 0x1F, 'printingFlag': 0x20,
+			'slice': 0x21, 'nSlices': 0x22, 'shttrOpnPs': 0x23, 'shttrClsPs': 0x24,
+			'peelOffset': 0x25, 'peelTiltSpd': 0x26, 'peelBuildSpd': 0x27, 'telemetry': 0x28,
+			'shttrOpnPw': 0x29, 'shttrClsPw': 0x2A, 'shttrSlew': 0x2B, 'saveConfig': 0x2C,
+			'loadConfig': 0x2D, 'buildMoveUm': 0x2E, 'homeFastSpd': 0x2F, 'homeSlowSpd': 0x30,
+			'homeBackoff': 0x31, 'homeTimeout': 0x32, 'jobLayer': 0x33, 'jobStart': 0x34,
+			'jobStop': 0x35, 'expose': 0x36, 'exposeStop': 0x37, 'tiltRetSpd': 0x38,
+			'tiltAccel': 0x39, 'tiltCreepSpd': 0x3A, 'tiltApproach': 0x3B, 'auditTol': 0x3C,
+			'auditAction': 0x3D, 'auditReset': 0x3E, 'crashClear': 0x3F, 'buildFeed': 0x40,
+			'buildSpdTbl': 0x41, 'buildStartSpd': 0x42, 'buildStepAngle': 0x43,
+			'buildMicrosteps': 0x44, 'buildLead': 0x45, 'configTag': 0x46	}
+binaryStatusOk = 0
+binaryStatusCrc = 1
+binaryStatusFull = 4
+binaryStatusConfig = 5
+binaryStatusBusy = 6
+
+# Per layer commands. send() passes them to the monkeyprint board as binary
+# frames, which are acked within milliseconds.
+binaryLayerCommands = [	'buildUp', 'buildBaseUp', 'buildMove', 'buildMoveUm', 'tilt', 'peel',
+			'shutterOpen', 'shutterClose', 'triggerCam', 'slice'	]
+
+# Commands of the monkeyprint board that run until "done", with timeout in s.
+commandTimeouts = {	'buildHome': 240, 'buildTop': 240, 'buildUp': 20, 'buildBaseUp': 20,
+			'tilt': 20, 'peel': 20	}
+
+# Print job layer flags. See firmware/lib/printJob.h.
+jobLayerFormat = '<hBBHH'
+jobShutter = 0x01
+jobCameraStart = 0x02
+jobCameraEnd = 0x04
+jobLast = 0x08
+jobPeel = 0x10
+# Records the job ring holds. One of the PRINT_JOB_SIZE slots stays free.
+jobSlots = 15
+
+# Exposure timer flags. See firmware/lib/exposure.h.
+exposeFormat = '<IB'
+exposeShutter = 0x01
+exposeCamera = 0x02
+exposeEvents = 0x04
+
+# Telemetry frames, switched on with the telemetry command. See firmware/lib/telemetry.h.
+# Frame: sync, frame type, counter, length, little endian payload, crc8.
+telemetryFrameType = 0xFE
+telemetryFormat = '<HHiiBBHHBHHBHhh'
+telemetryFields = [	'position', 'targetPosition', 'buildSteps', 'tiltSteps',
+			'segment', 'queueDepth', 'buildCompare', 'tiltCompare',
+			'limits', 'slice', 'nSlices', 'status', 'usbDropped', 'driftBottom',
+			'driftTop'	]
+
+def crc8(data, crc=0):
+	for byte in data:
+		crc ^= byte
+		for i in range(8):
+			if crc & 0x80:
+				crc = ((crc << 1) ^ 0x07) & 0xFF
+			else:
+				crc = (crc << 1) & 0xFF
+	return crc
+
+
 class printerStandalone:
 	def __init__(self, settings):
 
@@ -210,10 +289,16 @@ class printerStandalone:
 			self.port=self.settings['port'].value
 			self.baudrate=self.settings['baudrate'].value
 		
-		if self.settings['monkeyprintBoard'].value:
-			self.terminator = ""
-		else:
-			self.terminator = "\n"
+		# Sequence number of binary frames.
+		self.sequence = 0
+		self.telemetry = None
+		# Input taken apart by readMessage: partial text line and
+		# lines that came in while waiting for a binary ack.
+		self.lineBuffer = ""
+		self.pendingLines = []
+		
+		# The monkeyprint board runs a command as soon as the terminator is in.
+		self.terminator = "\n"
 		
 		if not self.debug:
 			print "Opening serial on port " + self.port + " at " + str(self.baudrate) + " baud."
@@ -241,9 +326,10 @@ class printerStandalone:
 	def flush(self, timeout=1.):
 		oldTimeout = self.serial.timeout
 		self.serial.timeout = timeout
+		self.pendingLines = []
 		string = "Flushing incoming messages."
 		while string != "":
-			string = self.serial.readline()
+			string = self.readLine()
 			print string
 		self.serial.timeout = oldTimeout
 		return string
@@ -252,7 +338,7 @@ class printerStandalone:
 		oldTimeout = self.serial.timeout
 		self.serial.timeout = timeout
 		for i in range(20):
-			printerResponse = self.serial.readline()
+			printerResponse = self.readLine()
 			print printerResponse
 			if printerResponse.strip() == "ok":
 				break
@@ -274,7 +360,176 @@ class printerStandalone:
 		wait = command[3]
 		for commandString in commandList:
 			self.send((commandString, value, retry, wait))
-		
+
+	# Tag of a list of setting commands. Saved on the board together with
+	# the settings, so the host can tell if they are still up to date.
+	def configTag(self, commandList):
+		return binascii.crc_hqx(repr([(command[0], command[1]) for command in commandList]), 0xFFFF)
+
+	# Load the settings stored on the board. Returns True if they were saved
+	# with the given tag, False if the host has to send its settings
+	# ("noConfig").
+	def loadConfig(self, tag):
+		if self.settings['debug'].value or self.serial == None:
+			return False
+		print "Sending: loadConfig " + str(tag) + "."
+		self.serial.write("loadConfig " + str(tag) + self.terminator)
+		self.serial.timeout = 5
+		printerResponse = self.readAck()
+		self.serial.timeout = None
+		print "Printer response: " + printerResponse
+		return printerResponse == "loadConfig"
+
+	# Send setting commands unless the board has them stored already.
+	# Stores them afterwards, the board takes up to 250 ms to write them.
+	def sendConfig(self, commandList):
+		tag = self.configTag(commandList)
+		if self.loadConfig(tag):
+			print "Settings stored on the board are up to date."
+			return True
+		returnValue = True
+		for command in commandList:
+			returnValue = self.send(command) and returnValue
+		if returnValue:
+			self.send(['configTag', tag, True, None])
+			self.send(['saveConfig', None, True, None])
+		return returnValue
+
+	# Expose for exposureTime seconds, timed by the board. Flags see
+	# exposeShutter etc. Returns after the board reports "done", or after
+	# the exposure plus five seconds.
+	def expose(self, exposureTime, flags=0):
+		record = struct.pack(exposeFormat, int(round(exposureTime * 1000000)), flags)
+		return self.sendBinary('expose', record, wait=int(exposureTime) + 5)
+
+	# Read the next ack line. Skips "done" of earlier operations.
+	def readAck(self):
+		while True:
+			printerResponse = self.readLine().strip()
+			if printerResponse != "done":
+				return printerResponse
+
+
+	# Send a command as binary frame. Much shorter than the ASCII command and
+	# acked with a five byte response carrying the sequence number. Resends
+	# on checksum errors and while the motion queue is full.
+	# Value is an int16 or a packed argument string.
+	# Returns True on success.
+	def sendBinary(self, string, value=None, wait=None):
+		if self.settings['debug'].value or self.serial == None:
+			return False
+		opcode = binaryOpcodes[string]
+		args = []
+		if isinstance(value, str):
+			args = list(bytearray(value))
+		elif value != None:
+			value = int(value) & 0xFFFF
+			args = [value & 0xFF, value >> 8]
+		self.sequence = (self.sequence + 1) & 0xFF
+		body = [opcode, self.sequence, len(args)] + args
+		frame = bytearray([binarySync] + body + [crc8(body)])
+		self.serial.timeout = 1
+		returnValue = False
+		for count in range(5):
+			self.serial.write(frame)
+			status = self.readBinaryAck()
+			if status == binaryStatusOk:
+				returnValue = True
+				break
+			elif status == binaryStatusFull or status == binaryStatusBusy:
+				time.sleep(0.1)
+			elif status != binaryStatusCrc:
+				break
+		# Listen for "done" string.
+		if returnValue and wait != None:
+			for count in range(max(int(wait), 1)):
+				if self.readLine().strip() == "done":
+					break
+		self.serial.timeout = None
+		return returnValue
+
+	# Upload one print job layer. Waits up to timeout seconds while the job
+	# ring is full. Z move in um, tilt speed 0 for no tilt, settle and
+	# exposure in ms.
+	def sendJobLayer(self, buildMove, tiltSpeed, flags, settle, exposure, timeout=60):
+		record = struct.pack(jobLayerFormat, buildMove, tiltSpeed, flags, settle, exposure)
+		timeStart = time.time()
+		while not self.sendBinary('jobLayer', record):
+			if self.settings['debug'].value or self.serial == None or time.time() - timeStart > timeout:
+				return False
+		return True
+
+	# Read the next message from the board. ASCII lines, binary acks and
+	# telemetry frames arrive on the same channel. ASCII never contains the
+	# sync byte, so frames are taken out byte by byte before lines are split.
+	# Telemetry is kept in self.telemetry.
+	# Returns a text line with terminator, a four byte ack (opcode, sequence,
+	# status, crc) or None on timeout. A partial line is kept for the next call.
+	# Telemetry frames do not extend the timeout.
+	def readMessage(self):
+		timeStart = time.time()
+		while True:
+			byte = self.serial.read(1)
+			if byte == "":
+				return None
+			if ord(byte) != binarySync:
+				self.lineBuffer += byte
+				if byte == "\n":
+					line = self.lineBuffer
+					self.lineBuffer = ""
+					return line
+				continue
+			response = bytearray(self.serial.read(4))
+			if len(response) < 4:
+				return None
+			# Telemetry frame in between, read the rest and keep it.
+			if response[0] == telemetryFrameType:
+				self.readTelemetry(response)
+				if self.serial.timeout != None and time.time() - timeStart > self.serial.timeout:
+					return None
+				continue
+			if crc8(response[:3]) == response[3]:
+				return response
+
+	# Read the next ASCII line like serial.readline(). Returns "" on timeout.
+	# Binary acks of earlier frames are dropped.
+	def readLine(self):
+		if len(self.pendingLines):
+			return self.pendingLines.pop(0)
+		while True:
+			message = self.readMessage()
+			if message == None:
+				return ""
+			if isinstance(message, str):
+				return message
+
+	# Read the response frame for the current sequence number.
+	# ASCII lines like "done" are kept for readLine. Returns the status or
+	# None on timeout.
+	def readBinaryAck(self):
+		while True:
+			message = self.readMessage()
+			if message == None:
+				return None
+			if isinstance(message, str):
+				self.pendingLines.append(message)
+			elif message[1] == self.sequence:
+				return message[2]
+
+
+	# Read the payload of a telemetry frame. Header holds frame type, counter,
+	# length and the first payload byte.
+	def readTelemetry(self, header):
+		length = header[2]
+		frame = header + bytearray(self.serial.read(length))
+		if len(frame) < length + 4 or crc8(frame[:length + 3]) != frame[length + 3]:
+			return
+		payload = bytes(frame[3:length + 3])
+		if len(payload) != struct.calcsize(telemetryFormat):
+			return
+		self.telemetry = dict(zip(telemetryFields, struct.unpack(telemetryFormat, payload)))
+		self.telemetry['counter'] = frame[1]
+
 
 	def send(self, command):
 		if self.settings['debug'].value:
@@ -289,6 +544,10 @@ class printerStandalone:
 			value = command[1]
 			retry = command[2]
 			wait = command[3]
+			# Per layer commands as binary frame.
+			if self.serial != None and self.settings['monkeyprintBoard'].value and string in binaryLayerCommands:
+				print "Sending binary: " + string + "."
+				return self.sendBinary(string, value, wait)
 			# Send command.
 			if self.serial != None:
 				# Cast inputs.
@@ -304,6 +563,8 @@ class printerStandalone:
 					# Separate string and value by space.
 					if value != None:
 						sendString = sendString + " " + str(value)
+					if self.settings['monkeyprintBoard'].value and len(sendString) > maxCommandLength:
+						raise ValueError('Serial command longer than ' + str(maxCommandLength) + ' characters.')
 					print "Sending: " + sendString + "."
 					# Send command.
 					self.serial.write(sendString+self.terminator)
@@ -312,6 +573,8 @@ class printerStandalone:
 					printerResponse = ""
 					if not self.settings['monkeyprintBoard'].value:
 						printerResponse = self.waitForOk()
+					elif retry:
+						printerResponse = self.readAck()
 					print "Printer response: " + printerResponse
 					if retry:
 						# ... listen for ack until timeout.
@@ -352,7 +615,7 @@ class printerStandalone:
 					count = 0
 					while count < wait:
 						# ... and listen for "done" string until timeout.
-						printerResponse = self.serial.readline()
+						printerResponse = self.readLine()
 						printerResponse = printerResponse.strip()
 						# Listen for "done" string.Check if return string is "done".
 						if printerResponse == "done":
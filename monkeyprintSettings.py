@@ -196,12 +196,14 @@ class programSettings(dict):
 		self['tiltSpeedSlow'] = setting(value='4', default='4',		name='Speed slow')
 		self['tiltEnable'] = setting(value=True, default=True,		name='Enable')
 		self['tiltReverse'] = setting(value=False, default=False,		name='Reverse tilt direction')
+		self['peelOffset'] = setting(value=0, default=0, lower=-1000, upper=1000,		name='Peel layer move offset')	# Tilt steps after start of tilt return. Negative: before.
 		self['buildStepAngle'] = setting(value=1.8, default=1.8, unit="°",		name='Step angle')
 		self['buildMicroStepsPerStep'] = setting(value=16, default=16, lower=1, upper=32,		name='Micro steps per step')
 		self['buildMmPerTurn'] = setting(value=1.0, default=1.0, unit="mm",		name='Distance per turn')
 		self['buildMinimumMove'] = setting(value=0.01, default=0.01, unit="mm",		name='Minimum move')
 		self['buildRampSlope'] = setting(value=15, default=15,		name='Ramp slope')
 		self['buildPlatformSpeed'] = setting(value='10', default='10', unit='mm/s',		name='Speed')
+		self['buildFeedrate'] = setting(value=0.31, default=0.31, lower=0.01, upper=20.0, unit='mm/s',		name='Move speed')	# Monkeyprint board. Default is the old speed 1.
 		self['reverseBuild'] = setting(value=False, default=False,		name='Reverse build direction')
 		self['showFill'] = setting(value=True,		name='Show fill')
 		self['layerHeight'] = setting(value=0.1, lower=.05, upper=0.3, unit='mm',		name='Layer height')
@@ -233,9 +235,9 @@ class programSettings(dict):
 #		self['Home GCode'] = setting(value='G28', default='G28')
 #		self['Top GCode'] = setting(value='G28 Z0', default='G28 Z0')
 		# Modules for print process. Values are: Type, Display name, Value, Unit, Editable.
-		self['printModulesMonkeyprint'] = setting(value=	'Initialise printer,,,internal,False;Wait,1.0,,internal,True;Build platform layer up,,buildUp,serialMonkeyprint,False;Build platform to home,,buildHome,serialMonkeyprint,False;Build platform to top,,buildTop,serialMonkeyprint,False;Tilt,,tilt,serialMonkeyprint,False;Shutter open,,shutterOpen,serialMonkeyprint,False;Shutter close,,shutterClose,serialMonkeyprint,False;Expose,,,internal,False;Projector on,,projectorOn,serialMonkeyprint,False;Projector off,,projectorOff,serialMonkeyprint,False;Start loop,,,internal,False;End loop,,,internal,False')
+		self['printModulesMonkeyprint'] = setting(value=	'Initialise printer,,,internal,False;Wait,1.0,,internal,True;Build platform layer up,,buildUp,serialMonkeyprint,False;Build platform to home,,buildHome,serialMonkeyprint,False;Build platform to top,,buildTop,serialMonkeyprint,False;Tilt,,tilt,serialMonkeyprint,False;Peel (tilt and layer up),,peel,serialMonkeyprint,False;Shutter open,,shutterOpen,serialMonkeyprint,False;Shutter close,,shutterClose,serialMonkeyprint,False;Expose,,,internal,False;Projector on,,projectorOn,serialMonkeyprint,False;Projector off,,projectorOff,serialMonkeyprint,False;Start loop,,,internal,False;End loop,,,internal,False')
 		self['printModulesGCode'] = setting(value='Wait,1.0,,internal,True;Initialise printer,G21 G91 M17,,serialGCode,True;Build platform layer up,G1 Z{$layerHeight} F100,,serialGCode,True;Build platform to home,G28 X Z,,serialGCode,True;Build platform to top,G162 Z F100,,serialGCode,True;Tilt down,G1 X20 F1000,,serialGCode,True;Tilt up,G1 X-20 F1000,,serialGCode,True;Shutter open,M280 P0 S500,,serialGCode,True;Shutter close,M280 P0 S2500,,serialGCode,True;Expose,,,internal,False;Projector on,,,internal,False;Projector off,,,internal,False;Start loop,,,internal,False;End loop,,,internal,False;Shut down printer,M18,,serialGCode,True;Set steps per unit,M92 X 20.8 Z 10.2,,serialGCode,True;Emergency stop,M112,,serialGCode,True;Beep,M300 S440 P500,,serialGCode,True;Custom G-Code,G91,,serialGCode,True')
-		self['printProcessMonkeyprint'] = setting(value='Initialise printer,,,internal,False;Projector on,,projectorOn,serialMonkeyprint,False;Build platform to home,,buildHome,serialMonkeyprint,False;Start loop,,,internal,False;Shutter open,,shutterOpen,serialMonkeyprint,False;Expose,,,internal,False;Shutter close,,shutterClose,serialMonkeyprint,False;Tilt,,tilt,serialMonkeyprint,False;Wait,1.0,,internal,True;End loop,,,internal,False;Build platform to top,,buildTop,serialMonkeyprint,False')
+		self['printProcessMonkeyprint'] = setting(value='Initialise printer,,,internal,False;Projector on,,projectorOn,serialMonkeyprint,False;Build platform to home,,buildHome,serialMonkeyprint,False;Start loop,,,internal,False;Shutter open,,shutterOpen,serialMonkeyprint,False;Expose,,,internal,False;Shutter close,,shutterClose,serialMonkeyprint,False;Peel (tilt and layer up),,peel,serialMonkeyprint,False;Wait,1.0,,internal,True;End loop,,,internal,False;Build platform to top,,buildTop,serialMonkeyprint,False')
 		self['printProcessGCode'] = setting(value='Initialise printer,G21 G91 M17,,serialGCode,True;Projector on,---,,internal,False;Build platform to home,G28 X Z,,serialGCode,True;Start loop,---,,internal,False;Shutter open,M280 P0 S500,,serialGCode,True;Expose,---,,internal,False;Shutter close,M280 P0 S2500,,serialGCode,True;Tilt down,G1 X20 F1000,,serialGCode,True;Build platform layer up,G1 Z{$layerHeight} F100,,serialGCode,True;Tilt up,G1 X-20 F1000,,serialGCode,True;Wait,1.0,,internal,True;End loop,---,,internal,False;Build platform to top,G162 F100,,serialGCode,True;Shut down printer,M18,,serialGCode,True')
 		#self['calibrationImageFile'] = setting(value="calibrationImage.jpg", default="calibrationImage.jpg")
 		self['polylineClosingThreshold'] = setting(value=0.1, default=0.1, lower=0.0, upper=1.0)